@@ -0,0 +1,414 @@
+/*
+ *
+ *  equivalence - checks that the faster evaluation paths give the same results as the interpreter
+ *
+ *  Copyright (C) 2004-2011 Artur B Adib
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <iostream>
+#include <string>
+#include <cstring>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <set>
+#include <thread>
+#include "SlashA.hpp"
+#include "SlashA_Enumerator.hpp"
+#include "SlashA_Generator.hpp"
+#include "SlashA_Tier.hpp"
+#include "SlashA_Trie.hpp"
+
+using namespace std;
+using namespace SlashA;
+
+// Raises stop once the given number of milliseconds has passed, unless destroyed first. Programs that run
+// into it (e.g. an endless gotoifp loop) are skipped, since where they stop depends on timing.
+class Deadline
+{
+  private:
+    atomic<bool>& stop;
+    mutex mtx;
+    condition_variable cv;
+    bool done;
+    thread timer;
+
+  public:
+    Deadline(atomic<bool>& _stop, long ms) : stop(_stop), done(false)
+    {
+      timer = thread([this, ms] {
+        unique_lock<mutex> lock(mtx);
+        if (!cv.wait_for(lock, chrono::milliseconds(ms), [this] { return done; }))
+          stop = true;
+      });
+    }
+    ~Deadline()
+    {
+      {
+        lock_guard<mutex> lock(mtx);
+        done = true;
+      }
+      cv.notify_one();
+      timer.join();
+    }
+};
+
+const long deadline_ms = 20; // for the interpreter; the other paths get ten times as long
+const int max_loop_depth = 3; // deeper programs fail, on every path alike
+
+static bool sameOutputs(const vector<double>& a, const vector<double>& b)
+{
+  return (a.size()==b.size()) && ( a.empty() || (memcmp(a.data(), b.data(), a.size()*sizeof(double))==0) );
+}
+
+// Compares everything runFitnessCases() reports; describes the first difference in "why"
+static bool sameResults(const EvalResult& a, const EvalResult& b, string& why)
+{
+  if (a.cancelled!=b.cancelled) why = "cancelled (ran into the deadline)";
+  else if (a.n_cases!=b.n_cases) why = "n_cases";
+  else if (a.n_ops!=b.n_ops) why = "n_ops";
+  else if (a.n_invops!=b.n_invops) why = "n_invops";
+  else if (a.n_inputs_bf_output!=b.n_inputs_bf_output) why = "n_inputs_bf_output";
+  else if (a.n_failed!=b.n_failed) why = "n_failed";
+  else if (a.outputs.size()!=b.outputs.size()) why = "number of output vectors";
+  else {
+    for (unsigned k=0;k<a.outputs.size();k++)
+      if (!sameOutputs(a.outputs[k], b.outputs[k])) {
+        why = "outputs of case " + to_string(k);
+        return false;
+      }
+    return true;
+  }
+  return false;
+}
+
+static string sourceOf(const ByteCode& bc, InstructionSet& iset)
+{
+  string s;
+  for (unsigned i=0;i<bc.size();i++)
+    s += ( (bc[i]<iset.numericInstructions()) ? to_string(bc[i]) : iset.getName(bc[i]) ) + "/";
+  return s;
+}
+
+static bool report(const char* what, const ByteCode& bc, InstructionSet& iset, const string& why)
+{
+  cout << what << " differs from the interpreter (" << why << ") on " << sourceOf(bc, iset) << endl;
+  return false;
+}
+
+/*
+ * Tier: the linked form of a program, run directly and through a TieredEvaluator promoting at the first
+ * evaluation, against the interpreter
+ */
+
+class TierCoverage
+{
+  public:
+    unsigned n_programs, n_skipped, n_loops, n_gotos, n_jumphere_runs, n_depth_failures;
+    TierCoverage() { n_programs = n_skipped = n_loops = n_gotos = n_jumphere_runs = n_depth_failures = 0; }
+};
+
+static bool checkTier(InstructionSet& iset, ByteCode& bc, FitnessCases& cases, TierCoverage& cov)
+{
+  vector<double> input, output;
+  MemCore core(10, 10, input, output);
+  atomic<bool> stop(false);
+  EvalResult ref, linked, tiered;
+
+  {
+    Deadline deadline(stop, deadline_ms);
+    runFitnessCases(iset, core, bc, cases, -2237, stop, max_loop_depth, ref);
+  }
+  if (ref.cancelled) {
+    cov.n_skipped++;
+    return true;
+  }
+
+  LinkedProgram lp;
+  if (!linkProgram(iset, bc, lp))
+    return report("linkProgram", bc, iset, "rejected a DIS program");
+  TieredEvaluator tier(iset, 1, false); // promoted at the first evaluation, linked in this thread
+  {
+    Deadline deadline(stop, 10*deadline_ms);
+    runFitnessCases(iset, core, lp, cases, -2237, stop, max_loop_depth, linked);
+    tier.evaluate(iset, core, bc, cases, -2237, stop, max_loop_depth, tiered); // linked before it runs
+  }
+  if (tier.stats().evals[1]!=1)
+    return report("TieredEvaluator", bc, iset, "the evaluation did not run linked");
+
+  string why;
+  if (!sameResults(ref, linked, why))
+    return report("Linked program", bc, iset, why);
+  if (!sameResults(ref, tiered, why))
+    return report("TieredEvaluator", bc, iset, why);
+
+  const ByteCode_Type loop = iset.lookup("loop", 4), gotoifp = iset.lookup("gotoifp", 7);
+  const ByteCode_Type jumpifn = iset.lookup("jumpifn", 7), jumphere = iset.lookup("jumphere", 8);
+  bool has_loop = false, has_goto = false, has_jumpifn = false, has_run = false;
+  for (unsigned i=0;i<bc.size();i++) {
+    has_loop |= (bc[i]==loop);
+    has_goto |= (bc[i]==gotoifp);
+    has_jumpifn |= (bc[i]==jumpifn);
+    has_run |= has_jumpifn && (i>0) && (bc[i]==jumphere) && (bc[i-1]==jumphere);
+  }
+  cov.n_programs++;
+  cov.n_loops += has_loop;
+  cov.n_gotos += has_goto;
+  cov.n_jumphere_runs += has_run;
+  cov.n_depth_failures += (ref.n_failed>0);
+  return true;
+}
+
+static bool checkTiers(InstructionSet& iset, FitnessCases& cases)
+{
+  // Hand-written corner cases first: a jumpifn landing on a run of stripped jumphere, a loop too deep, a
+  // label/gotoifp loop counting down, and a loop starting at position 0 (no match, as in the interpreter)
+  const char* corner[] = {
+    "input/itof/jumpifn/1/jumpifn/nop/jumphere/jumphere/jumphere/output/",
+    "input/0/save/jumpifn/jumpifn/2/jumphere/nop/jumphere/jumphere/input/output/",
+    "2/itof/0/save/1/loop/loop/loop/loop/inc/endloop/endloop/endloop/endloop/output/",
+    "input/0/save/1/label/0/load/dec/save/output/1/gotoifp/",
+    "loop/input/output/endloop/input/output/",
+  };
+  TierCoverage cov;
+  bool ok = true;
+
+  for (unsigned i=0;i<sizeof(corner)/sizeof(corner[0]);i++) {
+    ByteCode bc;
+    source2ByteCode(corner[i], bc, iset);
+    ok &= checkTier(iset, bc, cases, cov);
+  }
+
+  vector<double> weights = opcodeWeights(iset);
+  for (int structured=1;structured>=0;structured--) {
+    ProgramGenerator gen(iset, weights, 7+structured, structured, -1); // loops of any depth
+    for (unsigned n=0;n<3000;n++) {
+      ByteCode bc;
+      gen.program(bc, 1 + gen.random().below(40));
+      ok &= checkTier(iset, bc, cases, cov);
+    }
+  }
+
+  cout << "tier: " << cov.n_programs << " programs compared (" << cov.n_skipped << " skipped at the deadline), "
+       << cov.n_loops << " with loops, " << cov.n_gotos << " with gotoifp, " << cov.n_jumphere_runs
+       << " with jumphere runs, " << cov.n_depth_failures << " failing the loop depth" << endl;
+  if ( (cov.n_loops==0) || (cov.n_gotos==0) || (cov.n_jumphere_runs==0) || (cov.n_depth_failures==0) ) {
+    cout << "tier: the programs do not cover every case" << endl;
+    ok = false;
+  }
+  return ok;
+}
+
+/*
+ * Trie: a population of descendants of a few ancestors, sharing prefixes, run through a TrieEvaluator
+ * against runFitnessCases() on each program
+ */
+
+static bool hasOp(const ByteCode& bc, unsigned from, ByteCode_Type op)
+{
+  for (unsigned i=from;i<bc.size();i++)
+    if (bc[i]==op)
+      return true;
+  return false;
+}
+
+static bool checkTrie(InstructionSet& iset, FitnessCases& cases)
+{
+  vector<double> input, output;
+  MemCore core(10, 10, input, output);
+  vector<double> weights = opcodeWeights(iset);
+  ProgramGenerator gen(iset, weights, 11, false);
+  const ByteCode_Type ran = iset.lookup("ran", 3), out = iset.lookup("output", 6);
+  const ByteCode_Type gotoifp = iset.lookup("gotoifp", 7), endloop = iset.lookup("endloop", 7);
+
+  vector<ByteCode> ancestors(20), population;
+  vector<EvalResult> ref;
+  for (unsigned a=0;a<ancestors.size();a++)
+    gen.program(ancestors[a], 10 + gen.random().below(20));
+
+  unsigned n_skipped = 0, n_ran = 0, n_out = 0, n_back = 0;
+  while (population.size()<2000) {
+    // an ancestor cut anywhere and given a new tail, which often jumps back into the shared part
+    const ByteCode& a = ancestors[gen.random().below(ancestors.size())];
+    const unsigned cut = gen.random().below(a.size()+1);
+    ByteCode bc(a.begin(), a.begin()+cut);
+    ByteCode tail;
+    gen.program(tail, gen.random().below(12));
+    bc.insert(bc.end(), tail.begin(), tail.end());
+
+    atomic<bool> stop(false);
+    EvalResult r;
+    {
+      Deadline deadline(stop, deadline_ms);
+      runFitnessCases(iset, core, bc, cases, -2237, stop, max_loop_depth, r);
+    }
+    if (r.cancelled) {
+      n_skipped++;
+      continue;
+    }
+    n_ran += hasOp(bc, 0, ran);
+    n_out += hasOp(bc, 0, out);
+    n_back += hasOp(bc, cut, gotoifp) || hasOp(bc, cut, endloop);
+    population.push_back(bc);
+    ref.push_back(r);
+  }
+
+  PrefixTrie trie(iset);
+  trie.insert(population);
+  TrieEvaluator trie_eval(10, 10, 3); // three lanes, so that the cases are walked in several blocks
+  vector<EvalResult> res;
+  bool ok = true;
+  for (int pass=0;pass<2;pass++) { // the second pass reuses the output buffers of the first
+    atomic<bool> stop(false);
+    {
+      Deadline deadline(stop, 100*deadline_ms);
+      trie_eval.run(iset, trie, cases, -2237, stop, max_loop_depth, res);
+    }
+    string why;
+    for (unsigned p=0;(p<population.size()) && ok;p++)
+      if (!sameResults(ref[p], res[p], why))
+        ok = report("TrieEvaluator", population[p], iset, why);
+  }
+
+  // a stop raised before the walk: nothing runs, every result is cancelled and empty
+  atomic<bool> stopped(true);
+  trie_eval.run(iset, trie, cases, -2237, stopped, max_loop_depth, res);
+  for (unsigned p=0;(p<population.size()) && ok;p++)
+    if ( (!res[p].cancelled) || (res[p].n_cases>0) || (res[p].outputs.size()>0) )
+      ok = report("TrieEvaluator", population[p], iset, "ran after stop");
+
+  cout << "trie: " << population.size() << " programs compared (" << n_skipped << " skipped at the deadline), "
+       << trie.nodeCount() << " of " << trie.prefixInstructions() << " prefix instructions shared, " << n_ran
+       << " with ran, " << n_out << " with output, " << n_back << " with backward jumps in the new tail" << endl;
+  if ( (n_ran==0) || (n_out==0) || (n_back==0) || (trie.nodeCount()*2>trie.prefixInstructions()) ) {
+    cout << "trie: the programs do not cover every case" << endl;
+    ok = false;
+  }
+  return ok;
+}
+
+// The outputs of every case and the number of failed cases, bit for bit
+static string behaviorOf(const EnumCandidate& c)
+{
+  string b((const char*)&c.n_failed, sizeof(c.n_failed));
+  for (unsigned k=0;k<c.n_cases;k++) {
+    b.append((const char*)&c.n_written[k], sizeof(unsigned));
+    b.append((const char*)&c.outputs[k*c.n_outputs], c.n_written[k]*sizeof(double));
+  }
+  return b;
+}
+
+// Every program up to length 4 over a tiny alphabet, one thread. The set of behaviors reported with pruning
+// must equal the one without (setMaxStates(0)), and each program reported without pruning must match the
+// interpreter, which checks that the saved prefix states hold everything later instructions depend on.
+static bool checkEnumerator(FitnessCases& cases)
+{
+  ISetFactory make_iset = [] {
+    InstructionSet* iset = new InstructionSet(2);
+    iset->insert_DIS_full();
+    return iset;
+  };
+  InstructionSet* iset = make_iset();
+  const char* names[] = { "input", "inc", "save", "load", "add", "output", "ran", "loop", "endloop" };
+  vector<ByteCode_Type> alphabet = { 0, 1 };
+  for (unsigned i=0;i<sizeof(names)/sizeof(names[0]);i++)
+    alphabet.push_back(iset->lookup(names[i], strlen(names[i])));
+
+  const unsigned n_outputs = 2;
+  vector<double> input, output;
+  MemCore core(4, 4, input, output);
+  bool ok = true;
+  unsigned n_compared = 0, n_skipped = 0;
+  auto compare = [&](const EnumCandidate& c) {
+    if ( (!ok) || (c.n_failed>0) ) { // the step budget has no counterpart in the interpreter
+      n_skipped += (c.n_failed>0);
+      return;
+    }
+    ByteCode bc(c.program.code, c.program.code+c.program.length);
+    atomic<bool> stop(false);
+    EvalResult r;
+    {
+      Deadline deadline(stop, deadline_ms);
+      runFitnessCases(*iset, core, bc, cases, -2237, stop, max_loop_depth, r);
+    }
+    if (r.cancelled) {
+      n_skipped++;
+      return;
+    }
+    n_compared++;
+    for (unsigned k=0;k<c.n_cases;k++) {
+      const unsigned n = min(n_outputs, (unsigned)r.outputs[k].size());
+      if ( (r.n_failed>0) || (c.n_written[k]!=n) ||
+           memcmp(&c.outputs[k*c.n_outputs], r.outputs[k].data(), n*sizeof(double)) ) {
+        ok = report("ProgramEnumerator", bc, *iset, "outputs");
+        return;
+      }
+    }
+  };
+
+  // the empty behavior is only reported without pruning
+  set<string> pruned, all;
+  const string empty = string(sizeof(unsigned), 0) + string(cases.size()*sizeof(unsigned), 0);
+  ProgramEnumerator en(make_iset, alphabet, 4, 4);
+  en.setMaxOutputs(n_outputs);
+  const EnumStats s = en.enumerate(4, cases, [&](const EnumCandidate& c) {
+    pruned.insert(behaviorOf(c));
+    return false;
+  }, 1, -2237, max_loop_depth);
+  en.setMaxStates(0);
+  const EnumStats s0 = en.enumerate(4, cases, [&](const EnumCandidate& c) {
+    all.insert(behaviorOf(c));
+    compare(c);
+    return false;
+  }, 1, -2237, max_loop_depth);
+  all.erase(empty);
+  delete iset;
+
+  cout << "enumerator: " << s.candidates << " of " << s0.candidates << " programs run with pruning, " << pruned.size()
+       << " and " << all.size() << " behaviors found, " << n_compared << " programs compared (" << n_skipped
+       << " skipped)" << endl;
+  if ( (pruned!=all) || (s.pruned==0) || (s0.pruned>0) || (s0.duplicates>0) ) {
+    cout << "enumerator: the runs with and without pruning differ" << endl;
+    ok = false;
+  }
+  return ok;
+}
+
+int main()
+{
+  try
+  {
+    InstructionSet iset(16); // few numeric instructions, so that I often points into the tapes
+    iset.insert_DIS_full();
+
+    FitnessCases cases = { {2, 3}, {-1.5, 4}, {0, 0}, {7, -2} };
+
+    bool ok = checkTiers(iset, cases);
+    FitnessCases more_cases = { {2, 3}, {-1.5, 4}, {0, 0}, {7, -2}, {1, 1}, {-3, 0.5}, {4, 9} };
+    ok &= checkTrie(iset, more_cases);
+    ok &= checkEnumerator(cases);
+
+    cout << (ok ? "all paths agree with the interpreter" : "MISMATCH") << endl;
+    return ok ? 0 : 1;
+  }
+  catch(string& s)
+  {
+    cout << s << endl;
+    return 1;
+  }
+}
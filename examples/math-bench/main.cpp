@@ -0,0 +1,203 @@
+/*
+ *
+ *  math-bench
+ *
+ *  Throughput and accuracy of the exp, log, sin and pow kernels of the Slash/A library against libm, and of
+ *  the corresponding instructions under the two math modes and lockstep evaluation.
+ *
+ *  Copyright (C) 2004-2011 Artur B Adib
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+using namespace std;
+
+#include <cstdio>
+#include <cmath>
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <random>
+#include <string>
+#include "SlashA.hpp"
+#include "SlashA_Math.hpp"
+#include "SlashA_Lockstep.hpp"
+
+const unsigned N = 1<<22; // arguments per timing run, and per block of the error measurement
+const unsigned error_blocks = 4; // 2^24 arguments per range for the error columns
+const unsigned n_cases = 4096; // fitness cases per program run
+const unsigned repeats = 20;
+
+static double seconds(chrono::steady_clock::time_point t0)
+{
+  return chrono::duration<double>(chrono::steady_clock::now()-t0).count();
+}
+
+static double ulps(double a, double b) // distance of a from the reference b, in units in the last place of b
+{
+  if (a==b)
+    return 0;
+  if (!isfinite(a) || !isfinite(b))
+    return HUGE_VAL;
+  return fabs(a-b) / (nextafter(fabs(b), HUGE_VAL) - fabs(b));
+}
+
+static double sink = 0; // keeps the compiler from dropping the loops
+
+//
+// Kernels on arrays: libm, the scalar kernel, the batched kernel
+//
+struct LibmExp { double operator()(double x, double p) const { return exp(x); } };
+struct LibmLog { double operator()(double x, double p) const { return log(x); } };
+struct LibmSin { double operator()(double x, double p) const { return sin(x); } };
+struct LibmPow { double operator()(double x, double p) const { return pow(x, p); } };
+struct FastExp { double operator()(double x, double p) const { return SlashA::Math::exp(x); } };
+struct FastLog { double operator()(double x, double p) const { return SlashA::Math::log(x); } };
+struct FastSin { double operator()(double x, double p) const { return SlashA::Math::sin(x); } };
+struct FastPow { double operator()(double x, double p) const { return SlashA::Math::pow(x, p); } };
+
+template <class F>
+static double timeScalar(const F& f, const vector<double>& x, const vector<double>& p, vector<double>& y)
+{
+  chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+  for (unsigned i=0;i<N;i++)
+    y[i] = f(x[i], p[i]);
+  return seconds(t0);
+}
+
+typedef function<void(mt19937_64&, double&, double&)> ArgGen; // one argument (and exponent, for pow)
+typedef function<double(double, double)> UlpBound; // the documented error at an argument, in ulp
+
+template <class Libm, class Fast>
+static void benchKernel(const char* name, const char* range, const Libm& libm, const Fast& fast,
+                        void (*batch)(const double*, const double*, double*, unsigned),
+                        const ArgGen& gen, const UlpBound& bound)
+{
+  mt19937_64 rng(1);
+  vector<double> x(N), p(N), y(N), ys(N), ref(N);
+  double t_libm = 0, t_scalar = 0, t_batch = 0;
+  double max_ulp = 0, max_rel = 0; // max_rel: error over the documented bound
+  bool same = true; // scalar and batched kernels agree bit for bit
+
+  for (unsigned blk=0;blk<error_blocks;blk++) {
+    for (unsigned i=0;i<N;i++)
+      gen(rng, x[i], p[i]);
+
+    const double tl = timeScalar(libm, x, p, ref);
+    const double ts = timeScalar(fast, x, p, ys);
+    chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+    batch(&x[0], &p[0], &y[0], N);
+    const double tb = seconds(t0);
+    if (blk==0) {
+      t_libm = tl;
+      t_scalar = ts;
+      t_batch = tb;
+    }
+    sink += y[N/2];
+
+    for (unsigned i=0;i<N;i++) {
+      const double u = ulps(y[i], ref[i]);
+      max_ulp = max(max_ulp, u);
+      max_rel = max(max_rel, u/bound(x[i], p[i]));
+      same &= (memcmp(&y[i], &ys[i], sizeof(double))==0);
+    }
+  }
+
+  printf("%-4s %-14s %8.1f %8.1f %8.1f %8.0f %8.2f %6s\n", name, range, N/t_libm/1e6, N/t_scalar/1e6,
+         N/t_batch/1e6, max_ulp, max_rel, same ? "yes" : "NO");
+}
+
+static void batchExp(const double* x, const double* p, double* y, unsigned n) { SlashA::Math::exp(x, y, n); }
+static void batchLog(const double* x, const double* p, double* y, unsigned n) { SlashA::Math::log(x, y, n); }
+static void batchSin(const double* x, const double* p, double* y, unsigned n) { SlashA::Math::sin(x, y, n); }
+static void batchPow(const double* x, const double* p, double* y, unsigned n) { SlashA::Math::pow(x, p, y, n); }
+
+//
+// Instructions: a program applying the operation to every fitness case
+//
+static void benchInstruction(const char* name, const char* source, SlashA::FitnessCases& cases)
+{
+  SlashA::InstructionSet iset(32768);
+  iset.insert_DIS_full();
+  SlashA::ByteCode bc;
+  SlashA::source2ByteCode(source, bc, iset);
+
+  vector<double> no_input, no_output;
+  SlashA::MemCore core(10, 10, no_input, no_output);
+  SlashA::LockstepEvaluator lockstep(10, 10);
+  atomic<bool> stop(false);
+  SlashA::EvalResult res;
+  double t[3];
+
+  for (unsigned mode=0;mode<3;mode++) {
+    iset.setMathMode( (mode==0) ? SlashA::MATH_LIBM : SlashA::MATH_FAST );
+    chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+    for (unsigned r=0;r<repeats;r++) {
+      if (mode<2)
+        SlashA::runFitnessCases(iset, core, bc, cases, 1, stop, -1, res);
+      else
+        lockstep.run(iset, bc, cases, 1, res);
+      sink += res.outputs[0].size() ? res.outputs[0][0] : 0;
+    }
+    t[mode] = seconds(t0);
+  }
+
+  const double n = (double)repeats*n_cases;
+  printf("%-4s %10.1f %10.1f %10.1f\n", name, n/t[0]/1e6, n/t[1]/1e6, n/t[2]/1e6);
+}
+
+int main(int argc, char** argv)
+{
+  printf("math-bench -- %s\n\n", SlashA::getHeader().c_str());
+
+  mt19937_64 gen(1);
+  uniform_real_distribution<double> u(0, 1);
+  uniform_int_distribution<int> normal_exp(-1022, 1023), int_exp(-20, 20);
+  const UlpBound one_ulp = [](double, double) { return 1.0; };
+  const UlpBound pow_ulp = [](double x, double y) { return 1.0 + 2.1*fabs(y*log(fabs(x))); };
+
+  printf("Kernels: millions of values per second on 2^22 arguments; largest error against libm over 2^24\n");
+  printf("arguments, in ulp and as a fraction of the bound in lib/SlashA_Math.hpp; scalar = batched bit for bit\n");
+  printf("op   range              libm   scalar  batched  max ulp    bound    s=b\n");
+  benchKernel("exp", "|x| <= 708", LibmExp(), FastExp(), batchExp,
+              [&](mt19937_64& r, double& x, double& p) { x = -708 + 1416*u(r); }, one_ulp);
+  benchKernel("log", "x normal", LibmLog(), FastLog(), batchLog,
+              [&](mt19937_64& r, double& x, double& p) { x = ldexp(1 + u(r), normal_exp(r)); }, one_ulp);
+  benchKernel("sin", "|x| <= 10", LibmSin(), FastSin(), batchSin,
+              [&](mt19937_64& r, double& x, double& p) { x = -10 + 20*u(r); }, one_ulp);
+  benchKernel("sin", "|x| <= 5e5", LibmSin(), FastSin(), batchSin,
+              [&](mt19937_64& r, double& x, double& p) { x = -5e5 + 1e6*u(r); },
+              [](double, double) { return 2.0; });
+  benchKernel("pow", "x > 0", LibmPow(), FastPow(), batchPow,
+              [&](mt19937_64& r, double& x, double& p) { x = pow(10.0, -3 + 6*u(r)); p = -10 + 20*u(r); }, pow_ulp);
+  benchKernel("pow", "x < 0, y int", LibmPow(), FastPow(), batchPow,
+              [&](mt19937_64& r, double& x, double& p) { x = -pow(10.0, -3 + 6*u(r)); p = int_exp(r); }, pow_ulp);
+
+  SlashA::FitnessCases one(n_cases), two(n_cases);
+  for (unsigned k=0;k<n_cases;k++) {
+    one[k].push_back(0.1 + 10*u(gen));
+    two[k].push_back(0.1 + 10*u(gen));
+    two[k].push_back(-3 + 6*u(gen));
+  }
+
+  printf("\nInstructions, millions of fitness cases per second (%u cases per run)\n", n_cases);
+  printf("op         libm  fast-math   lockstep\n");
+  benchInstruction("exp", "input/exp/output/.", one);
+  benchInstruction("log", "input/log/output/.", one);
+  benchInstruction("sin", "input/sin/output/.", one);
+  benchInstruction("pow", "input/0/save/input/pow/output/.", two);
+
+  return (sink==12345.678) ? 1 : 0;
+}
@@ -25,6 +25,7 @@ using namespace std;
 
 #include <iostream>
 #include <fstream>
+#include <sstream>
 #include <string>
 #include <cmath>
 #include "SlashA.hpp"
@@ -56,7 +57,6 @@ int main(int argc, char** argv)
     exit(1);
   }
 
-  string source = "";
   ifstream f(argv[1]);
 
   if (!f) {
@@ -64,8 +64,9 @@ int main(int argc, char** argv)
     exit(1);
   }
   
-  while (!f.eof())
-    source += f.get();
+  stringstream buf;
+  buf << f.rdbuf(); // the whole file at once
+  const string source = buf.str();
 
   f.close();
   
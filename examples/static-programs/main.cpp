@@ -0,0 +1,80 @@
+/*
+ *
+ *  static-programs
+ *
+ *  Slash/A programs translated into ByteCode by the compiler (see lib/SlashA_Static.hpp): nothing is read
+ *  or parsed when the binary starts, and a typo in a program stops the build.
+ *
+ *  Copyright (C) 2004-2011 Artur B Adib
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <iostream>
+#include <atomic>
+#include "SlashA.hpp"
+#include "SlashA_Static.hpp"
+
+using namespace std;
+
+// The contents of slash/examples/power4.sla and add.sla
+SLASHA_STATIC_PROGRAM(power4, 32768, SlashA::DIS_full_names, R"sla(
+# raises an input to the power of 4
+
+4/itof/0/save/input/pow/output/.
+)sla");
+
+SLASHA_STATIC_PROGRAM(add, 32768, SlashA::DIS_full_names, R"sla(
+input/   # gets an input from user and saves it to register F
+0/       # sets register I = 0
+save/    # saves content of F into data vector D[I] (i.e. D[0])
+input/   # gets another input, saves to F
+add/     # adds to F current data pointed to by I (i.e. D[0])
+output/. # outputs result from F
+)sla");
+
+// Would not compile: "Instruction not recognized" at compile time
+// SLASHA_STATIC_PROGRAM(typo, 32768, SlashA::DIS_full_names, "input/outptu/.");
+
+static_assert(power4.length==7, "power4 has 7 instructions");
+static_assert(power4.code[1]==32768+8, "itof is the 9th DIS instruction");
+
+int main()
+{
+  SlashA::InstructionSet iset(32768);
+  iset.insert_DIS_full();
+
+  if ( !power4.matches(iset) || !add.matches(iset) ) { // the opcodes were computed for another layout
+    cout << "Instruction set does not match the embedded programs" << endl;
+    return 1;
+  }
+
+  vector<double> input, output;
+  SlashA::MemCore core(10, 10, input, output);
+  atomic<bool> stop(false);
+  SlashA::FitnessCases cases = { {2}, {3}, {1.5} };
+  SlashA::EvalResult res;
+
+  SlashA::runFitnessCases(iset, core, power4.view(), cases, -2237, stop, -1, res);
+  for (unsigned k=0;k<res.outputs.size();k++)
+    cout << cases[k][0] << "^4 = " << res.outputs[k][0] << endl;
+
+  cases = { {1, 2}, {10, -3} };
+  SlashA::runFitnessCases(iset, core, add.view(), cases, -2237, stop, -1, res);
+  for (unsigned k=0;k<res.outputs.size();k++)
+    cout << cases[k][0] << " + " << cases[k][1] << " = " << res.outputs[k][0] << endl;
+
+  return 0;
+}
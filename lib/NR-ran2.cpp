@@ -1,3 +1,5 @@
+#include "NR-ran2.hpp"
+
 namespace NumericalRecipes
 {
 
@@ -16,13 +18,11 @@ namespace NumericalRecipes
 #define EPS 1.2e-7
 #define RNMX (1.0-EPS)
 
-float ran2(long *idum)
+// The generator of Numerical Recipes, with its state passed in rather than static
+static float ran2(long *idum, long& idum2, long& iy, long* iv)
 {
 	int j;
 	long k;
-	static long idum2=123456789;
-	static long iy=0;
-	static long iv[NTAB];
 	float temp;
 
 	if (*idum <= 0) {
@@ -50,6 +50,20 @@ float ran2(long *idum)
 	if ((temp=AM*iy) > RNMX) return RNMX;
 	else return temp;
 }
+
+float ran2(long *idum)
+{
+	static long idum2=123456789;
+	static long iy=0;
+	static long iv[NTAB];
+
+	return ran2(idum, idum2, iy, iv);
+}
+
+float ran2(Ran2State& s)
+{
+	return ran2(&s.idum, s.idum2, s.iy, s.iv);
+}
 #undef IM1
 #undef IM2
 #undef AM
@@ -1,4 +1,17 @@
 
+#ifndef NR_RAN2_INCLUDED // duplicate protection
+#define NR_RAN2_INCLUDED
+
 namespace NumericalRecipes {
-  float ran2(long *idum);
+  struct Ran2State // everything ran2() keeps between calls; a non-positive idum (re)initializes the rest
+  {
+    long idum, idum2, iy;
+    long iv[32];
+    Ran2State() : idum(-1), idum2(123456789), iy(0) { for (unsigned j=0;j<32;j++) iv[j] = 0; }
+  };
+
+  float ran2(long *idum); // one state for the whole process
+  float ran2(Ran2State& s); // reentrant
 };
+
+#endif // NR_RAN2_INCLUDED
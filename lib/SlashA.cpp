@@ -22,10 +22,13 @@
 #include <iostream>
 #include <string>
 #include <ctime>
+#include <algorithm>
 #include <unistd.h> // contains the alarm() function used for timing-out the interpreter
 #include <signal.h> // contains the signal() function to handle the alarm
 #include "SlashA.hpp"
 #include "SlashA_DIS.hpp"
+#include "SlashA_Interp.hpp"
+#include "SlashA_Metrics.hpp"
 
 using namespace std;
 
@@ -54,100 +57,111 @@ void alarm_handler(int sign) { timedout=true; }; // alarm for the runByteCode()
 //
 
 
-void InstructionSet::insert_DIS_IO()
+template <class T>
+void BasicInstructionSet<T>::insert_DIS_IO()
 {
   Instruction* setiptr;
   // input/output
-  setiptr = new DIS::Input(); insert(setiptr);
-  setiptr = new DIS::Output(); insert(setiptr);
+  setiptr = new DIS::Input<T>(); insert(setiptr);
+  setiptr = new DIS::Output<T>(); insert(setiptr);
 }
 
-void InstructionSet::insert_DIS_memreg()
+template <class T>
+void BasicInstructionSet<T>::insert_DIS_memreg()
 {
   Instruction* setiptr;
 
   // memory-register commands
-  setiptr = new DIS::Load(); insert(setiptr);
-  setiptr = new DIS::Save(); insert(setiptr);
-  setiptr = new DIS::Swap(); insert(setiptr);
-  setiptr = new DIS::Cmp(); insert(setiptr);
+  setiptr = new DIS::Load<T>(); insert(setiptr);
+  setiptr = new DIS::Save<T>(); insert(setiptr);
+  setiptr = new DIS::Swap<T>(); insert(setiptr);
+  setiptr = new DIS::Cmp<T>(); insert(setiptr);
 };
 
-void InstructionSet::insert_DIS_regreg()
+template <class T>
+void BasicInstructionSet<T>::insert_DIS_regreg()
 {
   Instruction* setiptr;
   // register-register commands
-  setiptr = new DIS::Inc(); insert(setiptr);
-  setiptr = new DIS::Dec(); insert(setiptr);
-  setiptr = new DIS::ItoF(); insert(setiptr);
-  setiptr = new DIS::FtoI(); insert(setiptr);
+  setiptr = new DIS::Inc<T>(); insert(setiptr);
+  setiptr = new DIS::Dec<T>(); insert(setiptr);
+  setiptr = new DIS::ItoF<T>(); insert(setiptr);
+  setiptr = new DIS::FtoI<T>(); insert(setiptr);
 }
 
-void InstructionSet::insert_DIS_gotos()
+template <class T>
+void BasicInstructionSet<T>::insert_DIS_gotos()
 {
   Instruction* setiptr;
   // flow control: gotos
-  setiptr = new DIS::Label(); insert(setiptr);
-  setiptr = new DIS::GotoIfP(); insert(setiptr);
+  setiptr = new DIS::Label<T>(); insert(setiptr);
+  setiptr = new DIS::GotoIfP<T>(); insert(setiptr);
 }
 
-void InstructionSet::insert_DIS_jumps()
+template <class T>
+void BasicInstructionSet<T>::insert_DIS_jumps()
 {
   Instruction* setiptr;
   // flow control: jumps
-  setiptr = new DIS::JumpIfN(); insert(setiptr);
-  setiptr = new DIS::JumpHere(); insert(setiptr);
+  setiptr = new DIS::JumpIfN<T>(); insert(setiptr);
+  setiptr = new DIS::JumpHere<T>(); insert(setiptr);
 }
 
-void InstructionSet::insert_DIS_loops() 
+template <class T>
+void BasicInstructionSet<T>::insert_DIS_loops() 
 {
   Instruction* setiptr;
   // flow control: loops
-  setiptr = new DIS::Loop(); insert(setiptr);
-  setiptr = new DIS::EndLoop(); insert(setiptr);
+  setiptr = new DIS::Loop<T>(); insert(setiptr);
+  setiptr = new DIS::EndLoop<T>(); insert(setiptr);
 }
 
-void InstructionSet::insert_DIS_basicmath()
+template <class T>
+void BasicInstructionSet<T>::insert_DIS_basicmath()
 {
   Instruction* setiptr;
   // basic math
-  setiptr = new DIS::Add(); insert(setiptr);
-  setiptr = new DIS::Sub(); insert(setiptr);
-  setiptr = new DIS::Mul(); insert(setiptr);
-  setiptr = new DIS::Div(); insert(setiptr);
+  setiptr = new DIS::Add<T>(); insert(setiptr);
+  setiptr = new DIS::Sub<T>(); insert(setiptr);
+  setiptr = new DIS::Mul<T>(); insert(setiptr);
+  setiptr = new DIS::Div<T>(); insert(setiptr);
 }
 
-void InstructionSet::insert_DIS_advmath()
+template <class T>
+void BasicInstructionSet<T>::insert_DIS_advmath()
 {
   Instruction* setiptr;
   // advanced math
-  setiptr = new DIS::Abs(); insert(setiptr);
-  setiptr = new DIS::Sign(); insert(setiptr);
-  setiptr = new DIS::Exp(); insert(setiptr);
-  setiptr = new DIS::Log(); insert(setiptr);
-  setiptr = new DIS::Sin(); insert(setiptr);
-  setiptr = new DIS::Pow(); insert(setiptr);
-  setiptr = new DIS::Ran(); insert(setiptr);
+  setiptr = new DIS::Abs<T>(); insert(setiptr);
+  setiptr = new DIS::Sign<T>(); insert(setiptr);
+  setiptr = new DIS::Exp<T>(); insert(setiptr);
+  setiptr = new DIS::Log<T>(); insert(setiptr);
+  setiptr = new DIS::Sin<T>(); insert(setiptr);
+  setiptr = new DIS::Pow<T>(); insert(setiptr);
+  setiptr = new DIS::Ran<T>(); insert(setiptr);
 }
 
-void InstructionSet::insert_DIS_misc()
+template <class T>
+void BasicInstructionSet<T>::insert_DIS_vector()
 {
   Instruction* setiptr;
-  // misc
-  setiptr = new DIS::Nop(); insert(setiptr);
+  // data-tape ranges
+  setiptr = new DIS::RSum<T>(); insert(setiptr);
+  setiptr = new DIS::Dot<T>(); insert(setiptr);
+  setiptr = new DIS::RScale<T>(); insert(setiptr);
+  setiptr = new DIS::Horner<T>(); insert(setiptr);
 }
 
-void InstructionSet::insert_DIS_numeric(ByteCode_Type n_num)
+template <class T>
+void BasicInstructionSet<T>::insert_DIS_misc()
 {
   Instruction* setiptr;
-  
-  for (ByteCode_Type i=0;i<n_num;i++) {
-    setiptr = new DIS::SetI(i);
-    insert(setiptr);
-  }
+  // misc
+  setiptr = new DIS::Nop<T>(); insert(setiptr);
 }
 
-void InstructionSet::insert_DIS_full()
+template <class T>
+void BasicInstructionSet<T>::insert_DIS_full()
 {
   insert_DIS_IO(); // input/output commands
   insert_DIS_memreg(); // memory-register commands
@@ -160,7 +174,8 @@ void InstructionSet::insert_DIS_full()
   insert_DIS_misc(); // everything else
 }
 
-void InstructionSet::insert_DIS_full_minus_Gotos() // avoids infinite loops
+template <class T>
+void BasicInstructionSet<T>::insert_DIS_full_minus_Gotos() // avoids infinite loops
 {
   insert_DIS_IO(); // input/output commands
   insert_DIS_memreg(); // memory-register commands
@@ -172,35 +187,128 @@ void InstructionSet::insert_DIS_full_minus_Gotos() // avoids infinite loops
   insert_DIS_misc(); // everything else
 }
 
-void InstructionSet::remove_DIS()
+template <class T>
+void BasicInstructionSet<T>::remove_DIS()
 {
   for (unsigned i=0;i<set.size();i++)
     if (set[i]->isDIS()) // only deallocates memory if it's a DIS instruction (users must deallocate their own instructions!!)
       delete set[i]; 
 }
 
+template <class T>
+void BasicInstructionSet<T>::indexNames()
+{
+  name_index.clear();
+  for (unsigned i=0;i<set.size();i++)
+    name_index.emplace(set[i]->getName(), n_numericinst+i); // emplace keeps the first occurrence, as the old linear search did
+  name_index_ok = true;
+}
+
+template <class T>
+size_t BasicInstructionSet<T>::memoryBytes() const
+{
+  size_t n = sizeof(*this) + set.capacity()*sizeof(Instruction*);
+  for (unsigned i=0;i<set.size();i++)
+    n += set[i]->memoryBytes();
+
+  // The name index, assuming nodes that hold the next pointer, the entry and its cached hash
+  const size_t node = sizeof(void*) + sizeof(std::pair<const std::string, ByteCode_Type>) + sizeof(size_t);
+  n += name_index.bucket_count()*sizeof(void*) + name_index.size()*node;
+  for (unordered_map<string, ByteCode_Type>::const_iterator it=name_index.begin();it!=name_index.end();++it)
+    n += heapBytes(it->first);
+  return n;
+}
+
+template <class T>
+ByteCode_Type BasicInstructionSet<T>::lookup(const char* word, unsigned len)
+{
+  if ( (len>0) && (len<=9) && ((word[0]!='0') || (len==1)) ) { // numeric instructions are named after their value
+    ByteCode_Type n = 0;
+    unsigned i;
+    for (i=0;(i<len) && (word[i]>='0') && (word[i]<='9');i++)
+      n = n*10 + (word[i]-'0');
+    if ( (i==len) && (n<n_numericinst) )
+      return n;
+  }
+
+  if (!name_index_ok)
+    indexNames();
+
+  unordered_map<string, ByteCode_Type>::const_iterator it = name_index.find(string(word, len));
+  if (it==name_index.end())
+    throw (string)"Instruction not recognized: " + string(word, len);
+  return it->second;
+}
+
+template <class T>
+unsigned BasicInstructionSet<T>::nameLength(ByteCode_Type inst_num)
+{
+  if (inst_num<n_numericinst) {
+    unsigned len = 1;
+    for (ByteCode_Type n=inst_num;n>=10;n/=10)
+      len++;
+    return len;
+  }
+  return set[inst_num-n_numericinst]->getName().size();
+}
+
+template <class T>
+char* BasicInstructionSet<T>::writeName(ByteCode_Type inst_num, char* out)
+{
+  if (inst_num<n_numericinst) {
+    char digits[10];
+    unsigned len = 0;
+    do {
+      digits[len++] = '0' + inst_num%10;
+      inst_num /= 10;
+    } while (inst_num);
+    while (len)
+      *out++ = digits[--len];
+    return out;
+  }
+  const string& name = set[inst_num-n_numericinst]->getName();
+  return copy(name.begin(), name.end(), out);
+}
+
+template <class T>
+string BasicInstructionSet<T>::getName(int inst_num)
+{
+  if ((unsigned)inst_num>=n_numericinst)
+    return set[inst_num-n_numericinst]->getName();
+
+  char digits[16];
+  return string(digits, writeName(inst_num, digits));
+}
+
 //
 //  Class: MemCore
 //
 
 // Constructor
-MemCore::MemCore(const unsigned _Dsize, 
-                 const unsigned _Lsize,
-                 vector<double>& _input,
-                 vector<double>& _output)
+template <class T>
+BasicMemCore<T>::BasicMemCore(const unsigned _Dsize, 
+                              const unsigned _Lsize,
+                              vector<double>& _input,
+                              vector<double>& _output)
 {
   D_size = _Dsize;
   L_size = _Lsize;
   input = &_input;
   output = &_output;
   output_executed = false;
+  in_pos = out_pos = 0;
+  input_log = NULL;
 
   F = I = c = 0; 
-  D = new double[D_size];
+  C = NULL;
+  C32 = NULL;
+  C16 = NULL;
+  C_size = 0;
+  D = new T[D_size];
   D_saved = new bool[D_size];
   L = new unsigned[L_size];
   L_saved = new bool[L_size];
-  ran_ptr = new long;
+  ran_ptr = &ran.idum;
 
   for (unsigned i=0;i<D_size;i++) {
     D[i] = 0;
@@ -213,14 +321,93 @@ MemCore::MemCore(const unsigned _Dsize,
   }
 };
 
+template <class T>
+BasicMemCore<T>::BasicMemCore(const unsigned _Dsize,
+                              const unsigned _Lsize,
+                              const IOPolicy& _io)
+  : BasicMemCore(_Dsize, _Lsize, own_input, own_output)
+{
+  io = _io;
+}
+
 // Destructor
-MemCore::~MemCore()
+template <class T>
+BasicMemCore<T>::~BasicMemCore()
 {
   delete[] D; 
   delete[] D_saved; 
   delete[] L; 
   delete[] L_saved; 
-  delete ran_ptr;
+}
+
+
+// Reset
+template <class T>
+void BasicMemCore<T>::reset()
+{
+  F = I = c = 0;
+  output_executed = false;
+  rewindIO();
+
+  for (unsigned i=0;i<D_size;i++) {
+    D[i] = 0;
+    D_saved[i] = false;
+  }
+
+  for (unsigned i=0;i<L_size;i++) {
+    L[i] = 0;
+    L_saved[i] = false;
+  }
+
+  L_table_addr.clear(); // forces the loop-table to be rebuilt for the next program
+  L_table_count.clear();
+  J_table.clear();
+}
+
+template <class T>
+size_t BasicMemCore<T>::memoryBytes() const
+{
+  return sizeof(*this)
+       + D_size*(sizeof(T)+sizeof(bool)) + L_size*(sizeof(unsigned)+sizeof(bool)) // tapes and their flags
+       + tableBytes()
+       + (own_input.capacity()+own_output.capacity())*sizeof(double);
+}
+
+template <class T>
+void BasicMemCore<T>::save(CoreState& s) const
+{
+  s.F = F;
+  s.I = I;
+  s.in_pos = in_pos;
+  s.out_pos = out_pos;
+  s.D.assign(D, D+D_size);
+  s.D_saved.assign(D_saved, D_saved+D_size);
+  s.L.assign(L, L+L_size);
+  s.L_saved.assign(L_saved, L_saved+L_size);
+  s.output_executed = output_executed;
+  s.outputs = *output;
+}
+
+template <class T>
+void BasicMemCore<T>::restore(const CoreState& s)
+{
+  if ( (s.D.size()!=D_size) || (s.L.size()!=L_size) )
+    throw (string)"CoreState does not match the size of the memory core";
+
+  F = s.F;
+  I = s.I;
+  in_pos = s.in_pos;
+  out_pos = s.out_pos;
+  for (unsigned i=0;i<D_size;i++) {
+    D[i] = s.D[i];
+    D_saved[i] = s.D_saved[i];
+  }
+  for (unsigned i=0;i<L_size;i++) {
+    L[i] = s.L[i];
+    L_saved[i] = s.L_saved[i];
+  }
+  output_executed = s.output_executed;
+  *output = s.outputs;
 }
 
 
@@ -230,6 +417,18 @@ MemCore::~MemCore()
  *
  */
 
+bool consoleInput(unsigned n, double& x)
+{
+  cout << "Enter input #" << n+1 << ": ";
+  cin >> x;
+  return true;
+}
+
+void consoleOutput(unsigned n, double x)
+{
+  cout << "Output #" << n+1 << ": " << x << endl;
+}
+
 string getHeader()
 {
 #ifndef DEBUG
@@ -240,83 +439,125 @@ string getHeader()
 }
 
 
-ByteCode_Type instruction2ByteCode( string inst, 
-                                            InstructionSet& iset )
+template <class T>
+void compactByteCode( const ByteCode& bc,
+                      ByteCode16& bc16,
+                      BasicInstructionSet<T>& iset )
 {
-  for (ByteCode_Type i=0;i<iset.size();i++)
-    if (inst == iset.getName(i) )
-      return i;
+  if (iset.size()>65536)
+    throw (string)"Instruction set too large for the 16-bit encoding";
 
-  throw (string)"Instruction not recognized: " + inst;
+  bc16.resize(bc.size());
+  for (unsigned i=0;i<bc.size();i++)
+    bc16[i] = (ByteCode16_Type)bc[i];
 }
 
 
-void source2ByteCode( string src,
+void expandByteCode( const ByteCode16& bc16,
+                     ByteCode& bc )
+{
+  bc.assign(bc16.begin(), bc16.end());
+}
+
+
+template <class T>
+ByteCode_Type instruction2ByteCode( const string& inst, 
+                                    BasicInstructionSet<T>& iset )
+{
+  return iset.lookup(inst.data(), inst.size());
+}
+
+
+template <class T>
+void source2ByteCode( const string& src,
                       ByteCode& bc,
-                      InstructionSet& iset )
+                      BasicInstructionSet<T>& iset )
+{
+  parseProgram(src.data(), src.data()+src.size(), bc, iset);
+} // Source2ByteCode()
+
+
+// Parses one program from [begin, end) into bc. Words are assembled in a small stack buffer, so nothing is
+// allocated per word and the source never has to be copied or split beforehand.
+template <class T>
+const char* parseProgram( const char* begin,
+                          const char* end,
+                          ByteCode& bc,
+                          BasicInstructionSet<T>& iset )
 {
   bool seeking_next_line = false;
-  string instr;
+  char instr[maxWordLen];
+  unsigned len = 0;
 
   bc.clear();
 
-  for (unsigned c=0;c<src.size();c++) {
+  const char* c;
+  for (c=begin;c<end;c++) {
 
     if ( seeking_next_line ) {
-      if (src[c]==10) // line-feed found?
+      if (*c==10) // line-feed found?
         seeking_next_line = false;
       continue;
     }
 
-    else if (src[c] == '.') // a dot signals end of program
-      break;
+    else if (*c == '.') // a dot signals end of program
+      return c+1;
 
-    else if (src[c]=='/') { // instruction reading is done
-      try 
-      {
-        bc.push_back( instruction2ByteCode(instr, iset) );
-        instr.clear();
-      }
-      catch(string& err)
-      {
-        throw err;
-      }
+    else if (*c=='/') { // instruction reading is done
+      bc.push_back( iset.lookup(instr, len) );
+      len = 0;
     }
 
-    else if (src[c] == ' ') {} // spaces are ignored altogether
+    else if (*c == ' ') {} // spaces are ignored altogether
 
-    else if (src[c] == 10) {} // line-feeds are ignored
+    else if (*c == 10) {} // line-feeds are ignored
 
-    else if (src[c] == 9) {} // tabs are ignored as well
+    else if (*c == 9) {} // tabs are ignored as well
 
-    else if (src[c] == '#') // interpreter will ignore rest of the line
+    else if (*c == '#') // interpreter will ignore rest of the line
       seeking_next_line = true;
 
     else {
-      instr += src[c];
-      if (instr.size() > maxWordLen)
-        throw (string)"Instruction word is too large: " + instr;
+      if (len == maxWordLen)
+        throw (string)"Instruction word is too large: " + string(instr, len) + *c;
+      instr[len++] = *c;
     } // ifs
 
   } // for
 
-} // Source2ByteCode()
+  return c;
+} // parseProgram()
 
 
+template <class T>
 void bytecode2Source( ByteCode& bc,
                       string& src,
-                      InstructionSet& iset )
+                      BasicInstructionSet<T>& iset )
 {
-  src.clear();
+  unsigned size = 1;
   for (unsigned i=0;i<bc.size();i++)
-    src += iset.getName(bc[i]) + "/";
-  src += ".";
+    size += iset.nameLength(bc[i]) + 1;
+
+  src.resize(size);
+  char* out = &src[0];
+  for (unsigned i=0;i<bc.size();i++) {
+    out = iset.writeName(bc[i], out);
+    *out++ = '/';
+  }
+  *out = '.';
 }
 
 
+struct AlarmTimedOut // stop condition driven by the SIGALRM handler
+{
+  inline bool operator()() const { return timedout; }
+};
+
+
 // Runs a given ByteCode, returns true if timed-out.
-bool runByteCode(InstructionSet& iset,
-                 MemCore& core,
+template <class T>
+bool runByteCode(BasicInstructionSet<T>& iset,
+                 BasicMemCore<T>& core,
                  ByteCode& bc,
                  long randseed,
                  long max_rtime,
@@ -325,8 +566,11 @@ bool runByteCode(InstructionSet& iset,
   if (!max_rtime)
     max_rtime = 3600*24*7; // that's a week's worth of runtime!
 
-  core.C = &bc;
+  const uint64_t t0 = metricsEnabled() ? metricsClock() : 0;
+  core.setProgram(bc);
   core.c = 0;  
+  *core.ran_ptr = (randseed>0) ? -randseed : randseed; // a non-positive seed (re)initializes ran2()
+  core.beginRun();
   iset.clear();
 
 #ifndef DEBUG
@@ -338,33 +582,331 @@ bool runByteCode(InstructionSet& iset,
   
   iset.setMaxLoopDepth(max_loop_depth);
 
-  try
-  {
-    do {
-#ifdef DEBUG
-      cout << " [I]=" << core.I << ", [F]=" << core.F << ", D[I]=" << core.D[core.I] << endl;
-      cout << " Next instruction: " << iset.getName((*core.C)[core.c]) << ". (hit enter)";
-      cin.get();
-      cout << endl;
-#endif
-      iset.exec((*core.C)[core.c], core);
-      core.c++;
-    } while ( (core.c<(*core.C).size()) && (!timedout) );
-  }
-  catch(int whatever)
-  {
-    return true; // program failed 
-  }
+  bool failed = execLoop(iset, core, AlarmTimedOut());
   
 #ifndef DEBUG
   alarm(0); // turns off alarm
 #endif
 
-  if (timedout)
-    return true; // interpreter timed-out
+  if (metricsEnabled())
+    recordEvaluation(t0, 1, iset.getTotalOps(), iset.getTotalInvops(), timedout ? 1 : 0, (failed && !timedout) ? 1 : 0);
+
+  if (failed || timedout)
+    return true; // program failed or interpreter timed-out
   else
     return false;
 } // runByteCode
 
 
+// Same as runByteCode(), but instead of the process-wide SIGALRM timer the program is stopped as soon as another
+// thread raises "stop". This is the variant to use when several interpreters run concurrently.
+// Returns true if the program failed or was stopped.
+template <class T>
+bool runByteCodeUntil(BasicInstructionSet<T>& iset,
+                      BasicMemCore<T>& core,
+                      ByteCode& bc,
+                      long randseed,
+                      const std::atomic<bool>& stop,
+                      int max_loop_depth)
+{
+  core.setProgram(bc);
+  core.c = 0;
+  *core.ran_ptr = (randseed>0) ? -randseed : randseed; // a non-positive seed (re)initializes ran2()
+  core.beginRun();
+  iset.clear();
+  iset.setMaxLoopDepth(max_loop_depth);
+
+  bool failed = execLoop(iset, core, FlagRaised(stop));
+
+  return failed || stop.load(std::memory_order_relaxed);
+} // runByteCodeUntil
+
+
+// Same as runByteCodeUntil(), for a program in the compact 16-bit encoding. core.C is NULL while it runs,
+// so user-defined instructions must access the program through core.codeAt()/codeSize().
+template <class T>
+bool runByteCode16(BasicInstructionSet<T>& iset,
+                   BasicMemCore<T>& core,
+                   ByteCode16& bc,
+                   long randseed,
+                   const std::atomic<bool>& stop,
+                   int max_loop_depth)
+{
+  core.setProgram(bc);
+  core.c = 0;
+  *core.ran_ptr = (randseed>0) ? -randseed : randseed;
+  core.beginRun();
+  iset.clear();
+  iset.setMaxLoopDepth(max_loop_depth);
+
+  Tape16 tape;
+  NoHook hook;
+  bool failed = execLoop(iset, core, FlagRaised(stop), hook, tape);
+
+  return failed || stop.load(std::memory_order_relaxed);
+} // runByteCode16
+
+
+// Same as runByteCodeUntil(), for a program held elsewhere. core.C is NULL while it runs, as for runByteCode16().
+template <class T>
+bool runProgram(BasicInstructionSet<T>& iset,
+                BasicMemCore<T>& core,
+                const ProgramView& p,
+                long randseed,
+                const std::atomic<bool>& stop,
+                int max_loop_depth)
+{
+  core.setProgram(p);
+  core.c = 0;
+  *core.ran_ptr = (randseed>0) ? -randseed : randseed;
+  core.beginRun();
+  iset.clear();
+  iset.setMaxLoopDepth(max_loop_depth);
+
+  bool failed = execLoop(iset, core, FlagRaised(stop));
+
+  return failed || stop.load(std::memory_order_relaxed);
+} // runProgram
+
+
+template <class T>
+void startProgram(BasicMemCore<T>& core,
+                  const ProgramView& p,
+                  long randseed)
+{
+  core.setProgram(p);
+  core.c = 0;
+  *core.ran_ptr = (randseed>0) ? -randseed : randseed;
+  core.beginRun();
+} // startProgram
+
+
+template <class T>
+RunStatus resumeProgram(BasicInstructionSet<T>& iset,
+                        BasicMemCore<T>& core,
+                        unsigned long quantum,
+                        unsigned long& executed)
+{
+  QuantumSpent spent(quantum);
+  const bool failed = execLoop(iset, core, spent);
+
+  executed = quantum - spent.left;
+  if (failed)
+    return RUN_FAILED;
+  return (core.c<core.C_size) ? RUN_SUSPENDED : RUN_FINISHED;
+} // resumeProgram
+
+
+// As runByteCodeUntil() or runProgram(), starting from "initial" if given. The state is restored after
+// beginRun(), so that the input and output positions carry over.
+template <class T, class Program>
+static inline bool runOnce(BasicInstructionSet<T>& iset, BasicMemCore<T>& core, Program& bc, const CoreState* initial,
+                           long randseed, const std::atomic<bool>& stop, int max_loop_depth)
+{
+  core.setProgram(bc);
+  core.c = 0;
+  *core.ran_ptr = (randseed>0) ? -randseed : randseed;
+  core.beginRun();
+  if (initial)
+    core.restore(*initial);
+  iset.clear();
+  iset.setMaxLoopDepth(max_loop_depth);
+
+  bool failed = execLoop(iset, core, FlagRaised(stop));
+
+  return failed || stop.load(std::memory_order_relaxed);
+}
+
+// Runs a program once per fitness case, starting each case from a freshly reset core (or from "initial").
+// Case k reads its input from cases[k] and writes to res.outputs[k]. Returns true if any of the cases failed.
+template <class T, class Program>
+static bool runCases(BasicInstructionSet<T>& iset,
+                     BasicMemCore<T>& core,
+                     Program& bc,
+                     const CoreState* initial,
+                     FitnessCases& cases,
+                     long randseed,
+                     const std::atomic<bool>& stop,
+                     int max_loop_depth,
+                     EvalResult& res)
+{
+  std::vector<double>* const input = core.input; // restored on exit
+  std::vector<double>* const output = core.output;
+  const IOMode io_mode = core.io.mode;
+  core.io.mode = IO_BUFFER; // a case without inputs is not a prompt
+
+  const uint64_t t0 = metricsEnabled() ? metricsClock() : 0;
+  unsigned loop_aborts = 0;
+
+  res.clear();
+  res.outputs.resize(cases.size());
+
+  for (unsigned k=0;k<cases.size();k++) {
+    if (stop.load(std::memory_order_relaxed)) {
+      res.cancelled = true;
+      break;
+    }
+
+    core.reset();
+    core.input = &cases[k];
+    core.output = &res.outputs[k];
+
+    if (runOnce(iset, core, bc, initial, randseed, stop, max_loop_depth)) {
+      res.n_failed++;
+      if (!stop.load(std::memory_order_relaxed)) // failed on its own: only the loop depth check throws
+        loop_aborts++;
+    }
+
+    res.n_cases++;
+    res.n_ops += iset.getTotalOps();
+    res.n_invops += iset.getTotalInvops();
+    res.n_inputs_bf_output += iset.getTotalInputsBFOutput();
+  }
+
+  if (stop.load(std::memory_order_relaxed))
+    res.cancelled = true;
+  res.outputs.resize(res.n_cases);
+
+  core.input = input;
+  core.output = output;
+  core.io.mode = io_mode;
+
+  if (metricsEnabled())
+    recordEvaluation(t0, res.n_cases, res.n_ops, res.n_invops, 0, loop_aborts); // time-outs are known to the caller
+
+  return res.n_failed>0;
+} // runCases
+
+
+template <class T>
+bool runFitnessCases(BasicInstructionSet<T>& iset,
+                     BasicMemCore<T>& core,
+                     ByteCode& bc,
+                     FitnessCases& cases,
+                     long randseed,
+                     const std::atomic<bool>& stop,
+                     int max_loop_depth,
+                     EvalResult& res)
+{
+  return runCases(iset, core, bc, NULL, cases, randseed, stop, max_loop_depth, res);
+} // runFitnessCases
+
+
+template <class T>
+bool runFitnessCases(BasicInstructionSet<T>& iset,
+                     BasicMemCore<T>& core,
+                     ByteCode& bc,
+                     const CoreState& initial,
+                     FitnessCases& cases,
+                     long randseed,
+                     const std::atomic<bool>& stop,
+                     int max_loop_depth,
+                     EvalResult& res)
+{
+  return runCases(iset, core, bc, &initial, cases, randseed, stop, max_loop_depth, res);
+} // runFitnessCases
+
+
+template <class T>
+bool runFitnessCases(BasicInstructionSet<T>& iset,
+                     BasicMemCore<T>& core,
+                     ByteCode& bc,
+                     const CaseSpans& cases,
+                     long randseed,
+                     const std::atomic<bool>& stop,
+                     int max_loop_depth,
+                     EvalResult& res)
+{
+  const IOMode io_mode = core.io.mode; // restored on exit (the span fields are left as they are)
+  const uint64_t t0 = metricsEnabled() ? metricsClock() : 0;
+  unsigned loop_aborts = 0;
+
+  res.clear();
+  core.io.mode = IO_SPAN;
+  core.io.in_size = cases.n_inputs;
+  core.io.out_size = cases.n_outputs;
+
+  for (unsigned k=0;k<cases.n_cases;k++) {
+    if (stop.load(std::memory_order_relaxed))
+      break;
+
+    core.reset();
+    core.io.in = cases.inputs + (size_t)k*cases.n_inputs;
+    core.io.out = cases.outputs + (size_t)k*cases.n_outputs;
+
+    if (runByteCodeUntil(iset, core, bc, randseed, stop, max_loop_depth)) {
+      res.n_failed++;
+      if (!stop.load(std::memory_order_relaxed))
+        loop_aborts++;
+    }
+    if (cases.n_written)
+      cases.n_written[k] = core.outputsWritten();
+
+    res.n_cases++;
+    res.n_ops += iset.getTotalOps();
+    res.n_invops += iset.getTotalInvops();
+    res.n_inputs_bf_output += iset.getTotalInputsBFOutput();
+  }
+
+  if (stop.load(std::memory_order_relaxed))
+    res.cancelled = true;
+  core.io.mode = io_mode;
+
+  if (metricsEnabled())
+    recordEvaluation(t0, res.n_cases, res.n_ops, res.n_invops, 0, loop_aborts);
+
+  return res.n_failed>0;
+} // runFitnessCases
+
+
+template <class T>
+bool runFitnessCases(BasicInstructionSet<T>& iset,
+                     BasicMemCore<T>& core,
+                     const ProgramView& p,
+                     FitnessCases& cases,
+                     long randseed,
+                     const std::atomic<bool>& stop,
+                     int max_loop_depth,
+                     EvalResult& res)
+{
+  return runCases(iset, core, p, NULL, cases, randseed, stop, max_loop_depth, res);
+} // runFitnessCases
+
+
+
+/*
+ *
+ * Instantiations for float and double
+ *
+ */
+
+#define SLASHA_INSTANTIATE(T) \
+  template class BasicMemCore<T>; \
+  template class BasicInstructionSet<T>; \
+  template void compactByteCode(const ByteCode&, ByteCode16&, BasicInstructionSet<T>&); \
+  template ByteCode_Type instruction2ByteCode(const string&, BasicInstructionSet<T>&); \
+  template void source2ByteCode(const string&, ByteCode&, BasicInstructionSet<T>&); \
+  template const char* parseProgram(const char*, const char*, ByteCode&, BasicInstructionSet<T>&); \
+  template void bytecode2Source(ByteCode&, string&, BasicInstructionSet<T>&); \
+  template bool runByteCode(BasicInstructionSet<T>&, BasicMemCore<T>&, ByteCode&, long, long, int); \
+  template bool runByteCodeUntil(BasicInstructionSet<T>&, BasicMemCore<T>&, ByteCode&, long, \
+                                 const std::atomic<bool>&, int); \
+  template bool runByteCode16(BasicInstructionSet<T>&, BasicMemCore<T>&, ByteCode16&, long, \
+                              const std::atomic<bool>&, int); \
+  template bool runProgram(BasicInstructionSet<T>&, BasicMemCore<T>&, const ProgramView&, long, \
+                           const std::atomic<bool>&, int); \
+  template void startProgram(BasicMemCore<T>&, const ProgramView&, long); \
+  template RunStatus resumeProgram(BasicInstructionSet<T>&, BasicMemCore<T>&, unsigned long, unsigned long&); \
+  template bool runFitnessCases(BasicInstructionSet<T>&, BasicMemCore<T>&, ByteCode&, FitnessCases&, long, \
+                                const std::atomic<bool>&, int, EvalResult&); \
+  template bool runFitnessCases(BasicInstructionSet<T>&, BasicMemCore<T>&, const ProgramView&, FitnessCases&, long, \
+                                const std::atomic<bool>&, int, EvalResult&); \
+  template bool runFitnessCases(BasicInstructionSet<T>&, BasicMemCore<T>&, ByteCode&, const CoreState&, \
+                                FitnessCases&, long, const std::atomic<bool>&, int, EvalResult&); \
+  template bool runFitnessCases(BasicInstructionSet<T>&, BasicMemCore<T>&, ByteCode&, const CaseSpans&, long, \
+                                const std::atomic<bool>&, int, EvalResult&);
+
+SLASHA_INSTANTIATE(double)
+SLASHA_INSTANTIATE(float)
+
 }; //namespace SlashA
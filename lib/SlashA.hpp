@@ -25,6 +25,11 @@
 #include <string>
 #include <vector>
 #include <cmath>
+#include <atomic>
+#include <stdint.h>
+#include <functional>
+#include <unordered_map>
+#include "NR-ran2.hpp"
 
 namespace SlashA
 {
@@ -36,17 +41,104 @@ namespace SlashA
   typedef unsigned ByteCode_Type;
   typedef std::vector<ByteCode_Type> ByteCode;
 
+  typedef uint16_t ByteCode16_Type; // compact encoding for instruction sets of up to 65536 instructions
+  typedef std::vector<ByteCode16_Type> ByteCode16;
+
+  // Heap bytes held by a string besides the object itself (none while it fits the small-string buffer)
+  inline size_t heapBytes(const std::string& s)
+  {
+    const char* self = (const char*)&s;
+    return ( (s.data()>=self) && (s.data()<self+sizeof(s)) ) ? 0 : s.capacity()+1;
+  }
+
   /* Classes */
   
-  class MemCore
+  class ProgramView // a program stored elsewhere (e.g. in a PopulationArena), run without copying it to a ByteCode
+  {
+    public:
+      const ByteCode_Type* code;
+      unsigned length;
+
+      ProgramView() : code(NULL), length(0) {}
+      ProgramView(const ByteCode_Type* c, unsigned n) : code(c), length(n) {}
+      ProgramView(const ByteCode& bc) : code(bc.data()), length(bc.size()) {}
+
+      const ByteCode_Type& operator[](unsigned i) const { return code[i]; }
+      unsigned size() const { return length; }
+  };
+
+  class CoreState // snapshot of a MemCore's registers, tapes, I/O positions and output buffer (see MemCore::save/restore)
+  {
+    public:
+      double F;
+      unsigned I;
+      unsigned in_pos, out_pos;
+      std::vector<double> D;
+      std::vector<bool> D_saved;
+      std::vector<unsigned> L;
+      std::vector<bool> L_saved;
+      bool output_executed;
+      std::vector<double> outputs;
+  };
+
+  /*
+   * Where the input and output instructions read and write, chosen when the core is created (or with
+   * setIO()). IO_AUTO is the historical behavior: the console if the input buffer is empty, the input and
+   * output vectors otherwise. IO_SPAN reads a fixed array and writes into a preallocated one, dropping the
+   * outputs that do not fit, so batch runs never allocate nor touch iostream. IO_CALLBACK hands every value
+   * to user code. Console I/O lives in SlashA.cpp, out of the instruction bodies.
+   */
+  enum IOMode { IO_AUTO, IO_CONSOLE, IO_BUFFER, IO_SPAN, IO_CALLBACK };
+
+  typedef std::function<bool(unsigned n, double& x)> InputCallback; // n-th input of the run; false: none (F is kept)
+  typedef std::function<void(unsigned n, double x)> OutputCallback; // n-th output of the run
+
+  class IOPolicy
+  {
+    public:
+      IOMode mode;
+      const double* in; // IO_SPAN
+      unsigned in_size;
+      double* out;
+      unsigned out_size;
+      InputCallback read; // IO_CALLBACK
+      OutputCallback write;
+
+      IOPolicy() : mode(IO_AUTO), in(NULL), in_size(0), out(NULL), out_size(0) {}
+
+      static IOPolicy console() { IOPolicy p; p.mode = IO_CONSOLE; return p; }
+      static IOPolicy buffers() { IOPolicy p; p.mode = IO_BUFFER; return p; } // core.input/core.output, even if empty
+      static IOPolicy span(const double* in, unsigned in_size, double* out, unsigned out_size)
+      { IOPolicy p; p.mode = IO_SPAN; p.in = in; p.in_size = in_size; p.out = out; p.out_size = out_size; return p; }
+      static IOPolicy callback(InputCallback read, OutputCallback write)
+      { IOPolicy p; p.mode = IO_CALLBACK; p.read = read; p.write = write; return p; }
+  };
+
+  bool consoleInput(unsigned n, double& x); // prompts for input #n+1
+  void consoleOutput(unsigned n, double x);
+
+  /*
+   * The machine state and the DIS are templates on the scalar type T of the F register and the data tape.
+   * MemCore, Instruction and InstructionSet (T = double) are what the rest of the library and most users
+   * work with; FloatMemCore etc. (T = float) halve the data tape and double the SIMD width of the range
+   * instructions. Input and output buffers are always double, and setF() rejects values that are not
+   * finite in T, so e.g. a result that overflows float is an invalid operation for the float machine.
+   */
+
+  template <class T>
+  class BasicMemCore
   {
     private:
-      double F; // F-register
+      T F; // F-register
+      std::vector<double> own_input, own_output; // what input/output point to when the core is built from an IOPolicy
     public:
       unsigned I; // I-register
-      ByteCode* C; // program tape
+      ByteCode* C; // program tape (NULL while running a compact ByteCode16 program)
       unsigned c; // program tape position
-      double* D; // data tape
+      const ByteCode_Type* C32; // raw view of the program tape, set by the interpreter...
+      const ByteCode16_Type* C16; // ...or of the compact tape (only one of the two is non-NULL)
+      unsigned C_size; // program tape length
+      T* D; // data tape
       unsigned D_size;
       bool* D_saved; // saved/unsaved flag for each Data element
 
@@ -56,22 +148,107 @@ namespace SlashA
 
       std::vector<unsigned> L_table_addr; // Loop-table containing the addresses of the corresponding EndLoop instructions
       std::vector<unsigned> L_table_count; // Loop-table containing the loop counters
+      std::vector<unsigned> J_table; // Jump-table of the jumpifn instructions (see DIS::JumpIfN)
 
       std::vector<double>* input; // input buffer
       std::vector<double>* output; // output buffer
       bool output_executed; // a flag that tells if any output instruction has been executed so far
+
+      IOPolicy io;
+      unsigned in_pos; // inputs read and outputs written by the current run (rewound by reset() and by the run functions)
+      unsigned out_pos;
+      std::vector<double>* input_log; // when set, every value read by an input instruction is appended to it
       
-      long* ran_ptr;
+      NumericalRecipes::Ran2State ran; // generator of the random-number instructions, private to the core
+      long* ran_ptr; // &ran.idum: the seed
       
   // Methods:
-      MemCore(const unsigned _Dsize, 
-              const unsigned _Lsize,
-              std::vector<double>& _input,
-              std::vector<double>& _output);
-      ~MemCore();
+      typedef T Scalar;
+
+      BasicMemCore(const unsigned _Dsize, 
+                   const unsigned _Lsize,
+                   std::vector<double>& _input,
+                   std::vector<double>& _output);
+      BasicMemCore(const unsigned _Dsize,
+                   const unsigned _Lsize,
+                   const IOPolicy& _io); // input/output point to empty buffers of the core's own
+      ~BasicMemCore();
+
+      void reset(); // clears registers, tapes and loop-tables, ready for a new program/fitness case
+
+      size_t memoryBytes() const; // the core, its tapes and tables; not the input/output vectors it was given
+      size_t tableBytes() const // loop and jump tables of the current program
+        { return (L_table_addr.capacity()+L_table_count.capacity()+J_table.capacity())*sizeof(unsigned); }
+
+      void save(CoreState& s) const; // the program tape, its position and the loop-tables are not part of the state
+      void restore(const CoreState& s); // throws if the tape sizes differ; replaces the output buffer
+
+      inline void setProgram(ByteCode& bc) { C = &bc; C32 = bc.data(); C16 = NULL; C_size = bc.size(); }
+      inline void setProgram(ByteCode16& bc) { C = NULL; C32 = NULL; C16 = bc.data(); C_size = bc.size(); }
+      inline void setProgram(const ProgramView& p) { C = NULL; C32 = p.code; C16 = NULL; C_size = p.length; }
+      inline unsigned codeSize() { return C_size; }
+      inline ByteCode_Type codeAt(unsigned pos) { return C16 ? (ByteCode_Type)C16[pos] : C32[pos]; }
       
-      inline double getF() { return F; }
-      inline bool setF(double f) // protects F against assignment of invalid values
+      void setIO(const IOPolicy& _io) { io = _io; }
+      inline void rewindIO() { in_pos = out_pos = 0; }
+      inline void beginRun() { rewindIO(); L_table_addr.clear(); L_table_count.clear(); J_table.clear(); } // tables are rebuilt for the new program
+      inline unsigned outputsWritten() { return (io.mode==IO_SPAN) && (out_pos>io.out_size) ? io.out_size : out_pos; }
+
+      inline bool nextInput(double& x) // false if there is no input left (the input instruction then leaves F alone)
+      {
+        if (!readInput(in_pos++, x))
+          return false;
+        if (input_log)
+          input_log->push_back(x);
+        return true;
+      }
+
+      inline bool readInput(unsigned n, double& x)
+      {
+        switch (io.mode) {
+          case IO_SPAN:
+            if (n>=io.in_size)
+              return false;
+            x = io.in[n];
+            return true;
+          case IO_CALLBACK:
+            return io.read(n, x);
+          case IO_CONSOLE:
+            return consoleInput(n, x);
+          default:
+            if ( (io.mode==IO_AUTO) && (input->size()==0) )
+              return consoleInput(n, x);
+            if (n>=input->size())
+              return false;
+            x = (*input)[n];
+            return true;
+        }
+      }
+
+      inline void putOutput(double x)
+      {
+        const unsigned n = out_pos++;
+        switch (io.mode) {
+          case IO_SPAN:
+            if (n<io.out_size)
+              io.out[n] = x;
+            break;
+          case IO_CALLBACK:
+            io.write(n, x);
+            break;
+          case IO_CONSOLE:
+            consoleOutput(n, x);
+            break;
+          default:
+            if ( (io.mode==IO_AUTO) && (input->size()==0) )
+              consoleOutput(n, x);
+            else
+              output->push_back(x);
+        }
+      }
+
+      inline T getF() { return F; }
+      inline bool setF(T f) // protects F against assignment of invalid values
       {
         if (std::isnan(f) || std::isinf(f))
           return false;
@@ -81,9 +258,14 @@ namespace SlashA
       }
   };
   
-  class InstructionSet; // prototype
+  template <class T> class BasicInstructionSet; // prototype
 
-  class Instruction
+  // How exp, log, sin and pow are computed: by libm, or by the kernels of lib/SlashA_Math.hpp (documented
+  // maximum error of 1-2 ulp, batched in SIMD under lockstep evaluation). Values are checked by setF() either way.
+  enum MathMode { MATH_LIBM, MATH_FAST };
+
+  template <class T>
+  class BasicInstruction
   {
     protected:
       std::string name; // to be defined in the derived classes
@@ -94,13 +276,20 @@ namespace SlashA
       unsigned n_outputs; // number of executed output instructions
       unsigned n_inputs_bf_output; // number of executed input instructions before the first output instruction
     public:
-      Instruction() { clearCounters(); DIS_flag = false; }
-      virtual ~Instruction() {}
+      typedef BasicInstruction Instruction; // so that user-defined instructions can write Instruction() in their constructors
+      typedef BasicMemCore<T> MemCore;
+      typedef BasicInstructionSet<T> InstructionSet;
+
+      BasicInstruction() { clearCounters(); DIS_flag = false; }
+      virtual ~BasicInstruction() {}
 
       virtual inline void code(MemCore& core, InstructionSet& iset) { throw (std::string)"Instruction not properly initialized! (method code() undefined)"; } // to be defined in the derived class (i.e. specific instruction)
+      // Runs the instruction on n cores at the same program position (lockstep evaluation, see
+      // lib/SlashA_Lockstep.hpp). Instructions with a batched implementation override it.
+      virtual void codeLanes(MemCore** cores, unsigned n, InstructionSet& iset) { for (unsigned i=0;i<n;i++) code(*cores[i], iset); }
 
       bool isDIS() { return DIS_flag; } 
-      std::string getName() { return name; }
+      const std::string& getName() const { return name; }
       unsigned getOps() { return n_ops; }
       unsigned getInvops() { return n_invops; }
       unsigned getInputs() { return n_inputs; }
@@ -109,19 +298,35 @@ namespace SlashA
       void clearCounters() { n_ops=0; n_invops=0; n_inputs=0; n_outputs=0; n_inputs_bf_output=0; }
       virtual void clear() {};
       void clearAll() { clearCounters(); clear(); }
+      // The base object and its name. An instruction with members or storage of its own overrides it with
+      // sizeof(*this) plus that storage, as only the derived class knows its size.
+      virtual size_t memoryBytes() const { return sizeof(*this) + heapBytes(name); }
   };
 
-  class InstructionSet
+  template <class T>
+  class BasicInstructionSet
   {
+    public:
+      typedef BasicInstruction<T> Instruction;
+      typedef BasicMemCore<T> MemCore;
     private:
+      /*
+       * Numeric instructions (SetI) are not stored as objects: opcodes 0..n_numericinst-1 set I to the opcode
+       * itself, and are handled inline by exec(). "set" only holds the remaining instructions, so opcode k
+       * (k >= n_numericinst) lives in set[k-n_numericinst]. Counters of the numeric instructions are kept for
+       * the whole family.
+       */
       std::vector<Instruction*> set;
-      void insert_DIS_numeric(ByteCode_Type n_num);
       void remove_DIS();
       unsigned n_numericinst;
+      unsigned n_setops; // operations executed by numeric instructions
       int maxloopdepth;
+      MathMode mathmode;
+      std::unordered_map<std::string, ByteCode_Type> name_index; // non-numeric names -> opcode (first occurrence)
+      bool name_index_ok;
     public:
-      InstructionSet(ByteCode_Type n_num) { maxloopdepth=-1; n_numericinst=n_num; insert_DIS_numeric(n_num); }
-      ~InstructionSet() { remove_DIS(); }
+      BasicInstructionSet(ByteCode_Type n_num) { maxloopdepth=-1; mathmode=MATH_LIBM; n_numericinst=n_num; n_setops=0; name_index_ok=false; }
+      ~BasicInstructionSet() { remove_DIS(); }
 
       void insert_DIS_IO(); // input/output commands
       void insert_DIS_memreg(); // memory-register commands
@@ -131,19 +336,42 @@ namespace SlashA
       void insert_DIS_loops(); // flow-control: loop commands
       void insert_DIS_basicmath(); // basic math operations
       void insert_DIS_advmath(); // advanced math functions
+      void insert_DIS_vector(); // data-tape range operations (not part of _DIS_full)
       void insert_DIS_misc(); // everything else
       void insert_DIS_full(); // inserts all of the above (with the exception of _DIS_numeric)
       void insert_DIS_full_minus_Gotos(); // avoids infinite loops
 
-      void insert(Instruction* inst) { set.push_back(inst); } // inserts a user-defined instruction
-      void exec(unsigned inst_num, MemCore& core) { set[inst_num]->code(core, (*this)); }
+      void insert(Instruction* inst) { set.push_back(inst); name_index_ok=false; } // inserts a user-defined instruction
+      void exec(unsigned inst_num, MemCore& core) 
+      { 
+        if (inst_num<n_numericinst) { core.I = inst_num; n_setops++; } // SetI: the immediate is the opcode
+        else set[inst_num-n_numericinst]->code(core, (*this)); 
+      }
+      void execLanes(unsigned inst_num, MemCore** cores, unsigned n)
+      {
+        if (inst_num<n_numericinst) { for (unsigned i=0;i<n;i++) cores[i]->I = inst_num; n_setops+=n; }
+        else set[inst_num-n_numericinst]->codeLanes(cores, n, (*this));
+      }
+
+      std::string listAll() { std::string s = ""; for (unsigned i=0;i<size();i++) s+=getName(i)+'/'; return s + '.'; }
+      std::string getName(int inst_num);
+      bool is(ByteCode_Type inst_num, const char* name) // cheaper than getName(inst_num)==name
+        { return (inst_num>=n_numericinst) && (set[inst_num-n_numericinst]->getName()==name); }
+      bool isDIS(ByteCode_Type inst_num) // numeric instructions are part of the DIS
+        { return (inst_num<n_numericinst) || set[inst_num-n_numericinst]->isDIS(); }
 
-      std::string listAll() { std::string s = ""; for (unsigned i=0;i<set.size();i++) s+=set[i]->getName()+'/'; return s + '.'; }
-      std::string getName(int inst_num) { return set[inst_num]->getName(); }
-      unsigned getOps(int inst_num) { return set[inst_num]->getOps(); }
-      unsigned getInvops(int inst_num) { return set[inst_num]->getInvops(); }
+      void indexNames(); // builds the name lookup table; call it before sharing the set among parser threads
+      ByteCode_Type lookup(const char* word, unsigned len); // opcode of an instruction name, throws if unknown
+      unsigned nameLength(ByteCode_Type inst_num);
+      char* writeName(ByteCode_Type inst_num, char* out); // copies the name to out, returns the end of it
+      unsigned getOps(int inst_num) // for numeric instructions, the total of the whole family
+        { return ((unsigned)inst_num<n_numericinst) ? n_setops : set[inst_num-n_numericinst]->getOps(); }
+      unsigned getInvops(int inst_num) 
+        { return ((unsigned)inst_num<n_numericinst) ? 0 : set[inst_num-n_numericinst]->getInvops(); }
+      unsigned getInputsBeforeOutput(int inst_num)
+        { return ((unsigned)inst_num<n_numericinst) ? 0 : set[inst_num-n_numericinst]->getInputsBeforeOutput(); }
       unsigned getTotalOps()
-        { unsigned n=0; for (unsigned i=0;i<set.size();i++) n+=set[i]->getOps(); return n; };
+        { unsigned n=n_setops; for (unsigned i=0;i<set.size();i++) n+=set[i]->getOps(); return n; };
       unsigned getTotalInvops() 
         { unsigned n=0; for (unsigned i=0;i<set.size();i++) n+=set[i]->getInvops(); return n; };
       unsigned getTotalInputs() 
@@ -152,34 +380,179 @@ namespace SlashA
         { unsigned n=0; for (unsigned i=0;i<set.size();i++) n+=set[i]->getOutputs(); return n; };
       unsigned getTotalInputsBFOutput() 
         { unsigned n=0; for (unsigned i=0;i<set.size();i++) n+=set[i]->getInputsBeforeOutput(); return n; };
-      void clear() { for (unsigned i=0;i<set.size();i++) set[i]->clearAll(); }
-      unsigned size() { return (ByteCode_Type)set.size(); }
+      void clear() { n_setops=0; for (unsigned i=0;i<set.size();i++) set[i]->clearAll(); }
+      unsigned size() { return n_numericinst + (ByteCode_Type)set.size(); }
       unsigned numericInstructions() { return n_numericinst; }
+      size_t memoryBytes() const; // the set, its instructions and the name index
       int getMaxLoopDepth() { return maxloopdepth; }
       void setMaxLoopDepth(unsigned ldepth) { maxloopdepth=ldepth; }
+      MathMode getMathMode() { return mathmode; }
+      void setMathMode(MathMode m) { mathmode=m; }
+  };
+
+  typedef BasicMemCore<double> MemCore;
+  typedef BasicInstruction<double> Instruction;
+  typedef BasicInstructionSet<double> InstructionSet;
+
+  typedef BasicMemCore<float> FloatMemCore;
+  typedef BasicInstruction<float> FloatInstruction;
+  typedef BasicInstructionSet<float> FloatInstructionSet;
+
+  typedef std::function<InstructionSet*()> ISetFactory; // builds a private instruction set for each worker thread
+
+  typedef std::vector< std::vector<double> > FitnessCases; // one input buffer per fitness case
+
+  class CaseSpans // fitness cases and their outputs as flat arrays
+  {
+    public:
+      const double* inputs; // case k reads inputs[k*n_inputs] to inputs[(k+1)*n_inputs-1]
+      unsigned n_inputs;
+      double* outputs; // case k writes at most n_outputs values from outputs[k*n_outputs] on
+      unsigned n_outputs;
+      unsigned* n_written; // outputs written by each case (NULL if not needed)
+      unsigned n_cases;
+  };
+
+  class EvalResult
+  {
+    public:
+      std::vector< std::vector<double> > outputs; // output buffer of each fitness case that was run
+      unsigned n_cases; // number of fitness cases actually run
+      uint64_t n_ops; // totals over all fitness cases run
+      uint64_t n_invops;
+      uint64_t n_inputs_bf_output;
+      unsigned n_failed; // number of fitness cases that failed (time-out, loop depth, etc)
+      bool cancelled; // evaluation was stopped before all fitness cases were run
+      bool timedout; // evaluation was stopped because its time limit expired
+
+      EvalResult() { clear(); }
+      void clear() { outputs.clear(); n_cases=n_ops=n_invops=n_inputs_bf_output=n_failed=0; cancelled=timedout=false; }
   };
 
   /* Functions */
 
+  // Functions that take an instruction set are templates on its scalar type; SlashA.cpp instantiates them
+  // for float and double.
+
   std::string getHeader();
 
-  bool runByteCode(InstructionSet& iset,
-                   MemCore& core,
+  template <class T>
+  bool runByteCode(BasicInstructionSet<T>& iset,
+                   BasicMemCore<T>& core,
                    ByteCode& bc,
                    long randseed,
                    long max_rtime,
                    int max_loop_depth);
 
-  ByteCode_Type instruction2ByteCode( std::string inst, 
-                                      InstructionSet& iset );
+  template <class T>
+  bool runByteCodeUntil(BasicInstructionSet<T>& iset,
+                        BasicMemCore<T>& core,
+                        ByteCode& bc,
+                        long randseed,
+                        const std::atomic<bool>& stop,
+                        int max_loop_depth);
+
+  template <class T>
+  bool runByteCode16(BasicInstructionSet<T>& iset, // runs a compact program, see compactByteCode()
+                     BasicMemCore<T>& core,
+                     ByteCode16& bc,
+                     long randseed,
+                     const std::atomic<bool>& stop,
+                     int max_loop_depth);
+
+  template <class T>
+  bool runFitnessCases(BasicInstructionSet<T>& iset,
+                       BasicMemCore<T>& core,
+                       ByteCode& bc,
+                       FitnessCases& cases,
+                       long randseed,
+                       const std::atomic<bool>& stop,
+                       int max_loop_depth,
+                       EvalResult& res);
+
+  template <class T>
+  bool runProgram(BasicInstructionSet<T>& iset, // same as runByteCodeUntil(); core.C is NULL while it runs
+                  BasicMemCore<T>& core,
+                  const ProgramView& p,
+                  long randseed,
+                  const std::atomic<bool>& stop,
+                  int max_loop_depth);
+
+  // Resumable execution. startProgram() sets the core up to run p from its first instruction (p must stay
+  // where it is until the run is over); resumeProgram() then runs at most quantum instructions from core.c
+  // and returns with the whole state (c, loop-tables and counters, registers, tapes) kept in the core.
+  // Operation counters accumulate in iset until it is cleared, and the loop depth limit is iset's.
+  enum RunStatus { RUN_FINISHED, RUN_SUSPENDED, RUN_FAILED };
+
+  template <class T>
+  void startProgram(BasicMemCore<T>& core,
+                    const ProgramView& p,
+                    long randseed);
+
+  template <class T>
+  RunStatus resumeProgram(BasicInstructionSet<T>& iset,
+                          BasicMemCore<T>& core,
+                          unsigned long quantum,
+                          unsigned long& executed); // instructions run by this call
+
+  template <class T>
+  bool runFitnessCases(BasicInstructionSet<T>& iset,
+                       BasicMemCore<T>& core,
+                       const ProgramView& p,
+                       FitnessCases& cases,
+                       long randseed,
+                       const std::atomic<bool>& stop,
+                       int max_loop_depth,
+                       EvalResult& res);
+
+  template <class T>
+  bool runFitnessCases(BasicInstructionSet<T>& iset, // same, with every case starting from "initial" instead of a reset core
+                       BasicMemCore<T>& core,
+                       ByteCode& bc,
+                       const CoreState& initial,
+                       FitnessCases& cases,
+                       long randseed,
+                       const std::atomic<bool>& stop,
+                       int max_loop_depth,
+                       EvalResult& res);
+
+  template <class T>
+  bool runFitnessCases(BasicInstructionSet<T>& iset, // same, through IO_SPAN: no allocation; res.outputs stays empty
+                       BasicMemCore<T>& core,
+                       ByteCode& bc,
+                       const CaseSpans& cases,
+                       long randseed,
+                       const std::atomic<bool>& stop,
+                       int max_loop_depth,
+                       EvalResult& res);
+
+  template <class T>
+  void compactByteCode( const ByteCode& bc, // throws if iset has more than 65536 instructions
+                        ByteCode16& bc16,
+                        BasicInstructionSet<T>& iset );
+
+  void expandByteCode( const ByteCode16& bc16,
+                       ByteCode& bc );
+
+  template <class T>
+  ByteCode_Type instruction2ByteCode( const std::string& inst, 
+                                      BasicInstructionSet<T>& iset );
                                       
-  void source2ByteCode( std::string src,
+  template <class T>
+  void source2ByteCode( const std::string& src,
                         ByteCode& bc,
-                        InstructionSet& iset );
+                        BasicInstructionSet<T>& iset );
+
+  template <class T>
+  const char* parseProgram( const char* begin, // parses up to the first '.' (or end); returns the position after it
+                            const char* end,
+                            ByteCode& bc,
+                            BasicInstructionSet<T>& iset );
 
+  template <class T>
   void bytecode2Source( ByteCode& bc,
                         std::string& src,
-                        InstructionSet& iset );
+                        BasicInstructionSet<T>& iset );
   
 }; // namespace SlashA
 
@@ -0,0 +1,345 @@
+/*
+ *
+ *  SlashA_Archive.cpp
+ *
+ *  Copyright (C) 2004-2011 Artur B Adib
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <cstring>
+#include <sstream>
+#include <thread>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "SlashA_Archive.hpp"
+#include "SlashA_Metrics.hpp"
+
+using namespace std;
+
+namespace SlashA
+{
+
+const size_t minChunk = 1<<20; // below this many bytes per thread, threads cost more than they save
+
+
+/*
+ *
+ * Class methods
+ *
+ */
+
+//
+//  Class: MappedFile
+//
+
+MappedFile::MappedFile(const string& filename)
+{
+  data = NULL;
+  length = 0;
+
+  int fd = open(filename.c_str(), O_RDONLY);
+  if (fd<0)
+    throw (string)"Cannot open file " + filename;
+
+  struct stat st;
+  if (fstat(fd, &st)!=0) {
+    close(fd);
+    throw (string)"Cannot stat file " + filename;
+  }
+
+  length = st.st_size;
+  if (length>0) {
+    void* p = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (p==MAP_FAILED) {
+      close(fd);
+      throw (string)"Cannot map file " + filename;
+    }
+    madvise(p, length, MADV_SEQUENTIAL);
+    data = (const char*)p;
+  }
+  close(fd); // the mapping stays valid
+}
+
+MappedFile::~MappedFile()
+{
+  if (data)
+    munmap((void*)data, length);
+}
+
+//
+//  Class: ArchiveReader
+//
+
+// Returns the first program-terminating dot in [begin, end), which must start at a line boundary, or NULL
+static const char* nextTerminator(const char* begin, const char* end)
+{
+  bool comment = false;
+  for (const char* c=begin;c<end;c++) {
+    if (comment) {
+      if (*c==10)
+        comment = false;
+    }
+    else if (*c=='#')
+      comment = true;
+    else if (*c=='.')
+      return c;
+  }
+  return NULL;
+}
+
+bool ArchiveReader::next(ByteCode& bc, InstructionSet& iset)
+{
+  if (pos>=file.end())
+    return false;
+
+  const char* dot = nextTerminator(pos, file.end());
+  if (!dot) { // trailing text without a '.' only counts if it holds instructions
+    parseProgram(pos, file.end(), bc, iset);
+    pos = file.end();
+    if (bc.size()==0)
+      return false;
+  }
+  else {
+    parseProgram(pos, dot+1, bc, iset);
+    const char* lf = (const char*)memchr(dot, 10, file.end()-dot); // skips the rest of the line
+    pos = lf ? lf+1 : file.end();
+  }
+
+  n_read++;
+  return true;
+}
+
+
+/*
+ *
+ * Functions
+ *
+ */
+
+// Runs f(t, first, last) over [0, n) split in n_threads contiguous blocks, t being the block number
+template <class Func>
+static void parallelFor(unsigned n_threads, size_t n, const Func& f)
+{
+  if (n_threads<=1 || n<2) {
+    f(0u, (size_t)0, n);
+    return;
+  }
+  if (n_threads>n)
+    n_threads = n;
+
+  vector<thread> threads;
+  for (unsigned t=0;t<n_threads;t++)
+    threads.push_back(thread(f, t, n*t/n_threads, n*(t+1)/n_threads));
+  for (unsigned t=0;t<n_threads;t++)
+    threads[t].join();
+}
+
+// Finds all the program-terminating dots in [begin, end), which must start at a line boundary
+static void findTerminators(const char* begin, const char* end, vector<const char*>& dots)
+{
+  const char* dot;
+  while ( (dot = nextTerminator(begin, end)) ) {
+    dots.push_back(dot);
+    const char* lf = (const char*)memchr(dot, 10, end-dot); // rest of the line is ignored
+    if (!lf)
+      break;
+    begin = lf+1;
+  }
+}
+
+void parseArchive(const char* begin,
+                  const char* end,
+                  vector<ByteCode>& programs,
+                  InstructionSet& iset,
+                  unsigned n_threads)
+{
+  const size_t size = end-begin;
+  const uint64_t t0 = metricsEnabled() ? metricsClock() : 0;
+  if ( (n_threads==0) || (size/minChunk<n_threads) )
+    n_threads = size/minChunk + 1;
+
+  // 1. splits the text at line boundaries and finds the terminators of each chunk in parallel
+  vector<const char*> bounds(n_threads+1, end);
+  bounds[0] = begin;
+  for (unsigned t=1;t<n_threads;t++) {
+    const char* b = begin + size*t/n_threads;
+    if (b<bounds[t-1])
+      b = bounds[t-1];
+    const char* lf = (const char*)memchr(b, 10, end-b);
+    bounds[t] = lf ? lf+1 : end;
+  }
+
+  vector< vector<const char*> > chunk_dots(n_threads);
+  parallelFor(n_threads, n_threads, [&](unsigned t, size_t first, size_t last) {
+    for (size_t k=first;k<last;k++)
+      findTerminators(bounds[k], bounds[k+1], chunk_dots[k]);
+  });
+
+  // 2. turns the terminators into program spans: each program starts on the line after the previous dot
+  vector<const char*> starts, stops;
+  const char* start = begin;
+  for (unsigned t=0;t<n_threads;t++)
+    for (unsigned i=0;i<chunk_dots[t].size();i++) {
+      const char* dot = chunk_dots[t][i];
+      starts.push_back(start);
+      stops.push_back(dot+1);
+      const char* lf = (const char*)memchr(dot, 10, end-dot);
+      start = lf ? lf+1 : end;
+    }
+
+  ByteCode tail; // text after the last dot only makes a program if it holds instructions
+  parseProgram(start, end, tail, iset);
+
+  // 3. parses the spans in parallel
+  programs.clear();
+  programs.resize(starts.size());
+
+  iset.indexNames(); // lookup() must not build its table lazily from several threads
+  vector<string> errors(n_threads);
+  vector<size_t> error_at(n_threads, starts.size());
+
+  parallelFor(n_threads, starts.size(), [&](unsigned t, size_t first, size_t last) {
+    try
+    {
+      for (size_t i=first;i<last;i++) {
+        error_at[t] = i;
+        parseProgram(starts[i], stops[i], programs[i], iset);
+      }
+      error_at[t] = starts.size();
+    }
+    catch(string& err)
+    {
+      errors[t] = err;
+    }
+  });
+
+  size_t bad = starts.size();
+  string err;
+  for (unsigned t=0;t<n_threads;t++)
+    if (error_at[t]<bad) {
+      bad = error_at[t];
+      err = errors[t];
+    }
+  if (bad<starts.size()) {
+    ostringstream msg;
+    msg << "Program #" << bad+1 << ": " << err;
+    throw msg.str();
+  }
+
+  if (tail.size()>0)
+    programs.push_back(tail);
+
+  if (metricsEnabled())
+    recordParse(t0, size, programs.size());
+}
+
+void readArchive(const string& filename,
+                 vector<ByteCode>& programs,
+                 InstructionSet& iset,
+                 unsigned n_threads)
+{
+  MappedFile file(filename);
+  parseArchive(file.begin(), file.end(), programs, iset, n_threads);
+}
+
+size_t sourceLength(const ByteCode& bc, InstructionSet& iset)
+{
+  size_t len = 1; // the dot
+  for (unsigned i=0;i<bc.size();i++)
+    len += iset.nameLength(bc[i]) + 1;
+  return len;
+}
+
+char* writeSource(const ByteCode& bc, char* out, InstructionSet& iset)
+{
+  for (unsigned i=0;i<bc.size();i++) {
+    out = iset.writeName(bc[i], out);
+    *out++ = '/';
+  }
+  *out++ = '.';
+  return out;
+}
+
+// Computes where each program goes in the output (one line each), then writes them all in parallel
+static size_t layoutArchive(const vector<ByteCode>& programs, vector<size_t>& offsets,
+                            InstructionSet& iset, unsigned n_threads)
+{
+  offsets.resize(programs.size()+1);
+  parallelFor(n_threads, programs.size(), [&](unsigned t, size_t first, size_t last) {
+    for (size_t i=first;i<last;i++)
+      offsets[i+1] = sourceLength(programs[i], iset) + 1; // + line-feed
+  });
+  offsets[0] = 0;
+  for (size_t i=0;i<programs.size();i++)
+    offsets[i+1] += offsets[i];
+  return offsets[programs.size()];
+}
+
+static void fillArchive(const vector<ByteCode>& programs, const vector<size_t>& offsets, char* out,
+                        InstructionSet& iset, unsigned n_threads)
+{
+  parallelFor(n_threads, programs.size(), [&](unsigned t, size_t first, size_t last) {
+    for (size_t i=first;i<last;i++) {
+      char* end = writeSource(programs[i], out+offsets[i], iset);
+      *end = 10;
+    }
+  });
+}
+
+void serializeArchive(const vector<ByteCode>& programs,
+                      string& out,
+                      InstructionSet& iset,
+                      unsigned n_threads)
+{
+  vector<size_t> offsets;
+  out.resize(layoutArchive(programs, offsets, iset, n_threads));
+  if (out.size()>0)
+    fillArchive(programs, offsets, &out[0], iset, n_threads);
+}
+
+void writeArchive(const vector<ByteCode>& programs,
+                  const string& filename,
+                  InstructionSet& iset,
+                  unsigned n_threads)
+{
+  vector<size_t> offsets;
+  const size_t size = layoutArchive(programs, offsets, iset, n_threads);
+
+  int fd = open(filename.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (fd<0)
+    throw (string)"Cannot open file " + filename;
+
+  if (size>0) {
+    if (ftruncate(fd, size)!=0) {
+      close(fd);
+      throw (string)"Cannot resize file " + filename;
+    }
+    void* p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (p==MAP_FAILED) {
+      close(fd);
+      throw (string)"Cannot map file " + filename;
+    }
+    fillArchive(programs, offsets, (char*)p, iset, n_threads);
+    munmap(p, size);
+  }
+
+  if (close(fd)!=0)
+    throw (string)"Cannot write file " + filename;
+}
+
+}; //namespace SlashA
@@ -0,0 +1,98 @@
+/*
+ *
+ *  SlashA_Archive.hpp - reading and writing files that hold many Slash/A programs
+ *
+ *  Copyright (C) 2004-2011 Artur B Adib
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef SLASHA_ARCHIVE_INCLUDED // duplicate protection
+#define SLASHA_ARCHIVE_INCLUDED
+
+#include <cstddef>
+#include "SlashA.hpp"
+
+namespace SlashA
+{
+
+  /*
+   * An archive is plain Slash/A source holding any number of programs, each terminated by a '.'.
+   * Whatever follows a '.' on the same line is ignored, like a comment, so every line starts in a
+   * known state and files can be split among threads at line boundaries.
+   */
+
+  class MappedFile // read-only memory map of a whole file
+  {
+    private:
+      const char* data;
+      size_t length;
+      MappedFile(const MappedFile&); // not copyable
+      MappedFile& operator=(const MappedFile&);
+    public:
+      MappedFile(const std::string& filename); // throws a string on errors
+      ~MappedFile();
+
+      const char* begin() const { return data; }
+      const char* end() const { return data+length; }
+      size_t size() const { return length; }
+  };
+
+  class ArchiveReader // yields the programs of an archive one at a time, in file order
+  {
+    private:
+      MappedFile file;
+      const char* pos;
+      unsigned n_read;
+    public:
+      ArchiveReader(const std::string& filename) : file(filename) { pos = file.begin(); n_read = 0; }
+
+      bool next(ByteCode& bc, InstructionSet& iset); // false at the end of the archive
+      unsigned count() { return n_read; }
+  };
+
+  /* Functions */
+
+  // Parses every program in [begin, end). The text is scanned and parsed on n_threads threads.
+  // Parse errors are thrown as strings naming the offending program.
+  void parseArchive(const char* begin,
+                    const char* end,
+                    std::vector<ByteCode>& programs,
+                    InstructionSet& iset,
+                    unsigned n_threads);
+
+  void readArchive(const std::string& filename,
+                   std::vector<ByteCode>& programs,
+                   InstructionSet& iset,
+                   unsigned n_threads);
+
+  // Serialization: one "name/name/.../." line per program, written straight into a buffer sized up front.
+  size_t sourceLength(const ByteCode& bc, InstructionSet& iset);
+
+  char* writeSource(const ByteCode& bc, char* out, InstructionSet& iset); // returns the end of the text
+
+  void serializeArchive(const std::vector<ByteCode>& programs,
+                        std::string& out,
+                        InstructionSet& iset,
+                        unsigned n_threads);
+
+  void writeArchive(const std::vector<ByteCode>& programs,
+                    const std::string& filename,
+                    InstructionSet& iset,
+                    unsigned n_threads);
+
+}; // namespace SlashA
+
+#endif // SLASHA_ARCHIVE_INCLUDED
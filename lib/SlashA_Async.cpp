@@ -0,0 +1,352 @@
+/*
+ *
+ *  SlashA_Async.cpp
+ *
+ *  Copyright (C) 2004-2011 Artur B Adib
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <chrono>
+#include <exception>
+#include "SlashA_Async.hpp"
+#include "SlashA_Metrics.hpp"
+
+using namespace std;
+
+namespace SlashA
+{
+
+typedef chrono::steady_clock Clock;
+
+
+/*
+ *
+ * Class methods
+ *
+ */
+
+//
+//  Class: EvalJob
+//
+
+class EvalJob
+{
+  public:
+    ByteCode bc;
+    FitnessCases* cases;
+    long randseed;
+    long timeout_ms;
+    int max_loop_depth;
+    EvalCallback on_done;
+
+    atomic<bool> stop; // raised by cancel() or by the watchdog
+    atomic<bool> cancel_requested;
+    Clock::time_point deadline;
+
+    EvalResult result;
+    std::string error;
+    bool ran; // the run is over: stop no longer changes the result
+    bool done;
+    mutex mtx;
+    condition_variable done_cv;
+
+    EvalJob() : stop(false), cancel_requested(false), ran(false), done(false) {}
+
+    void halt(bool cancelling) // raises stop unless the run is already over
+    {
+      lock_guard<mutex> lock(mtx);
+      if (ran)
+        return;
+      if (cancelling)
+        cancel_requested = true;
+      stop = true;
+    }
+
+    void finish()
+    {
+      {
+        lock_guard<mutex> lock(mtx);
+        done = true;
+      }
+      done_cv.notify_all();
+    }
+};
+
+//
+//  Class: EvalHandle
+//
+
+bool EvalHandle::ready() const
+{
+  lock_guard<mutex> lock(job->mtx);
+  return job->done;
+}
+
+void EvalHandle::wait() const
+{
+  unique_lock<mutex> lock(job->mtx);
+  while (!job->done)
+    job->done_cv.wait(lock);
+}
+
+bool EvalHandle::waitFor(long timeout_ms) const
+{
+  unique_lock<mutex> lock(job->mtx);
+  return job->done_cv.wait_for(lock, chrono::milliseconds(timeout_ms), [this]{ return job->done; });
+}
+
+void EvalHandle::cancel()
+{
+  job->halt(true);
+}
+
+const EvalResult& EvalHandle::get() const
+{
+  wait();
+  return job->result;
+}
+
+string EvalHandle::error() const
+{
+  wait();
+  return job->error;
+}
+
+//
+//  Class: AsyncEvaluator
+//
+
+struct AsyncEvaluator::Worker
+{
+  thread th;
+  shared_ptr<EvalJob> current; // job being run (protected by AsyncEvaluator::mtx)
+};
+
+AsyncEvaluator::AsyncEvaluator(unsigned n_threads,
+                               unsigned _max_queued,
+                               ISetFactory _make_iset,
+                               unsigned _D_size,
+                               unsigned _L_size)
+{
+  make_iset = _make_iset;
+  D_size = _D_size;
+  L_size = _L_size;
+  max_queued = _max_queued ? _max_queued : 1;
+  n_running = 0;
+  shutting_down = false;
+
+  if (n_threads==0)
+    n_threads = 1;
+
+  for (unsigned i=0;i<n_threads;i++) {
+    Worker* w = new Worker;
+    workers.push_back(w);
+    w->th = thread(&AsyncEvaluator::workerLoop, this, w);
+  }
+  watchdog = thread(&AsyncEvaluator::watchdogLoop, this);
+}
+
+AsyncEvaluator::~AsyncEvaluator()
+{
+  {
+    lock_guard<mutex> lock(mtx);
+    shutting_down = true;
+    for (unsigned i=0;i<queue.size();i++)
+      queue[i]->halt(true);
+    for (unsigned i=0;i<workers.size();i++)
+      if (workers[i]->current)
+        workers[i]->current->halt(false);
+  }
+  queue_cv.notify_all();
+  watchdog_cv.notify_all();
+
+  for (unsigned i=0;i<workers.size();i++) {
+    workers[i]->th.join();
+    delete workers[i];
+  }
+  watchdog.join();
+}
+
+EvalHandle AsyncEvaluator::submit(const ByteCode& bc,
+                                  FitnessCases& cases,
+                                  long randseed,
+                                  long timeout_ms,
+                                  int max_loop_depth,
+                                  EvalCallback on_done)
+{
+  shared_ptr<EvalJob> job(new EvalJob);
+  job->bc = bc;
+  job->cases = &cases;
+  job->randseed = randseed;
+  job->timeout_ms = timeout_ms;
+  job->max_loop_depth = max_loop_depth;
+  job->on_done = on_done;
+
+  {
+    unique_lock<mutex> lock(mtx);
+    while ( (queue.size()>=max_queued) && (!shutting_down) )
+      queue_cv.wait(lock); // bounded queue: back-pressure on the submitter
+    if (shutting_down)
+      throw (string)"AsyncEvaluator: submit() called during shutdown";
+    queue.push_back(job);
+  }
+  queue_cv.notify_all();
+
+  return EvalHandle(job);
+}
+
+unsigned AsyncEvaluator::queued()
+{
+  lock_guard<mutex> lock(mtx);
+  return queue.size();
+}
+
+unsigned AsyncEvaluator::running()
+{
+  lock_guard<mutex> lock(mtx);
+  return n_running;
+}
+
+void AsyncEvaluator::waitAll()
+{
+  unique_lock<mutex> lock(mtx);
+  while ( (queue.size()>0) || (n_running>0) )
+    idle_cv.wait(lock);
+}
+
+void AsyncEvaluator::workerLoop(Worker* w)
+{
+  InstructionSet* iset = NULL;
+  string iset_error;
+  try
+  {
+    iset = make_iset();
+  }
+  catch(string& s)
+  {
+    iset_error = s;
+  }
+  catch(exception& e)
+  {
+    iset_error = e.what();
+  }
+  vector<double> no_input, no_output; // placeholders, runFitnessCases() points the core at each case
+  MemCore core(D_size, L_size, no_input, no_output);
+
+  while (true) {
+    shared_ptr<EvalJob> job;
+    {
+      unique_lock<mutex> lock(mtx);
+      while ( (queue.size()==0) && (!shutting_down) )
+        queue_cv.wait(lock);
+      if (queue.size()==0)
+        break; // shutting down
+      job = queue.front();
+      queue.pop_front();
+      if (job->timeout_ms>0)
+        job->deadline = Clock::now() + chrono::milliseconds(job->timeout_ms);
+      w->current = job;
+      n_running++;
+    }
+    queue_cv.notify_all(); // a queue slot is free
+    if (job->timeout_ms>0)
+      watchdog_cv.notify_all();
+
+    bool stopped = job->cancel_requested; // cancelled while queued: not run at all
+    if (!stopped) {
+      // Anything an instruction throws (other than the loop depth check) fails the job
+      try
+      {
+        if (!iset)
+          throw iset_error;
+        runFitnessCases(*iset, core, job->bc, *job->cases, job->randseed, job->stop, job->max_loop_depth, job->result);
+      }
+      catch(string& s)
+      {
+        job->error = s;
+      }
+      catch(exception& e)
+      {
+        job->error = e.what();
+      }
+      catch(...)
+      {
+        job->error = "Unknown exception";
+      }
+      if (!job->error.empty())
+        job->result.n_failed++;
+      stopped = job->result.cancelled; // not job->stop, which may have been raised after the last case
+    }
+
+    {
+      lock_guard<mutex> lock(job->mtx);
+      job->ran = true; // from here on cancel() and the watchdog leave the job alone
+      job->result.cancelled = stopped; // cancelled while queued or running, or timed out
+      job->result.timedout = stopped && !job->cancel_requested;
+    }
+    if (job->result.timedout && metricsEnabled())
+      metrics().threadShard().add(METRIC_TIMEOUTS, 1);
+
+    if (job->on_done) {
+      try
+      {
+        job->on_done(job->result);
+      }
+      catch(...) // the callback's own failure, reported to the handle if nothing else was
+      {
+        if (job->error.empty())
+          job->error = "Completion callback threw";
+      }
+    }
+    job->finish();
+
+    {
+      lock_guard<mutex> lock(mtx);
+      w->current.reset();
+      n_running--;
+    }
+    idle_cv.notify_all();
+  }
+
+  delete iset;
+}
+
+// Raises the stop flag of running jobs whose deadline has passed. Sleeps until the nearest deadline.
+void AsyncEvaluator::watchdogLoop()
+{
+  unique_lock<mutex> lock(mtx);
+  while (!shutting_down) {
+    Clock::time_point now = Clock::now();
+    Clock::time_point next = Clock::time_point::max();
+
+    for (unsigned i=0;i<workers.size();i++) {
+      shared_ptr<EvalJob>& job = workers[i]->current;
+      if ( (!job) || (job->timeout_ms<=0) || job->stop )
+        continue;
+      if (job->deadline<=now)
+        job->halt(false);
+      else if (job->deadline<next)
+        next = job->deadline;
+    }
+
+    if (next==Clock::time_point::max())
+      watchdog_cv.wait(lock);
+    else
+      watchdog_cv.wait_until(lock, next);
+  }
+}
+
+}; //namespace SlashA
@@ -0,0 +1,102 @@
+/*
+ *
+ *  SlashA_Async.hpp - asynchronous evaluation of ByteCodes on a bounded pool of worker threads
+ *
+ *  Copyright (C) 2004-2011 Artur B Adib
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef SLASHA_ASYNC_INCLUDED // duplicate protection
+#define SLASHA_ASYNC_INCLUDED
+
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include "SlashA.hpp"
+
+namespace SlashA
+{
+
+  typedef std::function<void(const EvalResult&)> EvalCallback; // called from the worker thread once a job is done
+
+  class EvalJob; // shared state between an EvalHandle and the worker running it
+
+  class EvalHandle
+  {
+    private:
+      std::shared_ptr<EvalJob> job;
+    public:
+      EvalHandle() {}
+      EvalHandle(std::shared_ptr<EvalJob> j) : job(j) {}
+
+      bool valid() const { return (bool)job; }
+      bool ready() const; // true once the job has completed (normally, timed-out or cancelled)
+      void wait() const;
+      bool waitFor(long timeout_ms) const; // returns ready()
+      void cancel(); // stops the job if queued or running; completion is still reported
+      const EvalResult& get() const; // waits for completion
+      std::string error() const; // waits for completion; what the job threw, if anything (it then counts as failed)
+  };
+
+  class AsyncEvaluator
+  {
+    private:
+      struct Worker;
+
+      ISetFactory make_iset;
+      unsigned D_size, L_size;
+      unsigned max_queued;
+
+      std::deque< std::shared_ptr<EvalJob> > queue;
+      std::vector<Worker*> workers;
+      std::thread watchdog;
+      std::mutex mtx;
+      std::condition_variable queue_cv; // signals workers (job queued) and submitters (slot freed)
+      std::condition_variable watchdog_cv; // signals the watchdog (job started or shutdown)
+      std::condition_variable idle_cv; // signals waitAll()
+      unsigned n_running;
+      bool shutting_down;
+
+      void workerLoop(Worker* w);
+      void watchdogLoop();
+
+    public:
+      AsyncEvaluator(unsigned n_threads,
+                     unsigned _max_queued, // submit() blocks while this many jobs are waiting
+                     ISetFactory _make_iset, // called once per worker thread; the evaluator deletes the sets. If it
+                                             // throws, the jobs that thread takes fail with the message
+                     unsigned _D_size,
+                     unsigned _L_size);
+      ~AsyncEvaluator(); // cancels everything still queued or running
+
+      // The ByteCode is copied, the fitness cases are not: they must outlive the job.
+      EvalHandle submit(const ByteCode& bc,
+                        FitnessCases& cases,
+                        long randseed,
+                        long timeout_ms, // 0 for no limit
+                        int max_loop_depth,
+                        EvalCallback on_done = EvalCallback());
+
+      unsigned queued(); // jobs waiting for a worker
+      unsigned running();
+      void waitAll(); // blocks until the queue is empty and all workers are idle
+  };
+
+}; // namespace SlashA
+
+#endif // SLASHA_ASYNC_INCLUDED
@@ -0,0 +1,260 @@
+/*
+ *
+ *  SlashA_Behavior.cpp
+ *
+ *  Copyright (C) 2004-2011 Artur B Adib
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <cmath>
+#include <cstdlib>
+#include <random>
+#include <algorithm>
+#include "SlashA_Behavior.hpp"
+#include "SlashA_Kernels.hpp"
+
+using namespace std;
+
+namespace SlashA
+{
+
+
+/*
+ *
+ * Class methods
+ *
+ */
+
+//
+//  Class: BehaviorIndex
+//
+
+BehaviorIndex::BehaviorIndex(unsigned _dim,
+                             double _bucket_width,
+                             unsigned _n_tables,
+                             unsigned _n_projections,
+                             unsigned long seed)
+{
+  if ( (_dim==0) || (_n_tables==0) || (_n_projections==0) || (!(_bucket_width>0)) )
+    throw (string)"Invalid behavior index parameters";
+
+  dim = _dim;
+  stride = (dim+3) & ~3u;
+  n_tables = _n_tables;
+  n_projections = _n_projections;
+  bucket_width = _bucket_width;
+
+  mt19937_64 gen(seed);
+  normal_distribution<double> gauss(0.0, 1.0);
+  uniform_real_distribution<double> uniform(0.0, bucket_width);
+
+  proj.assign((size_t)n_tables*n_projections*stride, 0.0); // padding coefficients stay 0
+  offset.resize(n_tables*n_projections);
+  for (unsigned p=0;p<n_tables*n_projections;p++) {
+    for (unsigned i=0;i<dim;i++)
+      proj[(size_t)p*stride+i] = gauss(gen);
+    offset[p] = uniform(gen);
+  }
+  tables.resize(n_tables);
+}
+
+void BehaviorIndex::buckets(const double* v, unsigned table, int64_t* h) const
+{
+  for (unsigned j=0;j<n_projections;j++) {
+    const unsigned p = table*n_projections + j;
+    h[j] = (int64_t)floor((Kernels::dot(&proj[(size_t)p*stride], v, stride) + offset[p]) / bucket_width);
+  }
+}
+
+uint64_t BehaviorIndex::bucketKey(const int64_t* h) const
+{
+  uint64_t key = 0xcbf29ce484222325ULL;
+  for (unsigned j=0;j<n_projections;j++)
+    key = (key ^ (uint64_t)h[j]) * 0x100000001b3ULL; // FNV-1a over the bucket numbers
+  return key;
+}
+
+// Adds the buckets whose numbers differ from h by exactly "steps" in total over projections j and up
+void BehaviorIndex::probe(unsigned table, int64_t* h, unsigned j, unsigned steps, vector<unsigned>& cand) const
+{
+  if (steps==0) {
+    addBucket(table, bucketKey(h), cand);
+    return;
+  }
+  if (j==n_projections)
+    return;
+
+  for (int d=-(int)steps;d<=(int)steps;d++) {
+    h[j] += d;
+    probe(table, h, j+1, steps-abs(d), cand);
+    h[j] -= d;
+  }
+}
+
+void BehaviorIndex::candidates(const double* v, unsigned k, vector<unsigned>& cand, unsigned extra_levels,
+                               unsigned max_level) const
+{
+  vector<int64_t> h(n_tables*n_projections);
+  for (unsigned t=0;t<n_tables;t++)
+    buckets(v, t, &h[t*n_projections]);
+
+  cand.clear();
+  unsigned last = min(max_level, probeLevels);
+  bool found = false;
+  for (unsigned level=0;level<=last;level++) {
+    for (unsigned t=0;t<n_tables;t++)
+      probe(t, &h[t*n_projections], 0, level, cand);
+    sort(cand.begin(), cand.end());
+    cand.erase(unique(cand.begin(), cand.end()), cand.end());
+
+    if ( (!found) && (cand.size()>=k) ) {
+      found = true;
+      last = min(level+extra_levels, last);
+    }
+  }
+}
+
+void BehaviorIndex::addBucket(unsigned table, uint64_t key, vector<unsigned>& cand) const
+{
+  unordered_map< uint64_t, vector<unsigned> >::const_iterator it = tables[table].find(key);
+  if (it!=tables[table].end())
+    cand.insert(cand.end(), it->second.begin(), it->second.end());
+}
+
+unsigned BehaviorIndex::insert(const double* v)
+{
+  const unsigned id = size();
+  data.resize(data.size()+stride, 0.0);
+  double* dst = &data[(size_t)id*stride];
+  for (unsigned i=0;i<dim;i++)
+    dst[i] = v[i];
+
+  vector<int64_t> h(n_projections);
+  for (unsigned t=0;t<n_tables;t++) {
+    buckets(dst, t, &h[0]);
+    tables[t][bucketKey(&h[0])].push_back(id);
+  }
+  return id;
+}
+
+unsigned BehaviorIndex::insert(const vector<double>& v)
+{
+  if (v.size()!=dim)
+    throw (string)"Behavior vector has the wrong dimension";
+  return insert(&v[0]);
+}
+
+// Ranks ids by distance to the (padded) query q and keeps the k closest
+static void rankCandidates(const vector<double>& data, unsigned stride, const double* q, const vector<unsigned>& ids,
+                           unsigned n, unsigned k, vector<BehaviorMatch>& out)
+{
+  out.resize(n);
+  for (unsigned i=0;i<n;i++) {
+    out[i].id = ids.size() ? ids[i] : i;
+    out[i].distance = Kernels::sqdist(&data[(size_t)out[i].id*stride], q, stride);
+  }
+
+  struct Closer { bool operator()(const BehaviorMatch& a, const BehaviorMatch& b) const
+                  { return (a.distance<b.distance) || ( (a.distance==b.distance) && (a.id<b.id) ); } };
+  if (k<n) {
+    partial_sort(out.begin(), out.begin()+k, out.end(), Closer());
+    out.resize(k);
+  }
+  else
+    sort(out.begin(), out.end(), Closer());
+
+  for (unsigned i=0;i<out.size();i++)
+    out[i].distance = sqrt(out[i].distance);
+}
+
+void BehaviorIndex::nearest(const double* v, unsigned k, vector<BehaviorMatch>& out, bool exact) const
+{
+  vector<double> q(stride, 0.0);
+  for (unsigned i=0;i<dim;i++)
+    q[i] = v[i];
+
+  vector<unsigned> cand;
+  if (exact)
+    rankCandidates(data, stride, &q[0], cand, size(), k, out);
+  else {
+    candidates(&q[0], k, cand, 1); // the next level raises the recall of the k found first
+    if (cand.size()>0)
+      rankCandidates(data, stride, &q[0], cand, cand.size(), k, out);
+    else
+      out.clear();
+  }
+}
+
+int BehaviorIndex::findDuplicate(const double* v, double eps) const
+{
+  vector<double> q(stride, 0.0);
+  for (unsigned i=0;i<dim;i++)
+    q[i] = v[i];
+
+  vector<unsigned> cand;
+  candidates(&q[0], 1, cand, 1, (eps>0) ? 1 : 0); // exact duplicates always share the home buckets
+  for (unsigned i=0;i<cand.size();i++)
+    if (Kernels::sqdist(vectorAt(cand[i]), &q[0], stride)<=eps*eps)
+      return cand[i];
+  return -1;
+}
+
+double BehaviorIndex::novelty(const double* v, unsigned k) const
+{
+  if ( (size()==0) || (k==0) )
+    return 0;
+
+  vector<BehaviorMatch> near;
+  nearest(v, k, near);
+  if (near.size()<min(k, size())) // a novel behavior: its neighbours are beyond the probed buckets
+    nearest(v, k, near, true);
+
+  double s=0;
+  for (unsigned i=0;i<near.size();i++)
+    s += near[i].distance;
+  return s/near.size();
+}
+
+void BehaviorIndex::clear()
+{
+  data.clear();
+  for (unsigned t=0;t<n_tables;t++)
+    tables[t].clear();
+}
+
+
+/*
+ *
+ * Functions
+ *
+ */
+
+void behaviorVector(const EvalResult& res,
+                    unsigned outputs_per_case,
+                    double missing,
+                    vector<double>& v,
+                    unsigned cases)
+{
+  if (cases==0)
+    cases = res.n_cases;
+  v.assign((size_t)cases*outputs_per_case, missing);
+
+  for (unsigned k=0;(k<cases) && (k<res.outputs.size());k++)
+    for (unsigned i=0;(i<outputs_per_case) && (i<res.outputs[k].size());i++)
+      v[(size_t)k*outputs_per_case+i] = res.outputs[k][i];
+}
+
+}; //namespace SlashA
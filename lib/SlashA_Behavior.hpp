@@ -0,0 +1,116 @@
+/*
+ *
+ *  SlashA_Behavior.hpp - index of program behavior vectors for novelty search and deduplication
+ *
+ *  Copyright (C) 2004-2011 Artur B Adib
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef SLASHA_BEHAVIOR_INCLUDED // duplicate protection
+#define SLASHA_BEHAVIOR_INCLUDED
+
+#include <unordered_map>
+#include <stdint.h>
+#include "SlashA.hpp"
+
+namespace SlashA
+{
+
+  const unsigned probeLevels = 3; // multi-probe radius, in buckets summed over the projections of a table
+
+  class BehaviorMatch
+  {
+    public:
+      unsigned id; // insertion order, starting at 0
+      double distance; // Euclidean
+  };
+
+  /*
+   * Behavior vectors are stored back to back in one array, each padded to a multiple of four doubles, so
+   * distances run through the SSE2 kernels without any gather. Queries go through a p-stable LSH index:
+   * each of n_tables tables hashes a vector by n_projections Gaussian projections, quantized into buckets
+   * of width bucket_width, and only the vectors sharing a bucket with the query in some table have their
+   * distance computed. Vectors closer than bucket_width collide in a table with good probability, and
+   * identical vectors always do, so exact duplicates are never missed. Nearest-neighbour queries also probe
+   * the buckets around the query's own, level by level: those l steps away, counted over the projections of
+   * a table, until k candidates are found and then one level further, for l up to probeLevels.
+   * bucket_width should be about the distance that still counts as "near"; more tables raise recall, more
+   * projections cut the candidates.
+   *
+   * Not synchronized: with several threads inserting (e.g. from EvalPool batches), guard the index with a
+   * mutex. Queries are const and may run concurrently with each other.
+   */
+  class BehaviorIndex
+  {
+    private:
+      unsigned dim, stride; // stride: dim rounded up to a multiple of 4
+      unsigned n_tables, n_projections;
+      double bucket_width;
+      std::vector<double> data; // size()*stride
+      std::vector<double> proj; // n_tables*n_projections rows of stride coefficients
+      std::vector<double> offset; // one per projection, in [0, bucket_width)
+      std::vector< std::unordered_map< uint64_t, std::vector<unsigned> > > tables;
+
+      void buckets(const double* v, unsigned table, int64_t* h) const; // bucket number along each projection
+      uint64_t bucketKey(const int64_t* h) const;
+      void addBucket(unsigned table, uint64_t key, std::vector<unsigned>& cand) const;
+      void probe(unsigned table, int64_t* h, unsigned j, unsigned steps, std::vector<unsigned>& cand) const;
+      // Sorted, no repeats: probes level after level until k candidates are found, then extra_levels more
+      void candidates(const double* v, unsigned k, std::vector<unsigned>& cand, unsigned extra_levels,
+                      unsigned max_level = probeLevels) const;
+    public:
+      BehaviorIndex(unsigned _dim,
+                    double _bucket_width = 1.0,
+                    unsigned _n_tables = 8,
+                    unsigned _n_projections = 4,
+                    unsigned long seed = 1);
+
+      unsigned insert(const double* v); // v holds dimension() values; returns the id
+      unsigned insert(const std::vector<double>& v);
+
+      // The k nearest stored vectors, closest first. Only the vectors in the probed buckets are ranked, so
+      // fewer than k matches may come back. exact scans every stored vector instead.
+      void nearest(const double* v, unsigned k, std::vector<BehaviorMatch>& out, bool exact = false) const;
+
+      // Id of a stored vector within distance eps of v, or -1; eps = 0 finds exact duplicates. With eps > 0
+      // the adjacent buckets are always probed, for near-duplicates just across a bucket boundary.
+      int findDuplicate(const double* v, double eps = 0) const;
+
+      // Novelty score: mean distance to the k nearest stored vectors (0 if the index is empty). Falls back
+      // to a full scan only when even the probed buckets hold fewer than k vectors. For a behavior many
+      // bucket widths away from its neighbours the probes find some of them only, and the score is too high.
+      double novelty(const double* v, unsigned k) const;
+
+      const double* vectorAt(unsigned id) const { return &data[(size_t)id*stride]; }
+      unsigned size() const { return data.size()/stride; }
+      unsigned dimension() const { return dim; }
+      void clear();
+  };
+
+  /* Functions */
+
+  // Flattens the outputs of an evaluation into a behavior vector of res.n_cases (or cases, if non-zero)
+  // times outputs_per_case values. Outputs a case did not produce, and cases that were not run, become
+  // missing; extra outputs are dropped.
+  void behaviorVector(const EvalResult& res,
+                      unsigned outputs_per_case,
+                      double missing,
+                      std::vector<double>& v,
+                      unsigned cases = 0);
+
+}; // namespace SlashA
+
+#endif // SLASHA_BEHAVIOR_INCLUDED
@@ -21,7 +21,10 @@
 
 #include <cmath>
 #include <sstream>
+#include <algorithm>
 #include "NR-ran2.hpp"
+#include "SlashA_Kernels.hpp"
+#include "SlashA_Math.hpp"
 
 namespace SlashA 
 {
@@ -29,84 +32,84 @@ namespace SlashA
 namespace DIS
 {
 
-class SetI : public Instruction
+template <class T>
+inline void gatherF(BasicMemCore<T>** cores, unsigned n, double* x) // F of every lane, for the batched math kernels
 {
-  private:
-    ByteCode_Type num;
-  public:
-    SetI(ByteCode_Type n) : Instruction() 
-    { 
-      std::ostringstream nstr;
-      nstr << n;
-      name=nstr.str(); 
-      DIS_flag = true; 
-      num = n; 
-    };
-    ~SetI() {};
-    inline void code(MemCore& core, InstructionSet& iset) { core.I = num; n_ops++; } 
-};
+  for (unsigned i=0;i<n;i++)
+    x[i] = cores[i]->getF();
+}
 
-class ItoF : public Instruction
+/*
+ * Numeric instructions (SetI, I := n) have no class of their own: InstructionSet::exec() decodes the value
+ * straight from the opcode, so no object is needed per value.
+ */
+
+template <class T>
+class ItoF : public BasicInstruction<T>
 {
   public:
-    ItoF() : Instruction() { name="itof"; DIS_flag = true; };
+    ItoF() : BasicInstruction<T>() { this->name="itof"; this->DIS_flag = true; };
     ~ItoF() {};
-    inline void code(MemCore& core, InstructionSet& iset) 
+    inline void code(BasicMemCore<T>& core, BasicInstructionSet<T>& iset) 
     { 
-      n_ops++;
+      this->n_ops++;
       if (!core.setF((double)core.I))
-        n_invops++;  
+        this->n_invops++;  
     }
 };
 
-class FtoI : public Instruction
+template <class T>
+class FtoI : public BasicInstruction<T>
 {
   public:
-    FtoI() : Instruction() { name="ftoi"; DIS_flag = true; };
+    FtoI() : BasicInstruction<T>() { this->name="ftoi"; this->DIS_flag = true; };
     ~FtoI() {};
-    inline void code(MemCore& core, InstructionSet& iset) 
+    inline void code(BasicMemCore<T>& core, BasicInstructionSet<T>& iset) 
     { 
-      n_ops++; 
-      core.I = (unsigned)rint(core.getF());
+      this->n_ops++; 
+      core.I = (unsigned)std::rint(core.getF());
     }
 };
 
-class Inc : public Instruction
+template <class T>
+class Inc : public BasicInstruction<T>
 {
   public:
-    Inc() : Instruction() { name="inc"; DIS_flag = true; };
+    Inc() : BasicInstruction<T>() { this->name="inc"; this->DIS_flag = true; };
     ~Inc() {};
-    inline void code(MemCore& core, InstructionSet& iset) 
+    inline void code(BasicMemCore<T>& core, BasicInstructionSet<T>& iset) 
     { 
-      n_ops++; 
+      this->n_ops++; 
       if ( !core.setF(core.getF()+1.0) )
-        n_invops++;
+        this->n_invops++;
     }
 };
 
-class Dec : public Instruction
+template <class T>
+class Dec : public BasicInstruction<T>
 {
   public:
-    Dec() : Instruction() { name="dec"; DIS_flag = true; };
+    Dec() : BasicInstruction<T>() { this->name="dec"; this->DIS_flag = true; };
     ~Dec() {};
-    inline void code(MemCore& core, InstructionSet& iset) 
+    inline void code(BasicMemCore<T>& core, BasicInstructionSet<T>& iset) 
     { 
-      n_ops++;
+      this->n_ops++;
       if ( !core.setF(core.getF()-1.0) )
-        n_invops++;
+        this->n_invops++;
     }
 };
 
-class Cmp : public Instruction
+template <class T>
+class Cmp : public BasicInstruction<T>
 {
   public:
-    Cmp() : Instruction() { name="cmp"; DIS_flag = true; };
+    Cmp() : BasicInstruction<T>() { this->name="cmp"; this->DIS_flag = true; };
     ~Cmp() {};
-    inline void code(MemCore& core, InstructionSet& iset) 
+    inline void code(BasicMemCore<T>& core, BasicInstructionSet<T>& iset) 
     { 
       double retvalue=0;
 
-      n_ops++;
+      this->n_ops++;
       if (core.I<core.D_size) 
       {
         if (core.D_saved[core.I]) 
@@ -115,117 +118,120 @@ class Cmp : public Instruction
             retvalue = -1;
 
           if ( !core.setF(retvalue) )
-            n_invops++;
+            this->n_invops++;
         }
         else
-          n_invops++;
+          this->n_invops++;
       }
       else
-        n_invops++;
+        this->n_invops++;
     }
 };
 
-class Load : public Instruction
+template <class T>
+class Load : public BasicInstruction<T>
 {
   public:
-    Load() : Instruction() { name="load"; DIS_flag = true; };
+    Load() : BasicInstruction<T>() { this->name="load"; this->DIS_flag = true; };
     ~Load() {};
-    inline void code(MemCore& core, InstructionSet& iset) {
-      n_ops++;
+    inline void code(BasicMemCore<T>& core, BasicInstructionSet<T>& iset) {
+      this->n_ops++;
       if (core.I<core.D_size) 
       {
         if (core.D_saved[core.I]) 
         {
           if ( !core.setF(core.D[core.I]) )
-            n_invops++;
+            this->n_invops++;
         }
         else
-          n_invops++;
+          this->n_invops++;
       }
       else
-        n_invops++;
+        this->n_invops++;
     };
 };
 
-class Save : public Instruction
+template <class T>
+class Save : public BasicInstruction<T>
 {
   public:
-    Save() : Instruction() { name="save"; DIS_flag = true; };
+    Save() : BasicInstruction<T>() { this->name="save"; this->DIS_flag = true; };
     ~Save() {};
-    inline void code(MemCore& core, InstructionSet& iset) {
-      n_ops++;
+    inline void code(BasicMemCore<T>& core, BasicInstructionSet<T>& iset) {
+      this->n_ops++;
       if (core.I<core.D_size) {
         core.D[core.I] = core.getF();
         core.D_saved[core.I] = true;
       }
       else
-        n_invops++;
+        this->n_invops++;
     }
 };
 
-class Swap : public Instruction
+template <class T>
+class Swap : public BasicInstruction<T>
 {
   public:
-    Swap() : Instruction() { name="swap"; DIS_flag = true; };
+    Swap() : BasicInstruction<T>() { this->name="swap"; this->DIS_flag = true; };
     ~Swap() {};
-    inline void code(MemCore& core, InstructionSet& iset) {
-      n_ops++;
+    inline void code(BasicMemCore<T>& core, BasicInstructionSet<T>& iset) {
+      this->n_ops++;
       if (core.I<core.D_size) {
         if (core.D_saved[core.I]) {
-          double aux = core.D[core.I];
+          T aux = core.D[core.I];
           core.D[core.I] = core.getF();
           core.setF(aux);
         }
         else
-          n_invops++;
+          this->n_invops++;
       }
       else
-        n_invops++;
+        this->n_invops++;
     }
 };
 
-class Label : public Instruction
+template <class T>
+class Label : public BasicInstruction<T>
 {
   public:
-    Label() : Instruction() { name="label"; DIS_flag = true; };
+    Label() : BasicInstruction<T>() { this->name="label"; this->DIS_flag = true; };
     ~Label() {};
-    inline void code(MemCore& core, InstructionSet& iset) {
-      n_ops++;
+    inline void code(BasicMemCore<T>& core, BasicInstructionSet<T>& iset) {
+      this->n_ops++;
       if (core.I<core.L_size) {
         core.L[core.I] = core.c; // saves current position (next instruction will be executed when this label is called)
         core.L_saved[core.I] = true;
       }
       else
-        n_invops++;
+        this->n_invops++;
     }
 };
 
-class GotoIfP : public Instruction
+template <class T>
+class GotoIfP : public BasicInstruction<T>
 {
   public:
-    GotoIfP() : Instruction() { name="gotoifp"; DIS_flag = true; };
+    GotoIfP() : BasicInstruction<T>() { this->name="gotoifp"; this->DIS_flag = true; };
     ~GotoIfP() {};
-    inline void code(MemCore& core, InstructionSet& iset) {
-      n_ops++;
+    inline void code(BasicMemCore<T>& core, BasicInstructionSet<T>& iset) {
+      this->n_ops++;
       if (core.I < core.L_size) {
         if (core.L_saved[core.I]) {
           if (core.getF()>=0) 
             core.c=core.L[core.I];
         }    
         else
-          n_invops++;
+          this->n_invops++;
       }
       else
-        n_invops++;
+        this->n_invops++;
     }
 };
 
-class JumpIfN : public Instruction
+template <class T>
+class JumpIfN : public BasicInstruction<T>
 {
   private:
-    bool never_called;
-    std::vector<unsigned> J_table; // jump-table
-
     /* 
      * The present implementation of JumpIfN uses a "jump table". In Revision 1, upon every call to jumpifn
      * (if indeed F<0) the instruction implementation would search for the corresponding jumphere. This is
@@ -236,79 +242,77 @@ class JumpIfN : public Instruction
      * corresponding point stored at the table, without any additional searches.
      *
      * Because JumpHere are dummy instructions, all of the implementation of JumpsIfN can be confined to here.
+     * The table itself lives in the MemCore, like the loop-table, so that a suspended program keeps it.
      *
      */
     
-    inline void build_J_table(MemCore& core, InstructionSet& iset)
+    inline void build_J_table(BasicMemCore<T>& core, BasicInstructionSet<T>& iset)
     {
-      const unsigned C_size=(*core.C).size();
+      const unsigned C_size=core.codeSize();
       unsigned curr_c=0; // starting from c=0 IS important! 
                          // other flow control instructions, including another jumpifn, might cause the first
                          // occurrence of jumpifn in the code to be bypassed
       unsigned searching_c;
       unsigned n_openjumps; // n_openjumps counts the number of jumps without a corresponding jumphere
       
-      J_table.clear();
-      
-      for (unsigned i=0;i<C_size;i++)
-        J_table.push_back(0); // zeroes table
+      core.J_table.assign(C_size, 0); // zeroes table
 
       while (curr_c<C_size) // this loop searches for "jumpifn" instructions in the code
       {
-        if (iset.getName((*core.C)[curr_c]) == "jumpifn") // if it's a jumpifn, searches for the corresponding jumphere
+        if (iset.is(core.codeAt(curr_c), "jumpifn")) // if it's a jumpifn, searches for the corresponding jumphere
         {
           n_openjumps=1; // the current jumpifn is open
           searching_c=curr_c+1; // starts at the next instruction
           while ( (n_openjumps>0) && (searching_c<C_size) ) // searches for the corresponding jumphere
           {
-            if (iset.getName((*core.C)[searching_c]) == "jumpifn") n_openjumps++;
-            if (iset.getName((*core.C)[searching_c]) == "jumphere") n_openjumps--;
+            if (iset.is(core.codeAt(searching_c), "jumpifn")) n_openjumps++;
+            if (iset.is(core.codeAt(searching_c), "jumphere")) n_openjumps--;
             searching_c++;
           }
 
           if (n_openjumps>0)
-            J_table[curr_c]=0; // could not find a corresponding jumphere!
+            core.J_table[curr_c]=0; // could not find a corresponding jumphere!
           else
-            J_table[curr_c]=searching_c-1; // points to the jumphere instruction (interpreter will execute next one)
+            core.J_table[curr_c]=searching_c-1; // points to the jumphere instruction (interpreter will execute next one)
         } // if name is jumpifn
         curr_c++;
       }
-      never_called=false;
     };
 
   public:
-    void clear() { never_called = true; }
-    JumpIfN() : Instruction() { name="jumpifn"; DIS_flag=true; clear(); };
+    JumpIfN() : BasicInstruction<T>() { this->name="jumpifn"; this->DIS_flag=true; };
     ~JumpIfN() {};
-    inline void code(MemCore& core, InstructionSet& iset) 
+    inline void code(BasicMemCore<T>& core, BasicInstructionSet<T>& iset) 
     {
-      n_ops++;
+      this->n_ops++;
       if (core.getF()<0) 
       {
-        if (never_called) 
+        if (core.J_table.size()==0)
           build_J_table(core, iset); // builds the jump-table on first call
         
-        if (J_table[core.c]) // only jumps if a corresponding jumphere exists
-          core.c = J_table[core.c];
+        if (core.J_table[core.c]) // only jumps if a corresponding jumphere exists
+          core.c = core.J_table[core.c];
         else
-          n_invops++;
+          this->n_invops++;
       }
     }
 };
 
-class JumpHere : public Instruction
+template <class T>
+class JumpHere : public BasicInstruction<T>
 {
   public:
-    JumpHere() : Instruction() { name="jumphere"; DIS_flag = true; };
+    JumpHere() : BasicInstruction<T>() { this->name="jumphere"; this->DIS_flag = true; };
     ~JumpHere() {};
-    inline void code(MemCore& core, InstructionSet& iset) { n_ops++; }
+    inline void code(BasicMemCore<T>& core, BasicInstructionSet<T>& iset) { this->n_ops++; }
 };
 
-class Loop : public Instruction
+template <class T>
+class Loop : public BasicInstruction<T>
 {
-    inline void build_L_table(MemCore& core, InstructionSet& iset)
+    inline void build_L_table(BasicMemCore<T>& core, BasicInstructionSet<T>& iset)
     {
-      const unsigned C_size=(*core.C).size();
+      const unsigned C_size=core.codeSize();
       unsigned curr_c=0;
       unsigned searching_c;
       unsigned n_openloops; // counts the number of repeats without a corresponding endloop
@@ -325,15 +329,15 @@ class Loop : public Instruction
 
       while (curr_c<C_size) // this loop searches for "loop" instructions in the code
       {
-        if (iset.getName((*core.C)[curr_c]) == "loop") // if it's a "loop", searches for the corresponding endloop
+        if (iset.is(core.codeAt(curr_c), "loop")) // if it's a "loop", searches for the corresponding endloop
         {
           depth=1;
           n_openloops=1; // the current loop is open
           searching_c=curr_c+1; // starts at the next instruction
           while ( (n_openloops>0) && (searching_c<C_size) ) // searches for the corresponding jumphere
           {
-            if (iset.getName((*core.C)[searching_c]) == "loop") { n_openloops++; depth++; }
-            if (iset.getName((*core.C)[searching_c]) == "endloop") n_openloops--;
+            if (iset.is(core.codeAt(searching_c), "loop")) { n_openloops++; depth++; }
+            if (iset.is(core.codeAt(searching_c), "endloop")) n_openloops--;
             searching_c++;
           };
 
@@ -354,11 +358,11 @@ class Loop : public Instruction
     };
 
   public:
-    Loop() : Instruction() { name="loop"; DIS_flag=true; };
+    Loop() : BasicInstruction<T>() { this->name="loop"; this->DIS_flag=true; };
     ~Loop() {};
-    inline void code(MemCore& core, InstructionSet& iset) 
+    inline void code(BasicMemCore<T>& core, BasicInstructionSet<T>& iset) 
     {
-      n_ops++;
+      this->n_ops++;
       if (core.L_table_addr.size()==0)
         build_L_table(core, iset); // builds the loop-table on first call
       
@@ -370,18 +374,19 @@ class Loop : public Instruction
           core.L_table_count[core.c]=core.I; // we're in a loop -- set the loop counter to core.I
       }
       else
-        n_invops++; // could not find endloop for this loop!
+        this->n_invops++; // could not find endloop for this loop!
     }
 };
 
-class EndLoop : public Instruction
+template <class T>
+class EndLoop : public BasicInstruction<T>
 {
   public:
-    EndLoop() : Instruction() { name="endloop"; DIS_flag = true; };
+    EndLoop() : BasicInstruction<T>() { this->name="endloop"; this->DIS_flag = true; };
     ~EndLoop() {};
-    inline void code(MemCore& core, InstructionSet& iset) 
+    inline void code(BasicMemCore<T>& core, BasicInstructionSet<T>& iset) 
     {
-      n_ops++;
+      this->n_ops++;
       if (core.L_table_addr.size()>0) // does L_table_* exist?
       {
         if (core.L_table_addr[core.c]) // does this EndLoop have a corresponding Loop?
@@ -394,235 +399,407 @@ class EndLoop : public Instruction
           }
         }
         else
-          n_invops++;
+          this->n_invops++;
       }
       else
-        n_invops++;
+        this->n_invops++;
     }
 };
 
-class Input : public Instruction
+template <class T>
+class Input : public BasicInstruction<T>
 {
   public:
-    Input() : Instruction() { name="input"; DIS_flag = true; };
+    Input() : BasicInstruction<T>() { this->name="input"; this->DIS_flag = true; };
     ~Input() {};
-    inline void code(MemCore& core, InstructionSet& iset) {
-      n_ops++;
-      if ( (*core.input).size() == 0 ) 
-      {
-        double finput;
-        std::cout << "Enter input #" << n_inputs+1 << ": ";
-        std::cin >> finput;
-        core.setF(finput);
-      }
-      else 
-      {
-        if ( n_inputs < (*core.input).size() )
-          core.setF( (*core.input)[n_inputs] );
-      }
+    inline void code(BasicMemCore<T>& core, BasicInstructionSet<T>& iset) {
+      this->n_ops++;
+      double x;
+      if (core.nextInput(x))
+        core.setF(x);
 
-      n_inputs++;
+      this->n_inputs++;
       if (!core.output_executed)
-        n_inputs_bf_output++;
+        this->n_inputs_bf_output++;
     }
 };
 
-class Output : public Instruction
+template <class T>
+class Output : public BasicInstruction<T>
 {
   public:
-    Output() : Instruction() { name="output"; DIS_flag = true; };
+    Output() : BasicInstruction<T>() { this->name="output"; this->DIS_flag = true; };
     ~Output() {};
-    inline void code(MemCore& core, InstructionSet& iset) {
-      n_ops++;
-      if ( (*core.input).size() == 0 )
-        std::cout << "Output #" << n_outputs+1 << ": " << core.getF() << std::endl;
-      else
-        (*core.output).push_back(core.getF());
+    inline void code(BasicMemCore<T>& core, BasicInstructionSet<T>& iset) {
+      this->n_ops++;
+      core.putOutput(core.getF());
 
-      n_outputs++;
+      this->n_outputs++;
       core.output_executed=true;
     }
 };
 
-class Abs : public Instruction
+template <class T>
+class Abs : public BasicInstruction<T>
 {
   public:
-    Abs() : Instruction() { name="abs"; DIS_flag = true; };
+    Abs() : BasicInstruction<T>() { this->name="abs"; this->DIS_flag = true; };
     ~Abs() {};
-    inline void code(MemCore& core, InstructionSet& iset) { core.setF( fabs(core.getF()) ); n_ops++; }
+    inline void code(BasicMemCore<T>& core, BasicInstructionSet<T>& iset) { core.setF( std::fabs(core.getF()) ); this->n_ops++; }
 };
 
-class Sign : public Instruction
+template <class T>
+class Sign : public BasicInstruction<T>
 {
   public:
-    Sign() : Instruction() { name="sign"; DIS_flag = true; };
+    Sign() : BasicInstruction<T>() { this->name="sign"; this->DIS_flag = true; };
     ~Sign() {};
-    inline void code(MemCore& core, InstructionSet& iset) { core.setF( -core.getF() );  n_ops++; }
+    inline void code(BasicMemCore<T>& core, BasicInstructionSet<T>& iset) { core.setF( -core.getF() );  this->n_ops++; }
 };
 
-class Exp : public Instruction
+template <class T>
+class Exp : public BasicInstruction<T>
 {
   public:
-    Exp() : Instruction() { name="exp"; DIS_flag = true; };
+    Exp() : BasicInstruction<T>() { this->name="exp"; this->DIS_flag = true; };
     ~Exp() {};
-    inline void code(MemCore& core, InstructionSet& iset) 
+    inline void code(BasicMemCore<T>& core, BasicInstructionSet<T>& iset) 
     { 
-      n_ops++; 
-      core.setF( exp(core.getF()) ); 
+      this->n_ops++; 
+      if (iset.getMathMode()==MATH_FAST)
+        core.setF( (T)Math::exp((double)core.getF()) );
+      else
+        core.setF( std::exp(core.getF()) ); 
+    }
+    void codeLanes(BasicMemCore<T>** cores, unsigned n, BasicInstructionSet<T>& iset)
+    {
+      if (iset.getMathMode()!=MATH_FAST) {
+        BasicInstruction<T>::codeLanes(cores, n, iset);
+        return;
+      }
+      double x[Math::laneBlock];
+      for (unsigned b=0;b<n;b+=Math::laneBlock) {
+        const unsigned m = std::min(n-b, Math::laneBlock);
+        gatherF(cores+b, m, x);
+        Math::exp(x, x, m);
+        for (unsigned i=0;i<m;i++)
+          cores[b+i]->setF((T)x[i]);
+        this->n_ops += m;
+      }
     }
 };
 
-class Log : public Instruction
+template <class T>
+class Log : public BasicInstruction<T>
 {
   public:
-    Log() : Instruction() { name="log"; DIS_flag = true; };
+    Log() : BasicInstruction<T>() { this->name="log"; this->DIS_flag = true; };
     ~Log() {};
-    inline void code(MemCore& core, InstructionSet& iset) 
+    inline void code(BasicMemCore<T>& core, BasicInstructionSet<T>& iset) // libm in both modes: Math::log is no faster
     { 
-      n_ops++;
-      if ( !core.setF( log(core.getF()) ) )
-        n_invops++;
+      this->n_ops++;
+      if ( !core.setF(std::log(core.getF())) )
+        this->n_invops++;
     }
 };
 
-class Sin : public Instruction
+template <class T>
+class Sin : public BasicInstruction<T>
 {
   public:
-    Sin() : Instruction() { name="sin"; DIS_flag = true; };
+    Sin() : BasicInstruction<T>() { this->name="sin"; this->DIS_flag = true; };
     ~Sin() {};
-    inline void code(MemCore& core, InstructionSet& iset) 
+    inline void code(BasicMemCore<T>& core, BasicInstructionSet<T>& iset) 
     { 
-      if ( !core.setF(sin(core.getF())) )
-        n_ops++; 
+      const T y = (iset.getMathMode()==MATH_FAST) ? (T)Math::sin((double)core.getF()) : std::sin(core.getF());
+      if ( !core.setF(y) )
+        this->n_ops++; 
+    }
+    void codeLanes(BasicMemCore<T>** cores, unsigned n, BasicInstructionSet<T>& iset)
+    {
+      if (iset.getMathMode()!=MATH_FAST) {
+        BasicInstruction<T>::codeLanes(cores, n, iset);
+        return;
+      }
+      double x[Math::laneBlock];
+      for (unsigned b=0;b<n;b+=Math::laneBlock) {
+        const unsigned m = std::min(n-b, Math::laneBlock);
+        gatherF(cores+b, m, x);
+        Math::sin(x, x, m);
+        for (unsigned i=0;i<m;i++)
+          if ( !cores[b+i]->setF((T)x[i]) )
+            this->n_ops++; // counted as in code()
+      }
     }
 };
 
-class Add : public Instruction
+template <class T>
+class Add : public BasicInstruction<T>
 {
   public:
-    Add() : Instruction() { name="add"; DIS_flag = true; };
+    Add() : BasicInstruction<T>() { this->name="add"; this->DIS_flag = true; };
     ~Add() {};
-    inline void code(MemCore& core, InstructionSet& iset) 
+    inline void code(BasicMemCore<T>& core, BasicInstructionSet<T>& iset) 
     { 
-      n_ops++;
+      this->n_ops++;
       if (core.I < core.D_size) 
       {
         if ( core.D_saved[core.I] )
         {
           if ( !core.setF( core.getF()+core.D[core.I] ) )
-            n_invops++;
+            this->n_invops++;
         }
         else
-          n_invops++;  // variable D[core.I] hasn't been saved
+          this->n_invops++;  // variable D[core.I] hasn't been saved
       }
       else
-        n_invops++;  // variable D[core.I] is out of range        
+        this->n_invops++;  // variable D[core.I] is out of range        
     }
 };
 
-class Sub : public Instruction
+template <class T>
+class Sub : public BasicInstruction<T>
 {
   public:
-    Sub() : Instruction() { name="sub"; DIS_flag = true; };
+    Sub() : BasicInstruction<T>() { this->name="sub"; this->DIS_flag = true; };
     ~Sub() {};
-    inline void code(MemCore& core, InstructionSet& iset) {
-      n_ops++;
+    inline void code(BasicMemCore<T>& core, BasicInstructionSet<T>& iset) {
+      this->n_ops++;
       if (core.I < core.D_size) {
         if ( core.D_saved[core.I] )
         {
           if ( !core.setF( core.getF()-core.D[core.I] ) )
-            n_invops++;
+            this->n_invops++;
         }
         else
-          n_invops++;  // variable D[core.I] hasn't been saved
+          this->n_invops++;  // variable D[core.I] hasn't been saved
       }
       else
-        n_invops++;  // variable D[core.I] is out of range        
+        this->n_invops++;  // variable D[core.I] is out of range        
     }
 };
 
-class Mul : public Instruction
+template <class T>
+class Mul : public BasicInstruction<T>
 {
   public:
-    Mul() : Instruction() { name="mul"; DIS_flag = true; };
+    Mul() : BasicInstruction<T>() { this->name="mul"; this->DIS_flag = true; };
     ~Mul() {};
-    inline void code(MemCore& core, InstructionSet& iset) {
-      n_ops++;
+    inline void code(BasicMemCore<T>& core, BasicInstructionSet<T>& iset) {
+      this->n_ops++;
       if (core.I < core.D_size) {
         if ( core.D_saved[core.I] )
         {
           if ( !core.setF( core.getF()*core.D[core.I] ) )
-            n_invops++;
+            this->n_invops++;
         }
         else
-          n_invops++;  // variable D[core.I] hasn't been saved
+          this->n_invops++;  // variable D[core.I] hasn't been saved
       }
       else
-        n_invops++;  // variable D[core.I] is out of range        
+        this->n_invops++;  // variable D[core.I] is out of range        
     }
 };
 
-class Div : public Instruction
+template <class T>
+class Div : public BasicInstruction<T>
 {
   public:
-    Div() : Instruction() { name="div"; DIS_flag = true; };
+    Div() : BasicInstruction<T>() { this->name="div"; this->DIS_flag = true; };
     ~Div() {};
-    inline void code(MemCore& core, InstructionSet& iset) {
-      n_ops++;
+    inline void code(BasicMemCore<T>& core, BasicInstructionSet<T>& iset) {
+      this->n_ops++;
       if (core.I < core.D_size) {
         if ( core.D_saved[core.I]  )
         {
           if ( !core.setF( core.getF()/core.D[core.I] ) )
-            n_invops++;
+            this->n_invops++;
         }
         else
-          n_invops++;  // variable D[core.I] hasn't been saved
+          this->n_invops++;  // variable D[core.I] hasn't been saved
       }
       else
-        n_invops++;  // variable D[core.I] is out of range
+        this->n_invops++;  // variable D[core.I] is out of range
     }
 };
 
-class Pow : public Instruction
+template <class T>
+class Pow : public BasicInstruction<T>
 {
   public:
-    Pow() : Instruction() { name="pow"; DIS_flag = true; };
+    Pow() : BasicInstruction<T>() { this->name="pow"; this->DIS_flag = true; };
     ~Pow() {};
-    inline void code(MemCore& core, InstructionSet& iset) {
-      n_ops++;
+    inline void code(BasicMemCore<T>& core, BasicInstructionSet<T>& iset) {
+      this->n_ops++;
       if (core.I < core.D_size) {
         if ( core.D_saved[core.I] ) 
         {
-          if ( !core.setF(pow(core.getF(),core.D[core.I])) )
-            n_invops++;
+          if ( !core.setF(std::pow(core.getF(),core.D[core.I])) ) // libm: Math::pow only wins batched (codeLanes())
+            this->n_invops++;
         }
         else
-          n_invops++;  // variable D[core.I] hasn't been saved
+          this->n_invops++;  // variable D[core.I] hasn't been saved
       }
       else
-        n_invops++;  // variable D[core.I] is out of range
+        this->n_invops++;  // variable D[core.I] is out of range
+    }
+    void codeLanes(BasicMemCore<T>** cores, unsigned n, BasicInstructionSet<T>& iset)
+    {
+      if (iset.getMathMode()!=MATH_FAST) {
+        BasicInstruction<T>::codeLanes(cores, n, iset);
+        return;
+      }
+      double x[Math::laneBlock], p[Math::laneBlock];
+      BasicMemCore<T>* valid[Math::laneBlock]; // lanes with a saved D[I]
+      for (unsigned b=0;b<n;b+=Math::laneBlock) {
+        const unsigned m = std::min(n-b, Math::laneBlock);
+        unsigned k=0;
+        for (unsigned i=0;i<m;i++) {
+          BasicMemCore<T>& core = *cores[b+i];
+          if ( (core.I<core.D_size) && core.D_saved[core.I] ) {
+            valid[k] = &core;
+            x[k] = core.getF();
+            p[k++] = core.D[core.I];
+          }
+          else
+            this->n_invops++;
+        }
+        Math::pow(x, p, x, k);
+        for (unsigned i=0;i<k;i++)
+          if ( !valid[i]->setF((T)x[i]) )
+            this->n_invops++;
+        this->n_ops += m;
+      }
     }
 };
 
-class Ran : public Instruction
+template <class T>
+class Ran : public BasicInstruction<T>
 {
   public:
-    Ran() : Instruction() { name="ran"; DIS_flag = true; };
+    Ran() : BasicInstruction<T>() { this->name="ran"; this->DIS_flag = true; };
     ~Ran() {};
-    inline void code(MemCore& core, InstructionSet& iset) 
+    inline void code(BasicMemCore<T>& core, BasicInstructionSet<T>& iset) 
+    {
+      if ( !core.setF( NumericalRecipes::ran2(core.ran) ) )
+        this->n_invops++;
+      this->n_ops++;
+    }
+};
+
+/*
+ * Range instructions work on a window of the data tape whose length is stored in the header cell D[I];
+ * the window itself starts at D[I+1]. Every cell read must have been saved and lie within D[], otherwise
+ * the operation is invalid and nothing is changed (same rules as load/add/etc).
+ */
+template <class T>
+inline bool rangeWindow(BasicMemCore<T>& core, unsigned n_windows, unsigned& n) // returns the window length in n
+{
+  if ( (core.I>=core.D_size) || (!core.D_saved[core.I]) )
+    return false;
+
+  const double len = std::fabs(core.D[core.I]);
+  if ( (len<1) || (len>core.D_size) )
+    return false;
+
+  n = (unsigned)std::rint(len);
+  if ( (unsigned long)core.I + 1 + (unsigned long)n_windows*n > core.D_size )
+    return false;
+
+  const bool* saved = core.D_saved + core.I + 1;
+  return std::find(saved, saved + n_windows*n, false) == saved + n_windows*n;
+}
+
+template <class T>
+class RSum : public BasicInstruction<T>
+{
+  public:
+    RSum() : BasicInstruction<T>() { this->name="rsum"; this->DIS_flag = true; };
+    ~RSum() {};
+    inline void code(BasicMemCore<T>& core, BasicInstructionSet<T>& iset) 
+    {
+      unsigned n;
+      this->n_ops++;
+      if (rangeWindow(core, 1, n))
+      {
+        if ( !core.setF( Kernels::sum(core.D+core.I+1, n) ) )
+          this->n_invops++;
+      }
+      else
+        this->n_invops++;
+    }
+};
+
+template <class T>
+class Dot : public BasicInstruction<T>
+{
+  public:
+    Dot() : BasicInstruction<T>() { this->name="dot"; this->DIS_flag = true; };
+    ~Dot() {};
+    inline void code(BasicMemCore<T>& core, BasicInstructionSet<T>& iset) 
+    {
+      unsigned n;
+      this->n_ops++;
+      if (rangeWindow(core, 2, n)) // two adjacent windows: D[I+1..I+n] and D[I+n+1..I+2n]
+      {
+        if ( !core.setF( Kernels::dot(core.D+core.I+1, core.D+core.I+1+n, n) ) )
+          this->n_invops++;
+      }
+      else
+        this->n_invops++;
+    }
+};
+
+template <class T>
+class RScale : public BasicInstruction<T>
+{
+  public:
+    RScale() : BasicInstruction<T>() { this->name="rscale"; this->DIS_flag = true; };
+    ~RScale() {};
+    inline void code(BasicMemCore<T>& core, BasicInstructionSet<T>& iset) 
     {
-      if ( !core.setF( NumericalRecipes::ran2(core.ran_ptr) ) )
-        n_invops++;
-      n_ops++;
+      unsigned n;
+      this->n_ops++;
+      if (rangeWindow(core, 1, n))
+      {
+        T* window = core.D+core.I+1;
+        if ( std::isfinite(Kernels::maxabs(window, n)*core.getF()) ) // the tape never holds inf's or nan's
+          Kernels::scale(window, core.getF(), n);
+        else
+          this->n_invops++;
+      }
+      else
+        this->n_invops++;
+    }
+};
+
+template <class T>
+class Horner : public BasicInstruction<T>
+{
+  public:
+    Horner() : BasicInstruction<T>() { this->name="horner"; this->DIS_flag = true; };
+    ~Horner() {};
+    inline void code(BasicMemCore<T>& core, BasicInstructionSet<T>& iset) 
+    {
+      unsigned n;
+      this->n_ops++;
+      if (rangeWindow(core, 1, n)) // coefficients in ascending order, evaluated at x=F
+      {
+        if ( !core.setF( Kernels::horner(core.D+core.I+1, n, core.getF()) ) )
+          this->n_invops++;
+      }
+      else
+        this->n_invops++;
     }
 };
 
-class Nop : public Instruction
+template <class T>
+class Nop : public BasicInstruction<T>
 {
   public:
-    Nop() : Instruction() { name="nop"; DIS_flag = true; };
+    Nop() : BasicInstruction<T>() { this->name="nop"; this->DIS_flag = true; };
     ~Nop() {};
-    inline void code(MemCore& core, InstructionSet& iset) { n_ops++; }
+    inline void code(BasicMemCore<T>& core, BasicInstructionSet<T>& iset) { this->n_ops++; }
 };
 
 } // namespace DIS
@@ -0,0 +1,701 @@
+/*
+ *
+ *  SlashA_Daemon.cpp
+ *
+ *  Copyright (C) 2004-2011 Artur B Adib
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <cerrno>
+#include <cstring>
+#include <chrono>
+#include <algorithm>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include "SlashA_Daemon.hpp"
+
+using namespace std;
+
+namespace SlashA
+{
+
+static bool readFull(int fd, void* p, size_t n)
+{
+  char* c = (char*)p;
+  while (n>0) {
+    const ssize_t r = read(fd, c, n);
+    if (r<0) {
+      if (errno==EINTR)
+        continue;
+      return false;
+    }
+    if (r==0) // closed
+      return false;
+    c += r;
+    n -= r;
+  }
+  return true;
+}
+
+static bool writeFull(int fd, const void* p, size_t n)
+{
+  const char* c = (const char*)p;
+  while (n>0) {
+    const ssize_t r = send(fd, c, n, MSG_NOSIGNAL); // a client that went away is an error, not a SIGPIPE
+    if (r<0) {
+      if (errno==EINTR)
+        continue;
+      return false;
+    }
+    c += r;
+    n -= r;
+  }
+  return true;
+}
+
+template <class X>
+static inline void put(vector<char>& buf, X x)
+{
+  const char* p = (const char*)&x;
+  buf.insert(buf.end(), p, p+sizeof(X));
+}
+
+template <class X>
+static inline bool get(int fd, X& x)
+{
+  return readFull(fd, &x, sizeof(X));
+}
+
+static bool flush(int fd, vector<char>& buf)
+{
+  const bool ok = writeFull(fd, buf.data(), buf.size());
+  buf.clear();
+  return ok;
+}
+
+static bool writeError(int fd, const string& msg)
+{
+  vector<char> buf;
+  put<uint32_t>(buf, daemonMagic);
+  put<uint32_t>(buf, 1);
+  put<uint32_t>(buf, msg.size());
+  buf.insert(buf.end(), msg.begin(), msg.end());
+  return flush(fd, buf);
+}
+
+// A socket file left by a server that is gone: nothing accepts connections on it
+static bool staleSocket(const sockaddr_un& addr)
+{
+  struct stat st;
+  if ( (lstat(addr.sun_path, &st)<0) || !S_ISSOCK(st.st_mode) )
+    return false;
+  const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd<0)
+    return false;
+  const bool refused = (connect(fd, (const sockaddr*)&addr, sizeof(addr))<0) && (errno==ECONNREFUSED);
+  close(fd);
+  return refused;
+}
+
+static int connectTo(const string& path, bool listening, int& fd)
+{
+  sockaddr_un addr;
+  if (path.size()>=sizeof(addr.sun_path))
+    throw (string)"Socket path too long: " + path;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strcpy(addr.sun_path, path.c_str());
+
+  fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd<0)
+    return -1;
+  if (listening) {
+    if (staleSocket(addr)) // from a previous run; anything else at the path makes bind() fail
+      unlink(path.c_str());
+    if ( (bind(fd, (sockaddr*)&addr, sizeof(addr))<0) || (listen(fd, SOMAXCONN)<0) )
+      return -1;
+  }
+  else if (connect(fd, (sockaddr*)&addr, sizeof(addr))<0)
+    return -1;
+  return 0;
+}
+
+
+/*
+ *
+ * Class methods
+ *
+ */
+
+//
+//  Class: EvalServer
+//
+
+struct EvalServer::Request
+{
+  vector<ByteCode> programs;
+  vector<EvalResult> results;
+  long randseed;
+  int max_loop_depth;
+  chrono::steady_clock::time_point arrived;
+  bool done;
+  bool failed; // dropped by stop(), or error set
+  string error; // the evaluation threw
+};
+
+struct EvalServer::Dataset
+{
+  FitnessCases* cases;
+  EvalPool* pool;
+  deque<Request*> queue;
+  unsigned queued_programs;
+  condition_variable cv; // a request arrived, or shutting down
+  thread batcher;
+};
+
+struct EvalServer::Connection
+{
+  int fd; // -1 once closed
+  thread th;
+};
+
+EvalServer::EvalServer(ISetFactory _make_iset,
+                       unsigned _D_size,
+                       unsigned _L_size,
+                       unsigned _max_batch,
+                       unsigned _max_wait_us)
+{
+  make_iset = _make_iset;
+  D_size = _D_size;
+  L_size = _L_size;
+  max_batch = _max_batch ? _max_batch : 1;
+  max_wait_us = _max_wait_us;
+  listen_fd = -1;
+  running = shutting_down = false;
+  n_requests = n_programs = n_batches = 0;
+  latency_next = 0;
+
+  InstructionSet* proto = make_iset();
+  n_opcodes = proto->size();
+  delete proto;
+}
+
+EvalServer::~EvalServer()
+{
+  stop();
+  for (unsigned k=0;k<datasets.size();k++) {
+    delete datasets[k]->pool;
+    delete datasets[k];
+  }
+}
+
+unsigned EvalServer::addDataset(FitnessCases& cases, unsigned n_threads, bool pin)
+{
+  if (running)
+    throw (string)"EvalServer: datasets must be added before start()";
+  Dataset* ds = new Dataset;
+  ds->cases = &cases;
+  ds->queued_programs = 0;
+  ds->pool = new EvalPool(make_iset, cases, D_size, L_size, n_threads, pin);
+  datasets.push_back(ds);
+  return datasets.size()-1;
+}
+
+void EvalServer::start(const string& socket_path)
+{
+  if (running)
+    return;
+  if (datasets.empty())
+    throw (string)"EvalServer: no dataset to serve";
+
+  path = socket_path;
+  if (connectTo(path, true, listen_fd)<0) {
+    const string err = strerror(errno);
+    if (listen_fd>=0)
+      close(listen_fd);
+    listen_fd = -1;
+    throw (string)"Cannot listen on " + path + ": " + err;
+  }
+
+  running = true;
+  shutting_down = false;
+  for (unsigned k=0;k<datasets.size();k++)
+    datasets[k]->batcher = thread(&EvalServer::batchLoop, this, datasets[k]);
+  acceptor = thread(&EvalServer::acceptLoop, this);
+}
+
+void EvalServer::stop()
+{
+  {
+    lock_guard<mutex> lock(mtx);
+    if (!running)
+      return;
+    shutting_down = true;
+    for (unsigned k=0;k<datasets.size();k++) {
+      datasets[k]->cv.notify_all();
+      datasets[k]->pool->cancel(); // a batch in progress ends early, its results marked cancelled
+    }
+  }
+
+  shutdown(listen_fd, SHUT_RDWR); // wakes accept()
+  acceptor.join();
+  close(listen_fd);
+  listen_fd = -1;
+  unlink(path.c_str());
+
+  for (unsigned k=0;k<datasets.size();k++)
+    datasets[k]->batcher.join();
+
+  {
+    lock_guard<mutex> lock(mtx);
+    for (unsigned k=0;k<datasets.size();k++) {
+      for (unsigned i=0;i<datasets[k]->queue.size();i++)
+        datasets[k]->queue[i]->done = datasets[k]->queue[i]->failed = true;
+      datasets[k]->queue.clear();
+      datasets[k]->queued_programs = 0;
+    }
+    done_cv.notify_all();
+    for (unsigned i=0;i<connections.size();i++)
+      if (connections[i]->fd>=0)
+        shutdown(connections[i]->fd, SHUT_RDWR); // wakes a blocked read or write
+  }
+
+  for (unsigned i=0;i<connections.size();i++) {
+    connections[i]->th.join();
+    delete connections[i];
+  }
+  connections.clear();
+  running = false;
+}
+
+void EvalServer::reapConnections()
+{
+  for (unsigned i=0;i<connections.size();)
+    if (connections[i]->fd<0) {
+      connections[i]->th.join(); // the thread is past its last use of mtx
+      delete connections[i];
+      connections[i] = connections.back();
+      connections.pop_back();
+    }
+    else
+      i++;
+}
+
+void EvalServer::acceptLoop()
+{
+  while (true) {
+    const int fd = accept(listen_fd, NULL, NULL);
+    lock_guard<mutex> lock(mtx);
+    if (shutting_down) {
+      if (fd>=0)
+        close(fd);
+      break;
+    }
+    if (fd<0)
+      continue; // EINTR, or a connection that failed before being accepted
+
+    reapConnections();
+    Connection* conn = new Connection;
+    conn->fd = fd;
+    connections.push_back(conn);
+    conn->th = thread(&EvalServer::serve, this, conn);
+  }
+}
+
+void EvalServer::serve(Connection* conn)
+{
+  const int fd = conn->fd;
+  while (true) {
+    uint32_t magic, kind;
+    if ( !get(fd, magic) || !get(fd, kind) )
+      break;
+    if (magic!=daemonMagic) {
+      writeError(fd, "Not a Slash/A evaluation request");
+      break;
+    }
+
+    try
+    {
+      if (!handle(fd, kind))
+        break;
+    }
+    catch(string& s)
+    {
+      writeError(fd, s);
+      break;
+    }
+    catch(exception& e)
+    {
+      writeError(fd, e.what());
+      break;
+    }
+  }
+
+  // The thread is joined by the acceptor or by stop(), which look at fd under the lock
+  lock_guard<mutex> lock(mtx);
+  close(fd);
+  conn->fd = -1;
+}
+
+bool EvalServer::handle(int fd, uint32_t kind)
+{
+  if (kind==DAEMON_STATS) {
+    const DaemonStats s = stats();
+    vector<char> buf;
+    put<uint32_t>(buf, daemonMagic);
+    put<uint32_t>(buf, 0);
+    put(buf, s.n_requests);
+    put(buf, s.n_programs);
+    put(buf, s.n_batches);
+    put(buf, s.queue_requests);
+    put(buf, s.queue_programs);
+    put(buf, s.n_connections);
+    put(buf, s.n_datasets);
+    put(buf, s.mean_batch);
+    put(buf, s.latency_mean_us);
+    put(buf, s.latency_p50_us);
+    put(buf, s.latency_p99_us);
+    put(buf, s.latency_max_us);
+    return flush(fd, buf);
+  }
+  if (kind==DAEMON_EVALUATE)
+    return evaluateRequest(fd);
+  writeError(fd, "Unknown request");
+  return false;
+}
+
+bool EvalServer::evaluateRequest(int fd)
+{
+  uint32_t ds_num, n;
+  int64_t seed;
+  int32_t depth;
+  if ( !get(fd, ds_num) || !get(fd, n) || !get(fd, seed) || !get(fd, depth) )
+    return false;
+
+  if (n>daemonMaxPrograms) {
+    writeError(fd, "Request too large");
+    return false; // checked before anything is allocated for it
+  }
+
+  Request req;
+  req.randseed = seed;
+  req.max_loop_depth = depth;
+  req.done = req.failed = false;
+  req.programs.resize(n);
+
+  uint64_t words = 0;
+  bool opcodes_ok = true;
+  for (unsigned i=0;i<n;i++) {
+    uint32_t length;
+    if (!get(fd, length))
+      return false;
+    words += length;
+    if (words>daemonMaxWords) {
+      writeError(fd, "Request too large");
+      return false; // the rest of the request cannot be skipped safely
+    }
+    ByteCode& bc = req.programs[i];
+    bc.resize(length);
+    if ( (length>0) && !readFull(fd, bc.data(), length*sizeof(ByteCode_Type)) )
+      return false;
+    for (unsigned k=0;k<length;k++)
+      opcodes_ok &= (bc[k]<n_opcodes);
+  }
+
+  if (ds_num>=datasets.size())
+    return writeError(fd, "Unknown dataset");
+  if (!opcodes_ok)
+    return writeError(fd, "Opcode out of range of the instruction set");
+
+  if (n>0) {
+    Dataset* ds = datasets[ds_num];
+    unique_lock<mutex> lock(mtx);
+    if (shutting_down)
+      req.done = req.failed = true;
+    else {
+      req.arrived = chrono::steady_clock::now();
+      ds->queue.push_back(&req);
+      ds->queued_programs += n;
+      ds->cv.notify_one();
+    }
+    while (!req.done)
+      done_cv.wait(lock);
+  }
+  if (req.failed) {
+    if (!req.error.empty()) // the request was read whole, so the connection can go on
+      return writeError(fd, req.error);
+    writeError(fd, "Server shutting down");
+    return false;
+  }
+
+  vector<char> buf;
+  put<uint32_t>(buf, daemonMagic);
+  put<uint32_t>(buf, 0);
+  put<uint32_t>(buf, n);
+  for (unsigned i=0;i<n;i++) {
+    const EvalResult& r = req.results[i];
+    put<uint32_t>(buf, r.n_cases);
+    put<uint64_t>(buf, r.n_ops);
+    put<uint64_t>(buf, r.n_invops);
+    put<uint64_t>(buf, r.n_inputs_bf_output);
+    put<uint32_t>(buf, r.n_failed);
+    put<uint32_t>(buf, r.cancelled ? 1 : 0);
+    for (unsigned k=0;k<r.n_cases;k++) {
+      const unsigned n_out = (k<r.outputs.size()) ? r.outputs[k].size() : 0;
+      put<uint32_t>(buf, n_out);
+      if (n_out>0) {
+        const char* p = (const char*)r.outputs[k].data();
+        buf.insert(buf.end(), p, p+n_out*sizeof(double));
+      }
+    }
+    if ( (buf.size()>=(1<<16)) && !flush(fd, buf) ) // streams large responses
+      return false;
+  }
+  return flush(fd, buf);
+}
+
+void EvalServer::batchLoop(Dataset* ds)
+{
+  unique_lock<mutex> lock(mtx);
+  while (true) {
+    while (ds->queue.empty() && !shutting_down)
+      ds->cv.wait(lock);
+    if (shutting_down)
+      break;
+
+    // Gives smaller requests time to join, unless a full batch is already waiting
+    const chrono::steady_clock::time_point deadline = ds->queue.front()->arrived + chrono::microseconds(max_wait_us);
+    while ( (ds->queued_programs<max_batch) && !shutting_down )
+      if (ds->cv.wait_until(lock, deadline)==cv_status::timeout)
+        break;
+    if (shutting_down)
+      break;
+
+    // Pools run one seed and loop depth per batch: takes the requests that share the oldest one's, in order
+    const long seed = ds->queue.front()->randseed;
+    const int depth = ds->queue.front()->max_loop_depth;
+    vector<Request*> batch;
+    unsigned n = 0;
+    for (deque<Request*>::iterator it=ds->queue.begin();(it!=ds->queue.end()) && (n<max_batch);)
+      if ( ((*it)->randseed==seed) && ((*it)->max_loop_depth==depth) ) {
+        n += (*it)->programs.size();
+        batch.push_back(*it);
+        it = ds->queue.erase(it);
+      }
+      else
+        ++it;
+    ds->queued_programs -= n;
+    lock.unlock();
+
+    string error;
+    try
+    {
+      vector<ByteCode> programs;
+      programs.reserve(n);
+      for (unsigned r=0;r<batch.size();r++)
+        for (unsigned i=0;i<batch[r]->programs.size();i++)
+          programs.push_back(std::move(batch[r]->programs[i]));
+      vector<EvalResult> results(n);
+      ds->pool->evaluate(programs, results, seed, depth);
+
+      unsigned k = 0;
+      for (unsigned r=0;r<batch.size();r++) {
+        batch[r]->results.resize(batch[r]->programs.size());
+        for (unsigned i=0;i<batch[r]->results.size();i++)
+          batch[r]->results[i] = std::move(results[k++]);
+      }
+    }
+    catch(string& s)
+    {
+      error = s;
+    }
+    catch(exception& e)
+    {
+      error = (string)"Evaluation failed: " + e.what();
+    }
+
+    lock.lock();
+    if (!error.empty()) { // every request of the batch gets the message, and the server goes on
+      for (unsigned r=0;r<batch.size();r++) {
+        batch[r]->error = error;
+        batch[r]->done = batch[r]->failed = true;
+      }
+      done_cv.notify_all();
+      continue;
+    }
+    const chrono::steady_clock::time_point now = chrono::steady_clock::now();
+    for (unsigned r=0;r<batch.size();r++) {
+      const double us = chrono::duration<double, micro>(now-batch[r]->arrived).count();
+      if (latency.size()<latencyWindow)
+        latency.push_back(us);
+      else
+        latency[latency_next] = us;
+      latency_next = (latency_next+1) % latencyWindow;
+      n_requests++;
+      batch[r]->done = true;
+    }
+    n_programs += n;
+    n_batches++;
+    done_cv.notify_all();
+  }
+}
+
+DaemonStats EvalServer::stats()
+{
+  DaemonStats s;
+  vector<double> lat;
+  {
+    lock_guard<mutex> lock(mtx);
+    s.n_requests = n_requests;
+    s.n_programs = n_programs;
+    s.n_batches = n_batches;
+    s.queue_requests = s.queue_programs = 0;
+    for (unsigned k=0;k<datasets.size();k++) {
+      s.queue_requests += datasets[k]->queue.size();
+      s.queue_programs += datasets[k]->queued_programs;
+    }
+    s.n_connections = 0;
+    for (unsigned i=0;i<connections.size();i++)
+      if (connections[i]->fd>=0)
+        s.n_connections++;
+    s.n_datasets = datasets.size();
+    lat = latency;
+  }
+
+  s.mean_batch = s.n_batches ? (double)s.n_programs/s.n_batches : 0;
+  s.latency_mean_us = s.latency_p50_us = s.latency_p99_us = s.latency_max_us = 0;
+  if (!lat.empty()) {
+    sort(lat.begin(), lat.end());
+    double sum = 0;
+    for (unsigned i=0;i<lat.size();i++)
+      sum += lat[i];
+    s.latency_mean_us = sum/lat.size();
+    s.latency_p50_us = lat[lat.size()/2];
+    s.latency_p99_us = lat[min((size_t)(lat.size()*0.99), lat.size()-1)];
+    s.latency_max_us = lat.back();
+  }
+  return s;
+}
+
+//
+//  Class: EvalClient
+//
+
+EvalClient::EvalClient(const string& socket_path)
+{
+  if (connectTo(socket_path, false, fd)<0) {
+    const string err = strerror(errno);
+    if (fd>=0)
+      close(fd);
+    throw (string)"Cannot connect to " + socket_path + ": " + err;
+  }
+}
+
+EvalClient::~EvalClient()
+{
+  close(fd);
+}
+
+// Reads the status of a response, throwing the server's message on error
+static void readStatus(int fd)
+{
+  uint32_t magic, status;
+  if ( !get(fd, magic) || !get(fd, status) || (magic!=daemonMagic) )
+    throw (string)"Connection to the evaluation server lost";
+  if (status!=0) {
+    uint32_t len;
+    if (!get(fd, len))
+      throw (string)"Connection to the evaluation server lost";
+    string msg(len, ' ');
+    if ( (len>0) && !readFull(fd, &msg[0], len) )
+      throw (string)"Connection to the evaluation server lost";
+    throw msg;
+  }
+}
+
+void EvalClient::evaluate(unsigned dataset,
+                          const vector<ByteCode>& programs,
+                          long randseed,
+                          int max_loop_depth,
+                          vector<EvalResult>& results)
+{
+  vector<char> buf;
+  put<uint32_t>(buf, daemonMagic);
+  put<uint32_t>(buf, DAEMON_EVALUATE);
+  put<uint32_t>(buf, dataset);
+  put<uint32_t>(buf, programs.size());
+  put<int64_t>(buf, randseed);
+  put<int32_t>(buf, max_loop_depth);
+  for (unsigned i=0;i<programs.size();i++) {
+    put<uint32_t>(buf, programs[i].size());
+    const char* p = (const char*)programs[i].data();
+    buf.insert(buf.end(), p, p+programs[i].size()*sizeof(ByteCode_Type));
+  }
+  if (!flush(fd, buf))
+    throw (string)"Connection to the evaluation server lost";
+
+  readStatus(fd);
+  uint32_t n;
+  if (!get(fd, n))
+    throw (string)"Connection to the evaluation server lost";
+  results.resize(n);
+  for (unsigned i=0;i<n;i++) {
+    EvalResult& r = results[i];
+    uint32_t n_cases, n_failed, cancelled;
+    uint64_t c[3];
+    if ( !get(fd, n_cases) || !readFull(fd, c, sizeof(c)) || !get(fd, n_failed) || !get(fd, cancelled) )
+      throw (string)"Connection to the evaluation server lost";
+    r.clear();
+    r.n_cases = n_cases;
+    r.n_ops = c[0];
+    r.n_invops = c[1];
+    r.n_inputs_bf_output = c[2];
+    r.n_failed = n_failed;
+    r.cancelled = (cancelled!=0);
+    r.outputs.resize(r.n_cases);
+    for (unsigned k=0;k<r.n_cases;k++) {
+      uint32_t n_out;
+      if (!get(fd, n_out))
+        throw (string)"Connection to the evaluation server lost";
+      r.outputs[k].resize(n_out);
+      if ( (n_out>0) && !readFull(fd, r.outputs[k].data(), n_out*sizeof(double)) )
+        throw (string)"Connection to the evaluation server lost";
+    }
+  }
+}
+
+DaemonStats EvalClient::stats()
+{
+  vector<char> buf;
+  put<uint32_t>(buf, daemonMagic);
+  put<uint32_t>(buf, DAEMON_STATS);
+  if (!flush(fd, buf))
+    throw (string)"Connection to the evaluation server lost";
+
+  readStatus(fd);
+  DaemonStats s;
+  bool ok = get(fd, s.n_requests) && get(fd, s.n_programs) && get(fd, s.n_batches) &&
+            get(fd, s.queue_requests) && get(fd, s.queue_programs) && get(fd, s.n_connections) &&
+            get(fd, s.n_datasets) && get(fd, s.mean_batch) && get(fd, s.latency_mean_us) &&
+            get(fd, s.latency_p50_us) && get(fd, s.latency_p99_us) && get(fd, s.latency_max_us);
+  if (!ok)
+    throw (string)"Connection to the evaluation server lost";
+  return s;
+}
+
+}; //namespace SlashA
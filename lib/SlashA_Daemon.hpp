@@ -0,0 +1,153 @@
+/*
+ *
+ *  SlashA_Daemon.hpp - resident evaluation server over a Unix domain socket, and its client
+ *
+ *  Copyright (C) 2004-2011 Artur B Adib
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef SLASHA_DAEMON_INCLUDED // duplicate protection
+#define SLASHA_DAEMON_INCLUDED
+
+#include <stdint.h>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <condition_variable>
+#include "SlashA.hpp"
+#include "SlashA_Pool.hpp"
+
+namespace SlashA
+{
+
+  /*
+   * An EvalServer keeps instruction sets and datasets (FitnessCases) resident, each dataset with its own
+   * EvalPool, and evaluates ByteCode sent over a Unix domain socket. Requests for the same dataset, random
+   * seed and loop depth are coalesced: a batch is sent to the pool once max_batch programs are waiting or
+   * the oldest request has waited max_wait_us. Every connection is served by its own thread and may send any
+   * number of requests, one at a time.
+   *
+   * Wire format, in host byte order (u32/i32/u64/i64/f64 are 4 or 8 bytes):
+   *   request:   u32 daemonMagic, u32 kind
+   *     DAEMON_EVALUATE: u32 dataset, u32 n_programs, i64 randseed, i32 max_loop_depth,
+   *                      then per program: u32 length, length x u32 opcode
+   *     DAEMON_STATS:    nothing more
+   *   response:  u32 daemonMagic, u32 status (0: ok, 1: error)
+   *     error:           u32 length, the message
+   *     DAEMON_EVALUATE: u32 n_programs, then per program: u32 n_cases, u64 n_ops, n_invops,
+   *                      n_inputs_bf_output, u32 n_failed, cancelled, then per case: u32 n_outputs, n_outputs x f64
+   *     DAEMON_STATS:    the fields of DaemonStats in order (u64 x 3, u32 x 4, f64 x 5)
+   * Each program's results are written as soon as they are serialized, so large responses stream.
+   */
+
+  const uint32_t daemonMagic = 0x444c4153; // "SLAD"
+  const uint32_t daemonMaxWords = 1<<26; // opcodes per request, as a guard against malformed requests
+  const uint32_t daemonMaxPrograms = 1<<20; // programs per request, likewise
+
+  enum DaemonRequestKind { DAEMON_EVALUATE = 1, DAEMON_STATS = 2 };
+
+  class DaemonStats
+  {
+    public:
+      uint64_t n_requests; // evaluation requests completed
+      uint64_t n_programs;
+      uint64_t n_batches;
+      uint32_t queue_requests; // waiting now, all datasets
+      uint32_t queue_programs;
+      uint32_t n_connections; // open now
+      uint32_t n_datasets;
+      double mean_batch; // programs per batch
+      double latency_mean_us; // from arrival to results, over the last latencyWindow requests
+      double latency_p50_us;
+      double latency_p99_us;
+      double latency_max_us;
+  };
+
+  const unsigned latencyWindow = 4096;
+
+  class EvalServer
+  {
+    private:
+      struct Request;
+      struct Dataset;
+      struct Connection;
+
+      ISetFactory make_iset;
+      unsigned D_size, L_size;
+      unsigned n_opcodes; // of the instruction sets, to reject opcodes out of range
+      unsigned max_batch;
+      unsigned max_wait_us;
+
+      std::string path;
+      int listen_fd;
+      std::vector<Dataset*> datasets;
+      std::vector<Connection*> connections;
+      std::thread acceptor;
+
+      std::mutex mtx; // queues, connections and stats
+      std::condition_variable done_cv;
+      bool running, shutting_down;
+
+      uint64_t n_requests, n_programs, n_batches;
+      std::vector<double> latency; // ring of the last latencyWindow requests, in microseconds
+      unsigned latency_next;
+
+      void acceptLoop();
+      void serve(Connection* conn);
+      void batchLoop(Dataset* ds);
+      bool handle(int fd, uint32_t kind); // a request of any kind; false: the connection is to be closed
+      bool evaluateRequest(int fd); // false: the connection is to be closed
+      void reapConnections(); // joins the threads of closed connections; mtx held
+
+    public:
+      EvalServer(ISetFactory _make_iset,
+                 unsigned _D_size,
+                 unsigned _L_size,
+                 unsigned _max_batch = 256,
+                 unsigned _max_wait_us = 500);
+      ~EvalServer();
+
+      // Before start(). The cases must outlive the server. Returns the dataset number used by requests.
+      unsigned addDataset(FitnessCases& cases, unsigned n_threads = 0, bool pin = true);
+
+      // Binds and returns; throws on failure. A socket file at the path is replaced only if no server answers
+      // on it, and any other file is left alone.
+      void start(const std::string& socket_path);
+      void stop(); // closes every connection; requests still queued fail
+      DaemonStats stats();
+  };
+
+  class EvalClient
+  {
+    private:
+      int fd;
+    public:
+      EvalClient(const std::string& socket_path); // throws if the server cannot be reached
+      ~EvalClient();
+
+      // Throws the server's message if the request is rejected, and on a lost connection
+      void evaluate(unsigned dataset,
+                    const std::vector<ByteCode>& programs,
+                    long randseed,
+                    int max_loop_depth,
+                    std::vector<EvalResult>& results);
+      DaemonStats stats();
+  };
+
+}; // namespace SlashA
+
+#endif // SLASHA_DAEMON_INCLUDED
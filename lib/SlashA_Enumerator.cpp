@@ -0,0 +1,557 @@
+/*
+ *
+ *  SlashA_Enumerator.cpp
+ *
+ *  Copyright (C) 2004-2011 Artur B Adib
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <chrono>
+#include <cstring>
+#include <thread>
+#include "SlashA_Enumerator.hpp"
+#include "SlashA_Partial.hpp"
+
+using namespace std;
+
+namespace SlashA
+{
+
+static const char* flow_control[] = { "label", "gotoifp", "jumpifn", "jumphere", "loop", "endloop" };
+
+static inline uint64_t fmix64(uint64_t h)
+{
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ULL;
+  h ^= h >> 33;
+  return h;
+}
+
+// Two independent 64-bit hashes of n_words words. Each is kept in four lanes that take every fourth word,
+// so the multiplications of consecutive words do not wait for each other.
+static void fingerprint(const unsigned char* p, size_t n_words, uint64_t& a, uint64_t& b)
+{
+  uint64_t ha[4] = { 0x243f6a8885a308d3ULL ^ n_words, 0x13198a2e03707344ULL, 0xa4093822299f31d0ULL, 0x082efa98ec4e6c89ULL };
+  uint64_t hb[4] = { 0x452821e638d01377ULL, 0xbe5466cf34e90c6cULL, 0xc0ac29b7c97c50ddULL, 0x3f84d5b5b5470917ULL };
+  size_t i = 0;
+  for (;i+4<=n_words;i+=4)
+    for (unsigned l=0;l<4;l++) {
+      uint64_t x;
+      memcpy(&x, p+8*(i+l), 8);
+      ha[l] = (ha[l] ^ x) * 0x9e3779b97f4a7c15ULL;
+      ha[l] ^= ha[l] >> 32;
+      hb[l] = (hb[l] + x) * 0xc2b2ae3d27d4eb4fULL;
+      hb[l] = (hb[l] << 29) | (hb[l] >> 35);
+    }
+  for (unsigned l=0;i<n_words;i++,l++) {
+    uint64_t x;
+    memcpy(&x, p+8*i, 8);
+    ha[l] = (ha[l] ^ x) * 0x9e3779b97f4a7c15ULL;
+    hb[l] = (hb[l] + x) * 0xc2b2ae3d27d4eb4fULL;
+  }
+  a = fmix64(ha[0] ^ fmix64(ha[1] ^ fmix64(ha[2] ^ fmix64(ha[3]))));
+  b = fmix64(hb[0] + fmix64(hb[1] + fmix64(hb[2] + fmix64(hb[3]))));
+}
+
+
+/*
+ *
+ * FingerprintSet: 128-bit fingerprints with the smallest length each was seen at, in open-addressing
+ * tables split into shards by the top bits, each behind its own mutex.
+ *
+ */
+
+class ProgramEnumerator::FingerprintSet
+{
+  private:
+    struct Slot
+    {
+      uint64_t a, b; // a==0: empty
+      uint32_t length;
+    };
+    struct Shard
+    {
+      mutex mtx;
+      vector<Slot> slots; // a power of 2
+      size_t n;
+    };
+    enum { n_shards = 64 };
+
+    Shard shards[n_shards];
+    size_t max_per_shard;
+
+    static void grow(Shard& s)
+    {
+      vector<Slot> old(s.slots.size()*2);
+      old.swap(s.slots);
+      const size_t mask = s.slots.size()-1;
+      for (size_t j=0;j<old.size();j++)
+        if (old[j].a) {
+          size_t i = old[j].a & mask;
+          while (s.slots[i].a)
+            i = (i+1) & mask;
+          s.slots[i] = old[j];
+        }
+    }
+
+  public:
+    FingerprintSet(size_t max_entries) : max_per_shard((max_entries+n_shards-1)/n_shards)
+    {
+      for (unsigned k=0;k<n_shards;k++) {
+        Slot empty = { 0, 0, 0 };
+        shards[k].slots.assign(256, empty);
+        shards[k].n = 0;
+      }
+    }
+
+    // True if (a,b) had not been seen at length or less; it is then recorded with that length
+    bool visit(uint64_t a, uint64_t b, unsigned length)
+    {
+      if (a==0)
+        a = 1;
+      Shard& s = shards[a>>58];
+      lock_guard<mutex> lock(s.mtx);
+
+      const size_t mask = s.slots.size()-1;
+      size_t i = a & mask;
+      while (s.slots[i].a) {
+        if ( (s.slots[i].a==a) && (s.slots[i].b==b) ) {
+          if (length>=s.slots[i].length)
+            return false;
+          s.slots[i].length = length;
+          return true;
+        }
+        i = (i+1) & mask;
+      }
+
+      if (s.n>=max_per_shard) // full: nothing is recorded any more
+        return true;
+      s.slots[i].a = a;
+      s.slots[i].b = b;
+      s.slots[i].length = length;
+      if (++s.n*10>s.slots.size()*7)
+        grow(s);
+      return true;
+    }
+
+    size_t size()
+    {
+      size_t n = 0;
+      for (unsigned k=0;k<n_shards;k++) {
+        lock_guard<mutex> lock(shards[k].mtx);
+        n += shards[k].n;
+      }
+      return n;
+    }
+};
+
+
+/*
+ *
+ * Worker: a private instruction set and core, the program being built, and the state of every case after
+ * each of its straight prefixes (level d holds the state after d instructions).
+ *
+ */
+
+struct ProgramEnumerator::Worker
+{
+  const ProgramEnumerator& e;
+  InstructionSet* iset;
+  MemCore core;
+  FitnessCases& cases;
+  vector<ByteCode_Type> prog;
+  vector<unsigned> letters; // alphabet index of each instruction of prog
+  size_t level_bytes;
+  vector<unsigned char> levels;
+  vector<double> out; // outputs of the current program, n_outputs per case
+  vector<unsigned> written;
+  vector<unsigned char> failed;
+  unsigned n_failed;
+  vector<uint64_t> key; // scratch for output fingerprints
+  uint64_t candidates, pruned, duplicates; // not yet added to the enumerator's counters
+
+  Worker(const ProgramEnumerator& _e, FitnessCases& _cases)
+    : e(_e), iset(_e.make_iset()), core(_e.D_size, _e.L_size, IOPolicy::span(NULL, 0, NULL, 0)), cases(_cases),
+      prog(_e.max_len), letters(_e.max_len), level_bytes(_cases.size()*_e.stride),
+      levels((_e.max_len+1)*level_bytes), out(_cases.size()*_e.n_outputs), written(_cases.size()),
+      failed(_cases.size()), n_failed(0), candidates(0), pruned(0), duplicates(0) {}
+  ~Worker() { delete iset; }
+
+  unsigned char* state(unsigned level, unsigned k) { return &levels[level*level_bytes + k*e.stride]; }
+
+  void select(unsigned k) // case k reads its inputs and writes the current outputs
+  {
+    core.io.in = cases[k].data();
+    core.io.in_size = cases[k].size();
+    core.io.out = &out[k*e.n_outputs];
+    core.io.out_size = e.n_outputs;
+  }
+
+  // Padding bytes are never written, so equal states are equal byte for byte
+  void save(unsigned char* p)
+  {
+    const double F = core.getF();
+    const unsigned u[3] = { core.I, core.in_pos, core.out_pos };
+    memcpy(p, &F, sizeof(F));
+    memcpy(p+e.off_D, core.D, e.D_size*sizeof(double));
+    memcpy(p+e.off_out, core.io.out, e.n_outputs*sizeof(double));
+    if (e.has_ran)
+      memcpy(p+e.off_ran, &core.ran, sizeof(core.ran));
+    memcpy(p+e.off_I, u, sizeof(u));
+    memcpy(p+e.off_L, core.L, e.L_size*sizeof(unsigned));
+    memcpy(p+e.off_Dsaved, core.D_saved, e.D_size*sizeof(bool));
+    memcpy(p+e.off_Lsaved, core.L_saved, e.L_size*sizeof(bool));
+    p[e.off_flag] = core.output_executed;
+  }
+
+  void restore(const unsigned char* p)
+  {
+    double F;
+    unsigned u[3];
+    memcpy(&F, p, sizeof(F));
+    core.setF(F);
+    memcpy(core.D, p+e.off_D, e.D_size*sizeof(double));
+    memcpy(core.io.out, p+e.off_out, e.n_outputs*sizeof(double));
+    if (e.has_ran)
+      memcpy(&core.ran, p+e.off_ran, sizeof(core.ran));
+    memcpy(u, p+e.off_I, sizeof(u));
+    core.I = u[0];
+    core.in_pos = u[1];
+    core.out_pos = u[2];
+    memcpy(core.L, p+e.off_L, e.L_size*sizeof(unsigned));
+    memcpy(core.D_saved, p+e.off_Dsaved, e.D_size*sizeof(bool));
+    memcpy(core.L_saved, p+e.off_Lsaved, e.L_size*sizeof(bool));
+    core.output_executed = p[e.off_flag];
+  }
+
+  void start(long randseed, int max_loop_depth) // level 0: every case from a reset core
+  {
+    iset->setMaxLoopDepth(max_loop_depth);
+    for (unsigned k=0;k<cases.size();k++) {
+      select(k);
+      core.reset();
+      core.ran = NumericalRecipes::Ran2State();
+      *core.ran_ptr = (randseed>0) ? -randseed : randseed;
+      for (unsigned i=0;i<e.n_outputs;i++)
+        core.io.out[i] = 0;
+      save(state(0, k));
+    }
+  }
+};
+
+
+/*
+ *
+ * Functions
+ *
+ */
+
+vector<ByteCode_Type> enumerationAlphabet(InstructionSet& iset, unsigned n_numeric, bool with_flow_control)
+{
+  if (n_numeric>iset.numericInstructions())
+    throw (string)"More numeric instructions asked for than the instruction set has";
+
+  vector<ByteCode_Type> alphabet;
+  for (unsigned i=0;i<n_numeric;i++)
+    alphabet.push_back(i);
+  for (unsigned i=iset.numericInstructions();i<iset.size();i++) {
+    bool flow = false;
+    for (unsigned j=0;j<sizeof(flow_control)/sizeof(flow_control[0]);j++)
+      if (iset.is(i, flow_control[j]))
+        flow = true;
+    if ( with_flow_control || (!flow) )
+      alphabet.push_back(i);
+  }
+  return alphabet;
+}
+
+
+/*
+ *
+ * ProgramEnumerator
+ *
+ */
+
+ProgramEnumerator::ProgramEnumerator(ISetFactory _make_iset,
+                                     const vector<ByteCode_Type>& _alphabet,
+                                     unsigned _D_size,
+                                     unsigned _L_size)
+  : make_iset(_make_iset), alphabet(_alphabet), has_ran(false), D_size(_D_size), L_size(_L_size), max_len(0),
+    n_outputs(4), max_steps(10000), max_states(1<<22), stop(false), n_candidates(0), n_pruned(0),
+    n_duplicates(0), n_found(0), state_set(NULL), output_set(NULL)
+{
+  if (alphabet.size()==0)
+    throw (string)"The alphabet of the enumeration is empty";
+
+  InstructionSet* iset = make_iset();
+  straight.resize(alphabet.size());
+  for (unsigned i=0;i<alphabet.size();i++) {
+    const ByteCode_Type op = alphabet[i];
+    if (op>=iset->size()) {
+      delete iset;
+      throw (string)"Opcode out of range of the instruction set";
+    }
+    straight[i] = isStateOnly(op, *iset);
+    if (iset->is(op, "ran"))
+      has_ran = true;
+  }
+  delete iset;
+}
+
+ProgramEnumerator::~ProgramEnumerator()
+{
+  delete state_set;
+  delete output_set;
+}
+
+void ProgramEnumerator::flush(Worker& w)
+{
+  n_candidates.fetch_add(w.candidates, memory_order_relaxed);
+  n_pruned.fetch_add(w.pruned, memory_order_relaxed);
+  n_duplicates.fetch_add(w.duplicates, memory_order_relaxed);
+  w.candidates = w.pruned = w.duplicates = 0;
+}
+
+// Runs instruction len of the program from level len, leaving level len+1
+void ProgramEnumerator::runStraight(Worker& w, unsigned len)
+{
+  const ByteCode_Type op = w.prog[len];
+  for (unsigned k=0;k<w.cases.size();k++) {
+    w.select(k);
+    w.restore(w.state(len, k));
+    w.iset->exec(op, w.core);
+    w.save(w.state(len+1, k));
+    w.written[k] = w.core.outputsWritten();
+    w.failed[k] = 0;
+  }
+  w.n_failed = 0;
+}
+
+// Runs the program of length len+1 from level base to its end. The tables are built over the whole program,
+// as for a run from the start: the straight prefix holds no flow control, so they come out the same.
+void ProgramEnumerator::runFromBase(Worker& w, unsigned len, unsigned base)
+{
+  w.core.setProgram(ProgramView(w.prog.data(), len+1));
+  w.n_failed = 0;
+  for (unsigned k=0;k<w.cases.size();k++) {
+    w.select(k);
+    w.restore(w.state(base, k));
+    w.core.c = base;
+    w.core.L_table_addr.clear();
+    w.core.L_table_count.clear();
+    w.core.J_table.clear();
+
+    unsigned long executed;
+    w.failed[k] = (resumeProgram(*w.iset, w.core, max_steps, executed)!=RUN_FINISHED);
+    w.n_failed += w.failed[k];
+    w.written[k] = w.core.outputsWritten();
+  }
+}
+
+// Calls back if the outputs of the program of length len+1 are new
+void ProgramEnumerator::report(Worker& w, unsigned len)
+{
+  w.key.clear();
+  for (unsigned k=0;k<w.cases.size();k++) {
+    w.key.push_back(w.written[k] | ((uint64_t)w.failed[k]<<32));
+    for (unsigned i=0;i<w.written[k];i++) {
+      uint64_t x;
+      memcpy(&x, &w.out[k*n_outputs+i], 8);
+      w.key.push_back(x);
+    }
+  }
+  uint64_t a, b;
+  fingerprint((const unsigned char*)w.key.data(), w.key.size(), a, b);
+  if (!output_set->visit(a, b, 0)) {
+    w.duplicates++;
+    return;
+  }
+
+  EnumCandidate c;
+  c.program = ProgramView(w.prog.data(), len+1);
+  c.outputs = w.out.data();
+  c.n_written = w.written.data();
+  c.n_outputs = n_outputs;
+  c.n_cases = w.cases.size();
+  c.n_failed = w.n_failed;
+
+  lock_guard<mutex> lock(found_mtx);
+  if (stop.load(memory_order_relaxed))
+    return;
+  n_found++;
+  if (found_callback(c))
+    stop.store(true);
+}
+
+// Tries every letter at position len. Level base holds the state after the longest straight prefix
+// (base==len if the whole program so far is straight). Programs of length limit are not extended; if
+// tasks is given they are appended to it instead, as alphabet indices.
+void ProgramEnumerator::extend(Worker& w, unsigned len, unsigned base, unsigned limit, vector<unsigned>* tasks)
+{
+  for (unsigned i=0;i<alphabet.size();i++) {
+    if (stop.load(memory_order_relaxed))
+      return;
+
+    w.prog[len] = alphabet[i];
+    w.letters[len] = i;
+    if ((++w.candidates & 1023)==0)
+      flush(w);
+
+    unsigned next_base = base;
+    if ( (base==len) && straight[i] ) {
+      runStraight(w, len);
+      next_base = len+1;
+      // The empty program's state is left out: a loop at position 0 cannot be matched by its endloop, so a
+      // prefix that changes nothing still differs from no prefix at all. Any two prefixes after it compare.
+      uint64_t a, b;
+      fingerprint(w.state(len+1, 0), w.level_bytes/8, a, b);
+      if (!state_set->visit(a, b, len+1)) {
+        w.pruned++;
+        continue; // same state, hence same outputs, as a program already seen
+      }
+    }
+    else
+      runFromBase(w, len, base);
+
+    report(w, len);
+
+    if (len+1<limit)
+      extend(w, len+1, next_base, limit, tasks);
+    else if ( tasks && (len+1<max_len) )
+      tasks->insert(tasks->end(), w.letters.begin(), w.letters.begin()+len+1);
+  }
+}
+
+// Rebuilds the levels of a prefix found by extend() and enumerates everything below it
+void ProgramEnumerator::replay(Worker& w, const unsigned* prefix, unsigned len)
+{
+  unsigned base = 0;
+  for (unsigned j=0;j<len;j++) {
+    w.prog[j] = alphabet[prefix[j]];
+    w.letters[j] = prefix[j];
+    if ( (base==j) && straight[prefix[j]] ) {
+      runStraight(w, j);
+      base = j+1;
+    }
+  }
+  extend(w, len, base, max_len, NULL);
+}
+
+EnumStats ProgramEnumerator::enumerate(unsigned max_length,
+                                       FitnessCases& cases,
+                                       EnumCallback found,
+                                       unsigned n_threads,
+                                       long randseed,
+                                       int max_loop_depth)
+{
+  if (max_length==0)
+    return EnumStats();
+  if (n_outputs==0)
+    throw (string)"The enumeration keeps no outputs";
+  if (n_threads==0)
+    n_threads = max(1u, thread::hardware_concurrency());
+
+  const chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+
+  // layout of the state of one case
+  off_D = sizeof(double);
+  off_out = off_D + D_size*sizeof(double);
+  off_ran = off_out + n_outputs*sizeof(double);
+  off_I = off_ran + (has_ran ? sizeof(NumericalRecipes::Ran2State) : 0);
+  off_L = off_I + 3*sizeof(unsigned);
+  off_Dsaved = off_L + L_size*sizeof(unsigned);
+  off_Lsaved = off_Dsaved + D_size*sizeof(bool);
+  off_flag = off_Lsaved + L_size*sizeof(bool);
+  stride = (off_flag+1+7)/8*8;
+
+  max_len = max_length;
+  found_callback = found;
+  stop.store(false);
+  n_candidates = n_pruned = n_duplicates = n_found = 0;
+  delete state_set;
+  delete output_set;
+  state_set = new FingerprintSet(max_states);
+  output_set = new FingerprintSet(max_states);
+
+  vector<Worker*> workers;
+  for (unsigned t=0;t<n_threads;t++) {
+    workers.push_back(new Worker(*this, cases));
+    workers[t]->start(randseed, max_loop_depth);
+  }
+
+  // The behavior of the empty program is not reported
+  Worker& w0 = *workers[0];
+  for (unsigned k=0;k<cases.size();k++) {
+    w0.written[k] = 0;
+    w0.failed[k] = 0;
+  }
+  w0.key.assign(cases.size(), 0);
+  uint64_t a, b;
+  fingerprint((const unsigned char*)w0.key.data(), w0.key.size(), a, b);
+  output_set->visit(a, b, 0);
+
+  // The first levels on this thread, until there are enough subtrees to share out
+  unsigned split = 1;
+  double n_prefixes = alphabet.size();
+  while ( (split<max_length) && (n_prefixes<32.0*n_threads) ) {
+    split++;
+    n_prefixes *= alphabet.size();
+  }
+  vector<unsigned> tasks;
+  extend(w0, 0, 0, split, &tasks);
+  flush(w0);
+
+  const size_t n_tasks = tasks.size()/split;
+  atomic<size_t> next(0);
+  auto work = [&](Worker* w) {
+    size_t t;
+    while ( (!stop.load(memory_order_relaxed)) && ((t = next++)<n_tasks) )
+      replay(*w, &tasks[t*split], split);
+    flush(*w);
+  };
+
+  if (n_tasks>0) {
+    vector<thread> threads;
+    for (unsigned t=1;t<n_threads;t++)
+      threads.push_back(thread(work, workers[t]));
+    work(workers[0]);
+    for (unsigned t=0;t<threads.size();t++)
+      threads[t].join();
+  }
+
+  EnumStats s = progress();
+  s.states = state_set->size() + output_set->size();
+  s.seconds = chrono::duration<double>(chrono::steady_clock::now()-t0).count();
+
+  for (unsigned t=0;t<workers.size();t++)
+    delete workers[t];
+  found_callback = nullptr;
+  return s;
+}
+
+EnumStats ProgramEnumerator::progress() const
+{
+  EnumStats s;
+  s.candidates = n_candidates.load(memory_order_relaxed);
+  s.pruned = n_pruned.load(memory_order_relaxed);
+  s.duplicates = n_duplicates.load(memory_order_relaxed);
+  s.found = n_found.load(memory_order_relaxed);
+  return s;
+}
+
+}; //namespace SlashA
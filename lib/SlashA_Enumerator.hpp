@@ -0,0 +1,145 @@
+/*
+ *
+ *  SlashA_Enumerator.hpp - exhaustive enumeration of short programs with equivalence pruning
+ *
+ *  Copyright (C) 2004-2011 Artur B Adib
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef SLASHA_ENUMERATOR_INCLUDED // duplicate protection
+#define SLASHA_ENUMERATOR_INCLUDED
+
+#include <stdint.h>
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include "SlashA.hpp"
+
+namespace SlashA
+{
+
+  /*
+   * Enumerates every program of length 1..max_length over an alphabet of opcodes, depth-first, and runs
+   * each one over the fitness cases.
+   *
+   * Instructions that only act on the registers, tapes and I/O (the numeric instructions, the DIS data
+   * instructions, input and ran) are run one at a time: the machine state after a prefix is kept for every
+   * fitness case, so each extension of it costs one instruction per case. Once a program holds any other
+   * instruction (flow control, user-defined), its candidates are run from the state after the last such
+   * prefix to the end, with the interpreter's own loop and jump tables and a step budget per case.
+   *
+   * Two kinds of redundancy are removed:
+   * - prefixes that leave the same state on every case as a prefix already seen at the same or a smaller
+   *   length are not extended (their subtree has been or is being explored);
+   * - a program whose outputs on every case equal those of a program already found, bit for bit, and that
+   *   fails on the same cases, is not reported.
+   * Both use 128-bit fingerprints, so a collision (probability about n^2/2^128 for n fingerprints) would
+   * hide a program. Programs that behave like the empty one (no outputs, no failures) are never reported.
+   */
+
+  class EnumCandidate // a program passed to the callback; valid during the call only
+  {
+    public:
+      ProgramView program;
+      const double* outputs; // case k wrote n_written[k] values, from outputs[k*n_outputs] on
+      const unsigned* n_written; // at most n_outputs
+      unsigned n_outputs;
+      unsigned n_cases;
+      unsigned n_failed; // cases stopped by the loop depth limit or the step budget
+  };
+
+  typedef std::function<bool(const EnumCandidate& c)> EnumCallback; // true stops the enumeration
+
+  class EnumStats
+  {
+    public:
+      uint64_t candidates; // programs run over the fitness cases
+      uint64_t pruned; // prefixes not extended because their state had been seen
+      uint64_t duplicates; // programs not reported because their outputs had been seen
+      uint64_t found; // programs reported
+      uint64_t states; // fingerprints held
+      double seconds;
+
+      EnumStats() : candidates(0), pruned(0), duplicates(0), found(0), states(0), seconds(0) {}
+      double candidatesPerSecond() const { return (seconds>0) ? candidates/seconds : 0; }
+  };
+
+  // Numeric instructions 0..n_numeric-1 and every other instruction of iset, without the flow control
+  // instructions (label, gotoifp, jumpifn, jumphere, loop, endloop) unless asked for
+  std::vector<ByteCode_Type> enumerationAlphabet(InstructionSet& iset, unsigned n_numeric, bool flow_control = false);
+
+  class ProgramEnumerator
+  {
+    private:
+      struct Worker;
+      class FingerprintSet;
+
+      ISetFactory make_iset;
+      std::vector<ByteCode_Type> alphabet;
+      std::vector<unsigned char> straight; // per letter: run one at a time from the prefix state
+      bool has_ran;
+      unsigned D_size, L_size;
+      unsigned max_len; // of the current enumeration
+      unsigned n_outputs;
+      unsigned long max_steps;
+      size_t max_states;
+
+      // layout of the state of one case, see Worker::save()
+      size_t off_D, off_out, off_ran, off_I, off_L, off_Dsaved, off_Lsaved, off_flag, stride;
+
+      std::atomic<bool> stop;
+      std::atomic<uint64_t> n_candidates, n_pruned, n_duplicates, n_found;
+      FingerprintSet* state_set;
+      FingerprintSet* output_set;
+      EnumCallback found_callback;
+      std::mutex found_mtx; // the callback is called by one thread at a time
+
+      void extend(Worker& w, unsigned len, unsigned base, unsigned limit, std::vector<unsigned>* tasks);
+      void runStraight(Worker& w, unsigned len);
+      void runFromBase(Worker& w, unsigned len, unsigned base);
+      void report(Worker& w, unsigned len);
+      void replay(Worker& w, const unsigned* prefix, unsigned len);
+      void flush(Worker& w);
+
+    public:
+      ProgramEnumerator(ISetFactory _make_iset,
+                        const std::vector<ByteCode_Type>& _alphabet,
+                        unsigned _D_size,
+                        unsigned _L_size);
+      ~ProgramEnumerator();
+
+      void setMaxOutputs(unsigned n) { n_outputs = n; } // kept per case (default 4); later ones are dropped
+      void setMaxSteps(unsigned long n) { max_steps = n; } // per case, for programs with flow control (default 10000)
+      // Fingerprints kept for pruning and for duplicates, each (default 1<<22, about 35 bytes apiece). Past
+      // that, new states are always extended and new outputs always reported; 0 turns both kinds of pruning off.
+      void setMaxStates(size_t n) { max_states = n; }
+
+      // Blocks until done, cancelled or stopped by the callback. The first levels are enumerated on the
+      // calling thread and the subtrees below them are shared out to n_threads threads (0: one per core).
+      EnumStats enumerate(unsigned max_length,
+                          FitnessCases& cases,
+                          EnumCallback found,
+                          unsigned n_threads = 0,
+                          long randseed = 1,
+                          int max_loop_depth = -1);
+
+      void cancel() { stop.store(true); } // from any thread; enumerate() returns soon after
+      EnumStats progress() const; // while enumerate() runs, from any thread (states and seconds are 0)
+  };
+
+}; // namespace SlashA
+
+#endif // SLASHA_ENUMERATOR_INCLUDED
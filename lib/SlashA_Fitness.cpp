@@ -0,0 +1,296 @@
+/*
+ *
+ *  SlashA_Fitness.cpp
+ *
+ *  Copyright (C) 2004-2011 Artur B Adib
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <cmath>
+#include <algorithm>
+#include "SlashA_Fitness.hpp"
+#include "SlashA_Kernels.hpp"
+#include "SlashA_Metrics.hpp"
+
+using namespace std;
+
+namespace SlashA
+{
+
+// Ranks starting at 1, tied values sharing the mean of their ranks
+static void rankValues(const vector<double>& v, vector<double>& r)
+{
+  const unsigned n = v.size();
+  vector<unsigned> idx(n);
+  for (unsigned i=0;i<n;i++)
+    idx[i] = i;
+  sort(idx.begin(), idx.end(), [&v](unsigned a, unsigned b) { return v[a]<v[b]; });
+
+  r.resize(n);
+  for (unsigned i=0;i<n;) {
+    unsigned j = i+1;
+    while ( (j<n) && (v[idx[j]]==v[idx[i]]) )
+      j++;
+    const double mean_rank = 0.5*(i+1 + j); // ranks i+1..j
+    for (unsigned k=i;k<j;k++)
+      r[idx[k]] = mean_rank;
+    i = j;
+  }
+}
+
+// Pearson's r from the centered moments; 0 if either side is constant
+static double pearson(double sxx, double syy, double sxy)
+{
+  if ( (sxx<=0) || (syy<=0) )
+    return 0;
+  const double r = sxy/sqrt(sxx*syy);
+  return max(-1.0, min(1.0, r));
+}
+
+
+/*
+ *
+ * Class methods
+ *
+ */
+
+//
+//  Class: FitnessAccumulator
+//
+
+void FitnessAccumulator::clear()
+{
+  n_cases = n_expected = n_values = n_hits = 0;
+  sum = 0;
+  mean_o = mean_t = m2_o = m2_t = c_ot = 0;
+  rank_o.clear();
+  rank_t.clear();
+  n_invops = n_inputs_bf_output = n_failed = 0;
+}
+
+void FitnessAccumulator::addCase(const double* outputs, unsigned n_written, const double* targets, unsigned n_targets)
+{
+  n_cases++;
+  n_expected += n_targets;
+  addValues(outputs, targets, min(n_written, n_targets));
+}
+
+void FitnessAccumulator::addCases(const double* outputs, const double* targets, unsigned n_per_case, unsigned _n_cases)
+{
+  n_cases += _n_cases;
+  n_expected += n_per_case*_n_cases;
+  addValues(outputs, targets, n_per_case*_n_cases);
+}
+
+void FitnessAccumulator::addValues(const double* outputs, const double* targets, unsigned n)
+{
+  if (n==0)
+    return;
+
+  switch (spec.metric) {
+    case FIT_MSE:
+      sum += Kernels::sqdist(outputs, targets, n);
+      break;
+    case FIT_MAE:
+      sum += Kernels::absdist(outputs, targets, n);
+      break;
+    case FIT_HITS:
+      n_hits += Kernels::hits(outputs, targets, n, spec.hit_tolerance);
+      break;
+    case FIT_CORRELATION: { // moments of the block, merged into the running ones
+      const double mo = Kernels::sum(outputs, n)/n, mt = Kernels::sum(targets, n)/n;
+      double soo, stt, sot;
+      Kernels::comoments(outputs, mo, targets, mt, n, soo, stt, sot);
+      const double na = n_values, nb = n, nt = na+nb;
+      const double d_o = mo-mean_o, d_t = mt-mean_t;
+      mean_o += d_o*nb/nt;
+      mean_t += d_t*nb/nt;
+      m2_o += soo + d_o*d_o*na*nb/nt;
+      m2_t += stt + d_t*d_t*na*nb/nt;
+      c_ot += sot + d_o*d_t*na*nb/nt;
+      break;
+    }
+    case FIT_RANK:
+      rank_o.insert(rank_o.end(), outputs, outputs+n);
+      rank_t.insert(rank_t.end(), targets, targets+n);
+      break;
+  }
+  n_values += n;
+}
+
+void FitnessAccumulator::addRun(unsigned _n_invops, unsigned _n_inputs_bf_output, bool failed)
+{
+  n_invops += _n_invops;
+  n_inputs_bf_output += _n_inputs_bf_output;
+  n_failed += failed ? 1 : 0;
+}
+
+void FitnessAccumulator::addCounts(const EvalResult& res)
+{
+  n_invops += res.n_invops;
+  n_inputs_bf_output += res.n_inputs_bf_output;
+  n_failed += res.n_failed;
+}
+
+FitnessScore FitnessAccumulator::score() const
+{
+  double metric = 0; // over the values produced
+  if (n_values>0)
+    switch (spec.metric) {
+      case FIT_MSE:
+      case FIT_MAE:
+        metric = sum/n_values;
+        break;
+      case FIT_HITS:
+        metric = (double)(n_values-n_hits)/n_values;
+        break;
+      case FIT_CORRELATION: {
+        const double r = pearson(m2_o, m2_t, c_ot);
+        metric = 1 - r*r;
+        break;
+      }
+      case FIT_RANK: {
+        vector<double> ro, rt;
+        rankValues(rank_o, ro);
+        rankValues(rank_t, rt);
+        const double m = 0.5*(n_values+1); // mean rank, the same on both sides
+        double soo, stt, sot;
+        Kernels::comoments(ro.data(), m, rt.data(), m, n_values, soo, stt, sot);
+        metric = 0.5*(1 - pearson(soo, stt, sot));
+        break;
+      }
+    }
+
+  FitnessScore s;
+  s.n_cases = n_cases;
+  s.n_expected = n_expected;
+  s.n_values = n_values;
+  s.n_missing = n_expected-n_values;
+  s.n_hits = n_hits;
+  s.error = n_expected ? (n_values*metric + spec.missing*s.n_missing)/n_expected : 0;
+  s.penalty = n_cases ? (spec.invop_penalty*n_invops + spec.input_penalty*n_inputs_bf_output +
+                         spec.failed_penalty*n_failed)/n_cases : 0;
+  s.fitness = s.error + s.penalty;
+  return s;
+}
+
+
+/*
+ *
+ * Functions
+ *
+ */
+
+FitnessScore scoreOutputs(const FitnessSpec& spec,
+                          const CaseSpans& cases,
+                          const double* targets,
+                          const EvalResult* counts)
+{
+  FitnessAccumulator acc(spec);
+  const unsigned n = cases.n_outputs;
+
+  bool complete = true;
+  if (cases.n_written)
+    for (unsigned k=0;k<cases.n_cases;k++)
+      complete &= (cases.n_written[k]>=n);
+
+  if (complete) // the whole buffer in one pass of each kernel
+    acc.addCases(cases.outputs, targets, n, cases.n_cases);
+  else
+    for (unsigned k=0;k<cases.n_cases;k++)
+      acc.addCase(cases.outputs + (size_t)k*n, cases.n_written ? cases.n_written[k] : n, targets + (size_t)k*n, n);
+  if (counts)
+    acc.addCounts(*counts);
+  return acc.score();
+}
+
+FitnessScore scoreOutputs(const FitnessSpec& spec,
+                          const EvalResult& res,
+                          const FitnessCases& targets)
+{
+  FitnessAccumulator acc(spec);
+  for (unsigned k=0;k<targets.size();k++) { // cases that did not run produced nothing
+    const unsigned n_written = (k<res.outputs.size()) ? res.outputs[k].size() : 0;
+    acc.addCase(n_written ? res.outputs[k].data() : NULL, n_written, targets[k].data(), targets[k].size());
+  }
+  acc.addCounts(res);
+  return acc.score();
+}
+
+bool scoreFitnessCases(InstructionSet& iset,
+                       MemCore& core,
+                       ByteCode& bc,
+                       const double* inputs,
+                       unsigned n_inputs,
+                       const double* targets,
+                       unsigned n_outputs,
+                       unsigned n_cases,
+                       long randseed,
+                       const atomic<bool>& stop,
+                       int max_loop_depth,
+                       FitnessAccumulator& acc)
+{
+  const IOPolicy io = core.io; // restored on exit
+  const uint64_t t0 = metricsEnabled() ? metricsClock() : 0;
+  unsigned long long n_ops = 0, n_invops = 0;
+  unsigned n_run = 0, loop_aborts = 0;
+  bool any_failed = false;
+
+  vector<double> scratch((size_t)scoreBlock*n_outputs + 1);
+  unsigned pending = 0; // complete cases at the start of scratch, not scored yet
+  core.io.mode = IO_SPAN;
+  core.io.in_size = n_inputs;
+  core.io.out_size = n_outputs;
+
+  for (unsigned k=0;k<n_cases;k++) {
+    if (stop.load(memory_order_relaxed))
+      break;
+
+    core.reset();
+    core.io.in = inputs + (size_t)k*n_inputs;
+    core.io.out = scratch.data() + (size_t)pending*n_outputs;
+
+    const bool failed = runByteCodeUntil(iset, core, bc, randseed, stop, max_loop_depth);
+    if (failed && !stop.load(memory_order_relaxed))
+      loop_aborts++;
+    any_failed |= failed;
+
+    const unsigned n_written = core.outputsWritten();
+    if (n_written>=n_outputs)
+      pending++;
+    if ( (pending==scoreBlock) || (n_written<n_outputs) ) { // the complete cases before k, k included if complete
+      const unsigned first = (n_written<n_outputs) ? k-pending : k+1-pending;
+      acc.addCases(scratch.data(), targets + (size_t)first*n_outputs, n_outputs, pending);
+      if (n_written<n_outputs)
+        acc.addCase(core.io.out, n_written, targets + (size_t)k*n_outputs, n_outputs);
+      pending = 0;
+    }
+    acc.addRun(iset.getTotalInvops(), iset.getTotalInputsBFOutput(), failed);
+    n_ops += iset.getTotalOps();
+    n_invops += iset.getTotalInvops();
+    n_run++;
+  }
+  acc.addCases(scratch.data(), targets + (size_t)(n_run-pending)*n_outputs, n_outputs, pending);
+
+  core.io = io;
+
+  if (metricsEnabled())
+    recordEvaluation(t0, n_run, n_ops, n_invops, 0, loop_aborts);
+
+  return any_failed;
+}
+
+}; //namespace SlashA
@@ -0,0 +1,135 @@
+/*
+ *
+ *  SlashA_Fitness.hpp - error metrics over output buffers, with penalties
+ *
+ *  Copyright (C) 2004-2011 Artur B Adib
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef SLASHA_FITNESS_INCLUDED // duplicate protection
+#define SLASHA_FITNESS_INCLUDED
+
+#include "SlashA.hpp"
+
+namespace SlashA
+{
+
+  /*
+   * Every metric is an error (lower is better), computed over the outputs the program produced:
+   * - FIT_MSE, FIT_MAE: mean squared / absolute difference to the target;
+   * - FIT_HITS: fraction of outputs further than hit_tolerance from their target;
+   * - FIT_CORRELATION: 1 - r^2 (Pearson), so any linear relation scores, as with linear scaling;
+   * - FIT_RANK: (1 - rho)/2 (Spearman, ties averaged), so only the ordering matters.
+   * An expected output that was not produced counts as an error of "missing" instead, in the units of the
+   * metric: the error is (n_values*metric + missing*n_missing)/n_expected. With the default of 1 a missing
+   * output is a miss for FIT_HITS and the worst possible value for FIT_CORRELATION and FIT_RANK.
+   * Outputs beyond the expected ones are ignored. The penalties are averaged over the fitness cases and
+   * added on top: fitness = error + (invop_penalty*n_invops + input_penalty*n_inputs_bf_output +
+   * failed_penalty*n_failed)/n_cases.
+   */
+
+  enum FitnessMetric { FIT_MSE, FIT_MAE, FIT_HITS, FIT_CORRELATION, FIT_RANK };
+
+  class FitnessSpec
+  {
+    public:
+      FitnessMetric metric;
+      double hit_tolerance; // FIT_HITS
+      double missing; // error of an expected output that was not produced
+      double invop_penalty; // per invalid operation
+      double input_penalty; // per input read before the first output
+      double failed_penalty; // per failed fitness case
+
+      FitnessSpec(FitnessMetric m = FIT_MSE)
+        : metric(m), hit_tolerance(0), missing(1), invop_penalty(0), input_penalty(0), failed_penalty(0) {}
+  };
+
+  class FitnessScore
+  {
+    public:
+      double fitness; // error + penalty
+      double error;
+      double penalty;
+      unsigned n_cases;
+      unsigned n_expected; // outputs expected by the targets
+      unsigned n_values; // of which produced
+      unsigned n_missing;
+      unsigned n_hits; // FIT_HITS
+  };
+
+  // Adds up fitness cases one at a time, so the outputs of a case can be dropped as soon as it is scored.
+  // Only FIT_RANK keeps the values, since ranks need all of them.
+  class FitnessAccumulator
+  {
+    private:
+      FitnessSpec spec;
+      unsigned n_cases, n_expected, n_values, n_hits;
+      double sum; // FIT_MSE: squared errors, FIT_MAE: absolute errors
+      double mean_o, mean_t, m2_o, m2_t, c_ot; // FIT_CORRELATION: running co-moments (Chan et al.)
+      std::vector<double> rank_o, rank_t; // FIT_RANK
+      unsigned long long n_invops, n_inputs_bf_output, n_failed;
+
+      void addValues(const double* outputs, const double* targets, unsigned n); // n values produced
+    public:
+      FitnessAccumulator(const FitnessSpec& _spec) : spec(_spec) { clear(); }
+
+      void clear();
+      // The first min(n_written, n_targets) outputs are compared, the remaining targets are missing
+      void addCase(const double* outputs, unsigned n_written, const double* targets, unsigned n_targets);
+      // n_cases cases laid out one after the other, each of which produced all its n_per_case outputs
+      void addCases(const double* outputs, const double* targets, unsigned n_per_case, unsigned n_cases);
+      void addRun(unsigned n_invops, unsigned n_inputs_bf_output, bool failed); // counters of one case
+      void addCounts(const EvalResult& res); // counters of a whole evaluation
+      FitnessScore score() const;
+  };
+
+  /* Functions */
+
+  // Scores the flat output buffer of runFitnessCases(..., CaseSpans, ...) against targets laid out the
+  // same way (n_outputs per case). cases.n_written may be NULL if every case wrote all its outputs.
+  // counts (may be NULL) supplies the counters for the penalties.
+  FitnessScore scoreOutputs(const FitnessSpec& spec,
+                            const CaseSpans& cases,
+                            const double* targets,
+                            const EvalResult* counts);
+
+  // Same, for the outputs of an EvalResult and one target vector per case
+  FitnessScore scoreOutputs(const FitnessSpec& spec,
+                            const EvalResult& res,
+                            const FitnessCases& targets);
+
+  const unsigned scoreBlock = 256; // fitness cases per scratch buffer of scoreFitnessCases()
+
+  // Runs the cases and scores them a block at a time: outputs go to a scratch buffer of scoreBlock cases,
+  // so memory does not grow with the number of cases, and each full block goes through the kernels in one
+  // pass. A case that writes fewer than n_outputs values is scored on its own. Same runs as
+  // runFitnessCases() over CaseSpans. Returns true if any of the cases failed.
+  bool scoreFitnessCases(InstructionSet& iset,
+                         MemCore& core,
+                         ByteCode& bc,
+                         const double* inputs, // n_inputs per case
+                         unsigned n_inputs,
+                         const double* targets, // n_outputs per case
+                         unsigned n_outputs,
+                         unsigned n_cases,
+                         long randseed,
+                         const std::atomic<bool>& stop,
+                         int max_loop_depth,
+                         FitnessAccumulator& acc);
+
+}; // namespace SlashA
+
+#endif // SLASHA_FITNESS_INCLUDED
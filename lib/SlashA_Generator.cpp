@@ -0,0 +1,295 @@
+/*
+ *
+ *  SlashA_Generator.cpp
+ *
+ *  Copyright (C) 2004-2011 Artur B Adib
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <string>
+#include <algorithm>
+#include "SlashA_Generator.hpp"
+
+using namespace std;
+
+namespace SlashA
+{
+
+static inline uint64_t rotl(uint64_t x, int k)
+{
+  return (x<<k) | (x>>(64-k));
+}
+
+static uint64_t splitmix64(uint64_t& x)
+{
+  uint64_t z = (x += 0x9e3779b97f4a7c15ULL);
+  z = (z^(z>>30))*0xbf58476d1ce4e5b9ULL;
+  z = (z^(z>>27))*0x94d049bb133111ebULL;
+  return z^(z>>31);
+}
+
+
+/*
+ *
+ * Class methods
+ *
+ */
+
+//
+//  Class: FastRandom
+//
+
+void FastRandom::setSeed(uint64_t seed)
+{
+  for (unsigned lane=0;lane<4;lane++)
+    for (unsigned k=0;k<4;k++)
+      s[k][lane] = splitmix64(seed);
+  pos = 256;
+}
+
+void FastRandom::fill(uint64_t* out, size_t n)
+{
+  size_t i = 0;
+  for (;i+4<=n;i+=4)
+    for (unsigned lane=0;lane<4;lane++) { // xoshiro256** step of each stream
+      out[i+lane] = rotl(s[1][lane]*5, 7)*9;
+      const uint64_t t = s[1][lane]<<17;
+      s[2][lane] ^= s[0][lane];
+      s[3][lane] ^= s[1][lane];
+      s[1][lane] ^= s[2][lane];
+      s[0][lane] ^= s[3][lane];
+      s[2][lane] ^= t;
+      s[3][lane] = rotl(s[3][lane], 45);
+    }
+
+  if (i<n) { // the tail, through the buffer so no word is lost
+    uint64_t tail[4];
+    fill(tail, 4);
+    for (unsigned lane=0;i<n;lane++)
+      out[i++] = tail[lane];
+  }
+}
+
+void FastRandom::refill()
+{
+  fill(buf, 256);
+  pos = 0;
+}
+
+//
+//  Class: AliasTable
+//
+
+void AliasTable::build(const vector<double>& weights)
+{
+  const unsigned n = weights.size();
+  double total = 0;
+  for (unsigned i=0;i<n;i++)
+    if (weights[i]>0)
+      total += weights[i];
+  if (total<=0)
+    throw (string)"AliasTable: no positive weight";
+
+  vector<double> p(n);
+  vector<unsigned> small, large;
+  for (unsigned i=0;i<n;i++) {
+    p[i] = (weights[i]>0) ? weights[i]*n/total : 0;
+    if (p[i]<1)
+      small.push_back(i);
+    else
+      large.push_back(i);
+  }
+
+  threshold.assign(n, 0);
+  alias.resize(n);
+  for (unsigned i=0;i<n;i++)
+    alias[i] = i;
+
+  while ( !small.empty() && !large.empty() ) {
+    const unsigned s = small.back(), l = large.back();
+    small.pop_back();
+    threshold[s] = (uint32_t)min(p[s]*4294967296.0, 4294967295.0);
+    alias[s] = l;
+    p[l] -= 1-p[s];
+    if (p[l]<1) {
+      large.pop_back();
+      small.push_back(l);
+    }
+  }
+  // What remains has probability one up to rounding: always keep the column
+  for (unsigned i=0;i<large.size();i++)
+    threshold[large[i]] = 0xffffffffu;
+  for (unsigned i=0;i<small.size();i++)
+    threshold[small[i]] = (weights[small[i]]>0) ? 0xffffffffu : 0;
+}
+
+//
+//  Class: ProgramGenerator
+//
+
+ProgramGenerator::ProgramGenerator(InstructionSet& iset,
+                                   const vector<double>& weights,
+                                   uint64_t seed,
+                                   bool _structured,
+                                   int _max_loop_depth)
+  : rng(seed)
+{
+  const unsigned n = iset.size();
+  if (weights.size()!=n)
+    throw (string)"ProgramGenerator: one weight per opcode is needed";
+
+  table.build(weights);
+  structured = _structured;
+  max_loop_depth = (_max_loop_depth==-2) ? iset.getMaxLoopDepth() : _max_loop_depth;
+
+  kind.assign(n, OP_PLAIN);
+  op_endloop = op_jumphere = 0;
+  double plain = 0;
+  for (unsigned k=0;k<n;k++) {
+    if (iset.is(k, "loop"))
+      kind[k] = OP_LOOP;
+    else if (iset.is(k, "endloop")) {
+      kind[k] = OP_ENDLOOP;
+      op_endloop = k;
+    }
+    else if (iset.is(k, "jumpifn"))
+      kind[k] = OP_JUMPIFN;
+    else if (iset.is(k, "jumphere")) {
+      kind[k] = OP_JUMPHERE;
+      op_jumphere = k;
+    }
+    else if (weights[k]>0)
+      plain += weights[k];
+  }
+
+  if (structured) {
+    if (plain<=0)
+      throw (string)"ProgramGenerator: structured programs need weight on instructions other than loop, endloop, jumpifn and jumphere";
+    for (unsigned k=0;k<n;k++) // an opener without its closer in the set could never be closed
+      if ( ((kind[k]==OP_LOOP) && !op_endloop) || ((kind[k]==OP_JUMPIFN) && !op_jumphere) )
+        kind[k] = OP_PLAIN;
+  }
+}
+
+void ProgramGenerator::fill(ByteCode_Type* out, size_t n)
+{
+  for (size_t i=0;i<n;i++)
+    out[i] = table.sample(rng.next());
+}
+
+void ProgramGenerator::program(ByteCode_Type* out, unsigned length)
+{
+  if (!structured) {
+    fill(out, length);
+    return;
+  }
+
+  open.clear();
+  unsigned n_open_loops = 0;
+  int outer_loops = 0; // loops opened since the outermost open loop, itself included: its depth so far
+
+  for (unsigned i=0;i<length;i++) {
+    const unsigned left = length-i;
+
+    if (open.size()==left) { // only room left to close what is open
+      if (open.back()==OP_LOOP) {
+        out[i] = op_endloop;
+        if (--n_open_loops==0)
+          outer_loops = 0;
+      }
+      else
+        out[i] = op_jumphere;
+      open.pop_back();
+      continue;
+    }
+
+    for (;;) {
+      const ByteCode_Type x = table.sample(rng.next());
+      switch (kind[x]) {
+        case OP_PLAIN:
+          out[i] = x;
+          break;
+        case OP_LOOP:
+          if ( (i==0) || (open.size()+2>left) )
+            continue;
+          if ( (max_loop_depth>=0) && (outer_loops+1>max_loop_depth) )
+            continue;
+          out[i] = x;
+          open.push_back(OP_LOOP);
+          n_open_loops++;
+          outer_loops++;
+          break;
+        case OP_JUMPIFN:
+          if (open.size()+2>left)
+            continue;
+          out[i] = x;
+          open.push_back(OP_JUMPIFN);
+          break;
+        default: // a closer: closes the innermost block
+          if (open.empty())
+            continue;
+          if (open.back()==OP_LOOP) {
+            out[i] = op_endloop;
+            if (--n_open_loops==0)
+              outer_loops = 0;
+          }
+          else
+            out[i] = op_jumphere;
+          open.pop_back();
+          break;
+      }
+      break;
+    }
+  }
+}
+
+unsigned ProgramGenerator::populate(PopulationArena& pop, unsigned n_programs, unsigned min_length, unsigned max_length)
+{
+  if (max_length<min_length)
+    max_length = min_length;
+
+  const unsigned first = pop.size();
+  for (unsigned p=0;p<n_programs;p++) {
+    const unsigned length = min_length + rng.below(max_length-min_length+1);
+    const unsigned i = pop.add(ProgramView());
+    pop.resize(i, length);
+    program(pop.data(i), length);
+  }
+  return first;
+}
+
+
+/*
+ *
+ * Functions
+ *
+ */
+
+vector<double> opcodeWeights(InstructionSet& iset, double numeric_share)
+{
+  const unsigned n = iset.size(), n_num = iset.numericInstructions();
+  vector<double> w(n, 0);
+  if (n_num==n) // numeric instructions only
+    numeric_share = 1;
+  else if (n_num==0)
+    numeric_share = 0;
+
+  for (unsigned k=0;k<n;k++)
+    w[k] = (k<n_num) ? numeric_share/n_num : (1-numeric_share)/(n-n_num);
+  return w;
+}
+
+}; //namespace SlashA
@@ -0,0 +1,128 @@
+/*
+ *
+ *  SlashA_Generator.hpp - random programs from weighted opcode distributions
+ *
+ *  Copyright (C) 2004-2011 Artur B Adib
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef SLASHA_GENERATOR_INCLUDED // duplicate protection
+#define SLASHA_GENERATOR_INCLUDED
+
+#include <stdint.h>
+#include "SlashA.hpp"
+#include "SlashA_Population.hpp"
+
+namespace SlashA
+{
+
+  /*
+   * xoshiro256** run as four independent streams side by side, so fill() computes four words per step
+   * with no dependency between them (the compiler keeps the streams in vector registers). The streams are
+   * seeded from one 64-bit seed through splitmix64. Not suitable for cryptography.
+   */
+  class FastRandom
+  {
+    private:
+      uint64_t s[4][4]; // s[k][lane]
+      uint64_t buf[256];
+      unsigned pos;
+
+      void refill();
+    public:
+      FastRandom(uint64_t seed = 1) { setSeed(seed); }
+
+      void setSeed(uint64_t seed);
+      void fill(uint64_t* out, size_t n); // n words, whole steps of four as far as possible
+      uint64_t next() { if (pos==256) refill(); return buf[pos++]; }
+      double uniform() { return (next()>>11)*(1.0/9007199254740992.0); } // [0, 1)
+      unsigned below(unsigned n) { return (unsigned)(((next()>>32)*n)>>32); } // [0, n)
+  };
+
+  /*
+   * Walker's alias method (Vose's construction): one random word picks a column and decides between it and
+   * its alias, whatever the number of outcomes.
+   */
+  class AliasTable
+  {
+    private:
+      std::vector<uint32_t> threshold; // keep the column if the low word is below this
+      std::vector<uint32_t> alias;
+    public:
+      AliasTable() {}
+      AliasTable(const std::vector<double>& weights) { build(weights); }
+
+      void build(const std::vector<double>& weights); // throws if no weight is positive
+      unsigned size() const { return alias.size(); }
+      unsigned sample(uint64_t r) const
+      {
+        const unsigned i = (unsigned)(((r>>32)*alias.size())>>32);
+        return ((uint32_t)r<threshold[i]) ? i : alias[i];
+      }
+  };
+
+  // One weight per opcode of iset: the numeric instructions share numeric_share of the total evenly and
+  // every other instruction gets an equal part of the rest. Edit the result to taste, e.g.
+  // w[iset.lookup("loop", 4)] *= 0.5.
+  std::vector<double> opcodeWeights(InstructionSet& iset, double numeric_share = 0.25);
+
+  /*
+   * Draws opcodes from a weighted distribution. program() may also build structurally valid programs in
+   * the same pass, with no filtering afterwards:
+   * - loop/endloop and jumpifn/jumphere are balanced and nest properly inside each other;
+   * - a drawn endloop or jumphere closes the innermost open block (with its own closer), and is drawn again
+   *   if no block is open; the blocks still open near the end are closed by the last instructions;
+   * - loops obey max_loop_depth as the interpreter counts it (1 + loops anywhere inside, not only the
+   *   nesting), and none starts at position 0, where the interpreter cannot match its endloop.
+   * Structured generation needs some weight on instructions other than those four.
+   */
+  class ProgramGenerator
+  {
+    private:
+      enum { OP_PLAIN, OP_LOOP, OP_ENDLOOP, OP_JUMPIFN, OP_JUMPHERE };
+
+      AliasTable table;
+      std::vector<unsigned char> kind; // per opcode
+      ByteCode_Type op_endloop, op_jumphere;
+      int max_loop_depth; // < 0: unbounded
+      bool structured;
+      FastRandom rng;
+      std::vector<unsigned char> open; // OP_LOOP or OP_JUMPIFN, innermost last
+
+    public:
+      ProgramGenerator(InstructionSet& iset,
+                       const std::vector<double>& weights, // one per opcode
+                       uint64_t seed = 1,
+                       bool _structured = true,
+                       int _max_loop_depth = -2); // -2: iset.getMaxLoopDepth()
+
+      void setSeed(uint64_t seed) { rng.setSeed(seed); }
+      FastRandom& random() { return rng; }
+
+      ByteCode_Type next() { return table.sample(rng.next()); } // one opcode, no constraints
+      void fill(ByteCode_Type* out, size_t n); // n opcodes, no constraints
+
+      void program(ByteCode_Type* out, unsigned length); // structured if enabled
+      void program(ByteCode& bc, unsigned length) { bc.resize(length); program(bc.data(), length); }
+
+      // Appends n_programs programs of lengths drawn uniformly in [min_length, max_length], written straight
+      // into the arena. Returns the index of the first one.
+      unsigned populate(PopulationArena& pop, unsigned n_programs, unsigned min_length, unsigned max_length);
+  };
+
+}; // namespace SlashA
+
+#endif // SLASHA_GENERATOR_INCLUDED
@@ -0,0 +1,114 @@
+/*
+ *
+ *  SlashA_Interp.hpp - the interpreter loop shared by the runByteCode*() family (internal header)
+ *
+ *  Copyright (C) 2004-2011 Artur B Adib
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef SLASHA_INTERP_INCLUDED // duplicate protection
+#define SLASHA_INTERP_INCLUDED
+
+#ifdef DEBUG
+#include <iostream>
+#endif
+#include "SlashA.hpp"
+
+namespace SlashA
+{
+
+/*
+ * The loop is a template on its stop condition and on a per-instruction hook, so that variants such as
+ * tracing pay nothing when they are not used: the default hook compiles away entirely.
+ */
+
+struct NoHook
+{
+  template <class ISet, class Core> inline void before(ISet& iset, Core& core, ByteCode_Type inst) {}
+  template <class ISet, class Core> inline void after(ISet& iset, Core& core, ByteCode_Type inst) {}
+};
+
+struct FlagRaised // stop condition driven by a flag owned by another thread
+{
+  const std::atomic<bool>& flag;
+  FlagRaised(const std::atomic<bool>& f) : flag(f) {}
+  inline bool operator()() const { return flag.load(std::memory_order_relaxed); }
+};
+
+struct QuantumSpent // stop condition: a given number of instructions has been run
+{
+  mutable unsigned long left;
+  QuantumSpent(unsigned long n) : left(n) {}
+  inline bool operator()() const { if (left==0) return true; left--; return false; }
+};
+
+struct Tape32 // reads the program from a ByteCode
+{
+  template <class Core> inline ByteCode_Type operator()(Core& core, unsigned pos) const { return core.C32[pos]; }
+};
+
+struct Tape16 // reads the program from a compact ByteCode16
+{
+  template <class Core> inline ByteCode_Type operator()(Core& core, unsigned pos) const { return core.C16[pos]; }
+};
+
+// Runs from the current core.c until the end of the program or until stopped() is true.
+// Returns true if the program failed (e.g. loop depth exceeded).
+template <class T, class StopCondition, class Hook, class Tape>
+inline bool execLoop(BasicInstructionSet<T>& iset, BasicMemCore<T>& core, const StopCondition& stopped, Hook& hook, const Tape& tape)
+{
+  const unsigned C_size = core.C_size;
+
+  try
+  {
+    while ( (core.c<C_size) && (!stopped()) ) {
+      const ByteCode_Type inst = tape(core, core.c);
+#ifdef DEBUG
+      std::cout << " [I]=" << core.I << ", [F]=" << core.getF() << ", D[I]=" << core.D[core.I] << std::endl;
+      std::cout << " Next instruction: " << iset.getName(inst) << ". (hit enter)";
+      std::cin.get();
+      std::cout << std::endl;
+#endif
+      hook.before(iset, core, inst);
+      iset.exec(inst, core);
+      hook.after(iset, core, inst);
+      core.c++;
+    }
+  }
+  catch(int whatever)
+  {
+    return true; // program failed
+  }
+
+  return false;
+}
+
+template <class T, class StopCondition, class Hook>
+inline bool execLoop(BasicInstructionSet<T>& iset, BasicMemCore<T>& core, const StopCondition& stopped, Hook& hook)
+{
+  return execLoop(iset, core, stopped, hook, Tape32());
+}
+
+template <class T, class StopCondition>
+inline bool execLoop(BasicInstructionSet<T>& iset, BasicMemCore<T>& core, const StopCondition& stopped)
+{
+  NoHook hook;
+  return execLoop(iset, core, stopped, hook, Tape32());
+}
+
+}; // namespace SlashA
+
+#endif // SLASHA_INTERP_INCLUDED
@@ -0,0 +1,346 @@
+/*
+ *
+ *  SlashA_Kernels.hpp - SIMD kernels behind the data-tape range instructions
+ *
+ *  Copyright (C) 2004-2011 Artur B Adib
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef SLASHA_KERNELS_INCLUDED // duplicate protection
+#define SLASHA_KERNELS_INCLUDED
+
+#include <cmath>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace SlashA
+{
+
+namespace Kernels
+{
+
+/*
+ * All kernels work on plain arrays of n doubles (or floats, further down); range/validity checks are the caller's business.
+ * With SSE2 (always available on x86-64) two lanes are processed per instruction and two independent
+ * accumulators are kept to hide the latency of the floating-point adder. Without SSE2 the same
+ * four-way split is done in scalar code, so results are identical on both paths.
+ */
+
+inline double sum(const double* x, unsigned n)
+{
+  unsigned i=0;
+#ifdef __SSE2__
+  __m128d acc0 = _mm_setzero_pd(), acc1 = _mm_setzero_pd();
+  for (;i+4<=n;i+=4) {
+    acc0 = _mm_add_pd(acc0, _mm_loadu_pd(x+i));
+    acc1 = _mm_add_pd(acc1, _mm_loadu_pd(x+i+2));
+  }
+  double lanes[2];
+  _mm_storeu_pd(lanes, _mm_add_pd(acc0, acc1));
+  double s = lanes[0] + lanes[1];
+#else
+  double a0=0, a1=0, a2=0, a3=0;
+  for (;i+4<=n;i+=4) { a0+=x[i]; a1+=x[i+1]; a2+=x[i+2]; a3+=x[i+3]; }
+  double s = (a0+a2) + (a1+a3);
+#endif
+  for (;i<n;i++)
+    s += x[i];
+  return s;
+}
+
+inline double dot(const double* x, const double* y, unsigned n)
+{
+  unsigned i=0;
+#ifdef __SSE2__
+  __m128d acc0 = _mm_setzero_pd(), acc1 = _mm_setzero_pd();
+  for (;i+4<=n;i+=4) {
+    acc0 = _mm_add_pd(acc0, _mm_mul_pd(_mm_loadu_pd(x+i), _mm_loadu_pd(y+i)));
+    acc1 = _mm_add_pd(acc1, _mm_mul_pd(_mm_loadu_pd(x+i+2), _mm_loadu_pd(y+i+2)));
+  }
+  double lanes[2];
+  _mm_storeu_pd(lanes, _mm_add_pd(acc0, acc1));
+  double s = lanes[0] + lanes[1];
+#else
+  double a0=0, a1=0, a2=0, a3=0;
+  for (;i+4<=n;i+=4) { a0+=x[i]*y[i]; a1+=x[i+1]*y[i+1]; a2+=x[i+2]*y[i+2]; a3+=x[i+3]*y[i+3]; }
+  double s = (a0+a2) + (a1+a3);
+#endif
+  for (;i<n;i++)
+    s += x[i]*y[i];
+  return s;
+}
+
+inline double sqdist(const double* x, const double* y, unsigned n) // squared Euclidean distance
+{
+  unsigned i=0;
+#ifdef __SSE2__
+  __m128d acc0 = _mm_setzero_pd(), acc1 = _mm_setzero_pd();
+  for (;i+4<=n;i+=4) {
+    __m128d d0 = _mm_sub_pd(_mm_loadu_pd(x+i), _mm_loadu_pd(y+i));
+    __m128d d1 = _mm_sub_pd(_mm_loadu_pd(x+i+2), _mm_loadu_pd(y+i+2));
+    acc0 = _mm_add_pd(acc0, _mm_mul_pd(d0, d0));
+    acc1 = _mm_add_pd(acc1, _mm_mul_pd(d1, d1));
+  }
+  double lanes[2];
+  _mm_storeu_pd(lanes, _mm_add_pd(acc0, acc1));
+  double s = lanes[0] + lanes[1];
+#else
+  double a0=0, a1=0, a2=0, a3=0;
+  for (;i+4<=n;i+=4) {
+    const double d0=x[i]-y[i], d1=x[i+1]-y[i+1], d2=x[i+2]-y[i+2], d3=x[i+3]-y[i+3];
+    a0+=d0*d0; a1+=d1*d1; a2+=d2*d2; a3+=d3*d3;
+  }
+  double s = (a0+a2) + (a1+a3);
+#endif
+  for (;i<n;i++)
+    s += (x[i]-y[i])*(x[i]-y[i]);
+  return s;
+}
+
+inline double absdist(const double* x, const double* y, unsigned n) // sum of |x[i]-y[i]|
+{
+  unsigned i=0;
+#ifdef __SSE2__
+  const __m128d mask = _mm_castsi128_pd(_mm_set1_epi64x(0x7fffffffffffffffLL)); // clears the sign bit
+  __m128d acc0 = _mm_setzero_pd(), acc1 = _mm_setzero_pd();
+  for (;i+4<=n;i+=4) {
+    acc0 = _mm_add_pd(acc0, _mm_and_pd(_mm_sub_pd(_mm_loadu_pd(x+i), _mm_loadu_pd(y+i)), mask));
+    acc1 = _mm_add_pd(acc1, _mm_and_pd(_mm_sub_pd(_mm_loadu_pd(x+i+2), _mm_loadu_pd(y+i+2)), mask));
+  }
+  double lanes[2];
+  _mm_storeu_pd(lanes, _mm_add_pd(acc0, acc1));
+  double s = lanes[0] + lanes[1];
+#else
+  double a0=0, a1=0, a2=0, a3=0;
+  for (;i+4<=n;i+=4) {
+    a0+=std::fabs(x[i]-y[i]); a1+=std::fabs(x[i+1]-y[i+1]); a2+=std::fabs(x[i+2]-y[i+2]); a3+=std::fabs(x[i+3]-y[i+3]);
+  }
+  double s = (a0+a2) + (a1+a3);
+#endif
+  for (;i<n;i++)
+    s += std::fabs(x[i]-y[i]);
+  return s;
+}
+
+inline unsigned hits(const double* x, const double* y, unsigned n, double tol) // number of |x[i]-y[i]| <= tol
+{
+  unsigned i=0, h=0;
+#ifdef __SSE2__
+  const __m128d mask = _mm_castsi128_pd(_mm_set1_epi64x(0x7fffffffffffffffLL));
+  const __m128d vtol = _mm_set1_pd(tol);
+  for (;i+2<=n;i+=2) {
+    const int m = _mm_movemask_pd(_mm_cmple_pd(_mm_and_pd(_mm_sub_pd(_mm_loadu_pd(x+i), _mm_loadu_pd(y+i)), mask), vtol));
+    h += (m&1) + (m>>1);
+  }
+#endif
+  for (;i<n;i++)
+    h += (std::fabs(x[i]-y[i])<=tol);
+  return h;
+}
+
+// Centered second moments: sxx = sum (x-mx)^2, syy = sum (y-my)^2, sxy = sum (x-mx)(y-my), one lane
+// for the even and one for the odd elements (the scalar path keeps the same split).
+inline void comoments(const double* x, double mx, const double* y, double my, unsigned n,
+                      double& sxx, double& syy, double& sxy)
+{
+  unsigned i=0;
+#ifdef __SSE2__
+  const __m128d vmx = _mm_set1_pd(mx), vmy = _mm_set1_pd(my);
+  __m128d axx = _mm_setzero_pd(), ayy = _mm_setzero_pd(), axy = _mm_setzero_pd();
+  for (;i+2<=n;i+=2) {
+    const __m128d dx = _mm_sub_pd(_mm_loadu_pd(x+i), vmx), dy = _mm_sub_pd(_mm_loadu_pd(y+i), vmy);
+    axx = _mm_add_pd(axx, _mm_mul_pd(dx, dx));
+    ayy = _mm_add_pd(ayy, _mm_mul_pd(dy, dy));
+    axy = _mm_add_pd(axy, _mm_mul_pd(dx, dy));
+  }
+  double lanes[2];
+  _mm_storeu_pd(lanes, axx); sxx = lanes[0] + lanes[1];
+  _mm_storeu_pd(lanes, ayy); syy = lanes[0] + lanes[1];
+  _mm_storeu_pd(lanes, axy); sxy = lanes[0] + lanes[1];
+#else
+  double xx0=0, xx1=0, yy0=0, yy1=0, xy0=0, xy1=0;
+  for (;i+2<=n;i+=2) {
+    const double dx0=x[i]-mx, dx1=x[i+1]-mx, dy0=y[i]-my, dy1=y[i+1]-my;
+    xx0+=dx0*dx0; xx1+=dx1*dx1; yy0+=dy0*dy0; yy1+=dy1*dy1; xy0+=dx0*dy0; xy1+=dx1*dy1;
+  }
+  sxx = xx0+xx1; syy = yy0+yy1; sxy = xy0+xy1;
+#endif
+  for (;i<n;i++) {
+    const double dx=x[i]-mx, dy=y[i]-my;
+    sxx += dx*dx; syy += dy*dy; sxy += dx*dy;
+  }
+}
+
+template <class T>
+inline T maxabs(const T* x, unsigned n)
+{
+  T m=0;
+  for (unsigned i=0;i<n;i++) // simple enough for the auto-vectorizer
+    m = (std::fabs(x[i])>m) ? std::fabs(x[i]) : m;
+  return m;
+}
+
+inline void scale(double* x, double f, unsigned n)
+{
+  unsigned i=0;
+#ifdef __SSE2__
+  const __m128d vf = _mm_set1_pd(f);
+  for (;i+2<=n;i+=2)
+    _mm_storeu_pd(x+i, _mm_mul_pd(_mm_loadu_pd(x+i), vf));
+#endif
+  for (;i<n;i++)
+    x[i] *= f;
+}
+
+/*
+ * Second-order Horner scheme: p(x) = E(x^2) + x*O(x^2), where E and O are built from the even and odd
+ * coefficients. The two chains are independent, so they run side by side in the two SSE2 lanes.
+ * Coefficients are in ascending order, i.e. p(x) = c[0] + c[1]*x + ... + c[n-1]*x^(n-1).
+ */
+inline double horner(const double* c, unsigned n, double x)
+{
+  if (n==0)
+    return 0;
+
+  const double x2 = x*x;
+  int i = (int)n-1;
+  double e=0, o=0;
+
+  if ((n&1)==0) { // pairs up the top coefficient (odd power) with the one below it
+    o = c[i];
+    e = c[i-1];
+    i -= 2;
+  }
+  else {
+    e = c[i];
+    i -= 1;
+  }
+
+#ifdef __SSE2__
+  __m128d acc = _mm_set_pd(o, e); // lanes: [e, o]
+  const __m128d vx2 = _mm_set1_pd(x2);
+  for (;i>=1;i-=2)
+    acc = _mm_add_pd(_mm_mul_pd(acc, vx2), _mm_set_pd(c[i], c[i-1]));
+  double lanes[2];
+  _mm_storeu_pd(lanes, acc);
+  e = lanes[0]; o = lanes[1];
+#else
+  for (;i>=1;i-=2) {
+    e = e*x2 + c[i-1];
+    o = o*x2 + c[i];
+  }
+#endif
+
+  return e + x*o;
+}
+
+/*
+ * Single-precision versions: four lanes per SSE register and two accumulators, i.e. eight partial sums,
+ * which the scalar fallback keeps in the same order.
+ */
+
+inline float sum(const float* x, unsigned n)
+{
+  unsigned i=0;
+  float lanes[4];
+#ifdef __SSE2__
+  __m128 acc0 = _mm_setzero_ps(), acc1 = _mm_setzero_ps();
+  for (;i+8<=n;i+=8) {
+    acc0 = _mm_add_ps(acc0, _mm_loadu_ps(x+i));
+    acc1 = _mm_add_ps(acc1, _mm_loadu_ps(x+i+4));
+  }
+  _mm_storeu_ps(lanes, _mm_add_ps(acc0, acc1));
+#else
+  float a0[4] = {0, 0, 0, 0}, a1[4] = {0, 0, 0, 0};
+  for (;i+8<=n;i+=8)
+    for (unsigned l=0;l<4;l++) { a0[l]+=x[i+l]; a1[l]+=x[i+4+l]; }
+  for (unsigned l=0;l<4;l++)
+    lanes[l] = a0[l] + a1[l];
+#endif
+  float s = (lanes[0] + lanes[2]) + (lanes[1] + lanes[3]);
+  for (;i<n;i++)
+    s += x[i];
+  return s;
+}
+
+inline float dot(const float* x, const float* y, unsigned n)
+{
+  unsigned i=0;
+  float lanes[4];
+#ifdef __SSE2__
+  __m128 acc0 = _mm_setzero_ps(), acc1 = _mm_setzero_ps();
+  for (;i+8<=n;i+=8) {
+    acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(x+i), _mm_loadu_ps(y+i)));
+    acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(x+i+4), _mm_loadu_ps(y+i+4)));
+  }
+  _mm_storeu_ps(lanes, _mm_add_ps(acc0, acc1));
+#else
+  float a0[4] = {0, 0, 0, 0}, a1[4] = {0, 0, 0, 0};
+  for (;i+8<=n;i+=8)
+    for (unsigned l=0;l<4;l++) { a0[l]+=x[i+l]*y[i+l]; a1[l]+=x[i+4+l]*y[i+4+l]; }
+  for (unsigned l=0;l<4;l++)
+    lanes[l] = a0[l] + a1[l];
+#endif
+  float s = (lanes[0] + lanes[2]) + (lanes[1] + lanes[3]);
+  for (;i<n;i++)
+    s += x[i]*y[i];
+  return s;
+}
+
+inline void scale(float* x, float f, unsigned n)
+{
+  unsigned i=0;
+#ifdef __SSE2__
+  const __m128 vf = _mm_set1_ps(f);
+  for (;i+4<=n;i+=4)
+    _mm_storeu_ps(x+i, _mm_mul_ps(_mm_loadu_ps(x+i), vf));
+#endif
+  for (;i<n;i++)
+    x[i] *= f;
+}
+
+inline float horner(const float* c, unsigned n, float x) // same two chains as the double version, in scalar code
+{
+  if (n==0)
+    return 0;
+
+  const float x2 = x*x;
+  int i = (int)n-1;
+  float e=0, o=0;
+
+  if ((n&1)==0) {
+    o = c[i];
+    e = c[i-1];
+    i -= 2;
+  }
+  else {
+    e = c[i];
+    i -= 1;
+  }
+  for (;i>=1;i-=2) {
+    e = e*x2 + c[i-1];
+    o = o*x2 + c[i];
+  }
+  return e + x*o;
+}
+
+} // namespace Kernels
+
+} // namespace SlashA
+
+#endif // SLASHA_KERNELS_INCLUDED
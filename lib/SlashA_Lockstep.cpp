@@ -0,0 +1,129 @@
+/*
+ *
+ *  SlashA_Lockstep.cpp
+ *
+ *  Copyright (C) 2004-2011 Artur B Adib
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "SlashA_Lockstep.hpp"
+#include "SlashA_Metrics.hpp"
+
+using namespace std;
+
+namespace SlashA
+{
+
+
+/*
+ *
+ * Class methods
+ *
+ */
+
+//
+//  Class: LockstepEvaluator
+//
+
+LockstepEvaluator::LockstepEvaluator(unsigned _D_size,
+                                     unsigned _L_size,
+                                     unsigned _lanes)
+{
+  if (_lanes==0)
+    throw (string)"A lockstep evaluator needs at least one lane";
+
+  D_size = _D_size;
+  L_size = _L_size;
+  lanes = _lanes;
+  for (unsigned i=0;i<lanes;i++) {
+    cores.push_back(new MemCore(D_size, L_size, no_input, no_output));
+    cores.back()->setIO(IOPolicy::buffers());
+  }
+}
+
+LockstepEvaluator::~LockstepEvaluator()
+{
+  for (unsigned i=0;i<cores.size();i++)
+    delete cores[i];
+}
+
+bool LockstepEvaluator::run(InstructionSet& iset,
+                            ByteCode& bc,
+                            FitnessCases& cases,
+                            long randseed,
+                            EvalResult& res)
+{
+  if (!isStraightLine(iset, bc))
+    throw (string)"Lockstep evaluation needs a program without loops or jumps";
+
+  const uint64_t t0 = metricsEnabled() ? metricsClock() : 0;
+
+  res.clear();
+  res.outputs.resize(cases.size());
+  iset.clear(); // counters add up over all the lanes, i.e. they come out as totals over the cases
+
+  for (unsigned first=0;first<cases.size();first+=lanes) {
+    const unsigned n = min(lanes, (unsigned)cases.size()-first);
+
+    for (unsigned i=0;i<n;i++) {
+      MemCore& core = *cores[i];
+      core.reset();
+      core.input = &cases[first+i];
+      core.output = &res.outputs[first+i];
+      core.setProgram(bc);
+      *core.ran_ptr = (randseed>0) ? -randseed : randseed;
+      core.beginRun();
+    }
+
+    for (unsigned c=0;c<bc.size();c++) {
+      for (unsigned i=0;i<n;i++)
+        cores[i]->c = c;
+      iset.execLanes(bc[c], &cores[0], n);
+    }
+
+    for (unsigned i=0;i<n;i++) {
+      cores[i]->input = &no_input;
+      cores[i]->output = &no_output;
+    }
+  }
+
+  res.n_cases = cases.size();
+  res.n_ops = iset.getTotalOps();
+  res.n_invops = iset.getTotalInvops();
+  res.n_inputs_bf_output = iset.getTotalInputsBFOutput();
+
+  if (metricsEnabled())
+    recordEvaluation(t0, res.n_cases, res.n_ops, res.n_invops, 0, 0);
+
+  return false;
+}
+
+
+/*
+ *
+ * Functions
+ *
+ */
+
+bool isStraightLine(InstructionSet& iset, const ByteCode& bc)
+{
+  for (unsigned i=0;i<bc.size();i++)
+    if ( iset.is(bc[i], "loop") || iset.is(bc[i], "endloop") || iset.is(bc[i], "jumpifn") || iset.is(bc[i], "gotoifp") )
+      return false;
+  return true;
+}
+
+}; //namespace SlashA
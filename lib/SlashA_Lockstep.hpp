@@ -0,0 +1,68 @@
+/*
+ *
+ *  SlashA_Lockstep.hpp - runs a straight-line program over many fitness cases at once
+ *
+ *  Copyright (C) 2004-2011 Artur B Adib
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef SLASHA_LOCKSTEP_INCLUDED // duplicate protection
+#define SLASHA_LOCKSTEP_INCLUDED
+
+#include "SlashA.hpp"
+
+namespace SlashA
+{
+
+  /*
+   * A program without loops or gotos runs every instruction exactly once, in order, whatever its input. So
+   * all the fitness cases can advance together: one core per case ("lane"), and each instruction is applied
+   * to all the lanes before moving on (Instruction::codeLanes()). The interpreter dispatch is paid once per
+   * instruction instead of once per case, and in MATH_FAST mode exp, sin and pow go through the SIMD kernels
+   * of lib/SlashA_Math.hpp. Outputs and counters are the same as those of runFitnessCases(), except that in
+   * MATH_FAST mode pow results may differ by the kernel's error, as the interpreter uses libm for pow.
+   *
+   * User-defined instructions must not change core.c.
+   */
+  class LockstepEvaluator
+  {
+    private:
+      unsigned D_size, L_size;
+      unsigned lanes;
+      std::vector<MemCore*> cores;
+      std::vector<double> no_input, no_output;
+    public:
+      LockstepEvaluator(unsigned _D_size,
+                        unsigned _L_size,
+                        unsigned _lanes = 256); // cases run together (larger batches are run in blocks)
+      ~LockstepEvaluator();
+
+      // Same as runFitnessCases(); throws if bc is not straight-line.
+      bool run(InstructionSet& iset,
+               ByteCode& bc,
+               FitnessCases& cases,
+               long randseed,
+               EvalResult& res);
+  };
+
+  /* Functions */
+
+  // True if bc has no loop, endloop, jumpifn or gotoifp (the instructions that move the program position).
+  bool isStraightLine(InstructionSet& iset, const ByteCode& bc);
+
+}; // namespace SlashA
+
+#endif // SLASHA_LOCKSTEP_INCLUDED
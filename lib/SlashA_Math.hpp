@@ -0,0 +1,330 @@
+/*
+ *
+ *  SlashA_Math.hpp - scalar and SIMD kernels behind the exp, log, sin and pow instructions
+ *
+ *  Copyright (C) 2004-2011 Artur B Adib
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef SLASHA_MATH_INCLUDED // duplicate protection
+#define SLASHA_MATH_INCLUDED
+
+#include <cmath>
+#include <cstring>
+#include <stdint.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace SlashA
+{
+
+namespace Math
+{
+
+/*
+ * The algorithms of fdlibm (argument reduction by ln2 or pi/2, then its minimax polynomials), written
+ * without branches so that the SSE2 versions below run two lanes through exactly the same operations: a
+ * value gives the same result whether it goes through the scalar or the batched kernel. Arguments outside
+ * the ranges handled here (and non-finite ones) are passed to libm. Maximum errors measured against glibc
+ * on 2^24 random arguments per range (examples/math-bench):
+ *
+ *   exp  |x| <= 708                    1 ulp
+ *   log  x normal                      1 ulp
+ *   sin  |x| <= 10                     1 ulp
+ *        |x| <= 5e5                    2 ulp (pi/2 is carried to 119 bits in the reduction)
+ *   pow  x > 0, or x < 0 and y integer 1 + 2.1|y ln x| ulp, i.e. exp(y log x) with no extra precision
+ *
+ * In MATH_FAST mode the exp and sin instructions use these kernels, one value at a time in the interpreter and
+ * batched under lockstep evaluation. pow uses them only batched, and log not at all: one value at a time,
+ * log and pow are slower than glibc's (examples/math-bench).
+ */
+
+const unsigned laneBlock = 64; // values gathered per batched call by the instructions' codeLanes()
+
+namespace Detail
+{
+  const double magic = 6755399441055744.0; // 1.5*2^52: x+magic-magic rounds x to an integer (|x| < 2^51)
+
+  const double ln2_hi = 6.93147180369123816490e-01;
+  const double ln2_lo = 1.90821492927058770002e-10;
+  const double inv_ln2 = 1.44269504088896338700e+00;
+
+  const double P1 = 1.66666666666666019037e-01; // exp
+  const double P2 = -2.77777777770155933842e-03;
+  const double P3 = 6.61375632143793436117e-05;
+  const double P4 = -1.65339022054652515390e-06;
+  const double P5 = 4.13813679705723846039e-08;
+
+  const double Lg1 = 6.666666666666735130e-01; // log
+  const double Lg2 = 3.999999999940941908e-01;
+  const double Lg3 = 2.857142874366239149e-01;
+  const double Lg4 = 2.222219843214978396e-01;
+  const double Lg5 = 1.818357216161805012e-01;
+  const double Lg6 = 1.531383769920937332e-01;
+  const double Lg7 = 1.479819860511658591e-01;
+  const double sqrt2 = 1.41421356237309514547e+00;
+
+  const double inv_pio2 = 6.36619772367581382433e-01; // sin
+  const double pio2_1 = 1.57079632673412561417e+00; // first 33 bits of pi/2
+  const double pio2_2 = 6.07710050630396597660e-11; // next 33 bits
+  const double pio2_2t = 2.02226624879595063154e-21; // pi/2 - (pio2_1 + pio2_2)
+  const double S1 = -1.66666666666666324348e-01;
+  const double S2 = 8.33333333332248946124e-03;
+  const double S3 = -1.98412698298579493134e-04;
+  const double S4 = 2.75573137070700676789e-06;
+  const double S5 = -2.50507602534068634195e-08;
+  const double S6 = 1.58969099521155010221e-10;
+  const double C1 = 4.16666666666666019037e-02;
+  const double C2 = -1.38888888888741095749e-03;
+  const double C3 = 2.48015872894767294178e-05;
+  const double C4 = -2.75573143513906633035e-07;
+  const double C5 = 2.08757232129817482790e-09;
+  const double C6 = -1.13596475577881948265e-11;
+
+  inline uint64_t bits(double x) { uint64_t b; memcpy(&b, &x, sizeof(b)); return b; }
+  inline double fromBits(uint64_t b) { double x; memcpy(&x, &b, sizeof(x)); return x; }
+
+  inline bool expInRange(double x) { return std::fabs(x)<=708.0; } // false for NaN as well
+  inline bool logInRange(double x) { return (x>=2.2250738585072014e-308) && (x<=1.7976931348623157e+308); }
+  inline bool sinInRange(double x) { return std::fabs(x)<=5e5; }
+};
+
+inline double exp(double x)
+{
+  using namespace Detail;
+  if (!expInRange(x))
+    return std::exp(x);
+
+  const double t = x*inv_ln2 + magic;
+  const double k = t - magic;
+  const double hi = x - k*ln2_hi, lo = k*ln2_lo;
+  const double r = hi - lo;
+  const double z = r*r;
+  const double c = r - z*(P1 + z*(P2 + z*(P3 + z*(P4 + z*P5))));
+  const double y = 1.0 - ((lo - (r*c)/(2.0-c)) - hi);
+  return y * fromBits((bits(t) - bits(magic) + 1023) << 52); // y * 2^k
+}
+
+inline double log(double x)
+{
+  using namespace Detail;
+  if (!logInRange(x))
+    return std::log(x);
+
+  const uint64_t b = bits(x);
+  double k = fromBits((b>>52) | bits(4503599627370496.0)) - (4503599627370496.0 + 1023); // exponent, via 2^52 + e
+  double m = fromBits((b & 0x000fffffffffffffULL) | bits(1.0)); // [1, 2)
+  const double big = (m>sqrt2) ? 1.0 : 0.0; // moves m to [sqrt2/2, sqrt2)
+  m = m*(1.0 - 0.5*big);
+  k = k + big;
+
+  const double f = m - 1.0;
+  const double s = f/(2.0+f);
+  const double z = s*s, w = z*z;
+  const double t1 = w*(Lg2 + w*(Lg4 + w*Lg6));
+  const double t2 = z*(Lg1 + w*(Lg3 + w*(Lg5 + w*Lg7)));
+  const double R = t2 + t1;
+  const double hfsq = 0.5*f*f;
+  return k*ln2_hi - ((hfsq - (s*(hfsq+R) + k*ln2_lo)) - f);
+}
+
+inline double sin(double x)
+{
+  using namespace Detail;
+  if (!sinInRange(x))
+    return std::sin(x);
+
+  const double t = x*inv_pio2 + magic;
+  const double n = t - magic;
+  const double r = ((x - n*pio2_1) - n*pio2_2) - n*pio2_2t; // [-pi/4, pi/4]
+  const double z = r*r;
+
+  const double s = r + (z*r)*(S1 + z*(S2 + z*(S3 + z*(S4 + z*(S5 + z*S6)))));
+  const double hz = 0.5*z, w = 1.0 - hz;
+  const double c = w + (((1.0-w) - hz) + z*(z*(C1 + z*(C2 + z*(C3 + z*(C4 + z*(C5 + z*C6)))))));
+
+  const unsigned q = (unsigned)(bits(t) - bits(magic)) & 3; // quadrant
+  const double v = (q & 1) ? c : s;
+  return (q & 2) ? -v : v;
+}
+
+inline double pow(double x, double y)
+{
+  if ( (x>0) && std::isfinite(y) )
+    return Math::exp(y*Math::log(x));
+  if ( (x<0) && (std::fabs(y)<9007199254740992.0) && (y==std::rint(y)) ) { // integer powers of a negative number
+    const double r = Math::exp(y*Math::log(-x));
+    return (std::fmod(y, 2.0)!=0) ? -r : r;
+  }
+  return std::pow(x, y);
+}
+
+/*
+ * Batched versions: y[i] = f(x[i]) for i < n. Pairs of lanes in range run in SSE2, anything else through
+ * the scalar kernels above, with identical results.
+ */
+
+inline void exp(const double* x, double* y, unsigned n)
+{
+  using namespace Detail;
+  unsigned i=0;
+#ifdef __SSE2__
+  for (;i+2<=n;i+=2) {
+    const __m128d vx = _mm_loadu_pd(x+i);
+    if (!(expInRange(x[i]) && expInRange(x[i+1]))) {
+      y[i] = Math::exp(x[i]);
+      y[i+1] = Math::exp(x[i+1]);
+      continue;
+    }
+    const __m128d vmagic = _mm_set1_pd(magic);
+    const __m128d t = _mm_add_pd(_mm_mul_pd(vx, _mm_set1_pd(inv_ln2)), vmagic);
+    const __m128d k = _mm_sub_pd(t, vmagic);
+    const __m128d hi = _mm_sub_pd(vx, _mm_mul_pd(k, _mm_set1_pd(ln2_hi)));
+    const __m128d lo = _mm_mul_pd(k, _mm_set1_pd(ln2_lo));
+    const __m128d r = _mm_sub_pd(hi, lo);
+    const __m128d z = _mm_mul_pd(r, r);
+    __m128d p = _mm_add_pd(_mm_set1_pd(P4), _mm_mul_pd(z, _mm_set1_pd(P5)));
+    p = _mm_add_pd(_mm_set1_pd(P3), _mm_mul_pd(z, p));
+    p = _mm_add_pd(_mm_set1_pd(P2), _mm_mul_pd(z, p));
+    p = _mm_add_pd(_mm_set1_pd(P1), _mm_mul_pd(z, p));
+    const __m128d c = _mm_sub_pd(r, _mm_mul_pd(z, p));
+    const __m128d q = _mm_div_pd(_mm_mul_pd(r, c), _mm_sub_pd(_mm_set1_pd(2.0), c));
+    const __m128d v = _mm_sub_pd(_mm_set1_pd(1.0), _mm_sub_pd(_mm_sub_pd(lo, q), hi));
+    __m128i e = _mm_sub_epi64(_mm_castpd_si128(t), _mm_castpd_si128(vmagic));
+    e = _mm_slli_epi64(_mm_add_epi64(e, _mm_set1_epi64x(1023)), 52);
+    _mm_storeu_pd(y+i, _mm_mul_pd(v, _mm_castsi128_pd(e)));
+  }
+#endif
+  for (;i<n;i++)
+    y[i] = Math::exp(x[i]);
+}
+
+inline void log(const double* x, double* y, unsigned n)
+{
+  using namespace Detail;
+  unsigned i=0;
+#ifdef __SSE2__
+  for (;i+2<=n;i+=2) {
+    if (!(logInRange(x[i]) && logInRange(x[i+1]))) {
+      y[i] = Math::log(x[i]);
+      y[i+1] = Math::log(x[i+1]);
+      continue;
+    }
+    const __m128i b = _mm_castpd_si128(_mm_loadu_pd(x+i));
+    const __m128d two52 = _mm_set1_pd(4503599627370496.0);
+    __m128d k = _mm_sub_pd(_mm_castsi128_pd(_mm_or_si128(_mm_srli_epi64(b, 52), _mm_castpd_si128(two52))),
+                           _mm_set1_pd(4503599627370496.0 + 1023));
+    const __m128d one = _mm_set1_pd(1.0);
+    __m128d m = _mm_castsi128_pd(_mm_or_si128(_mm_and_si128(b, _mm_set1_epi64x(0x000fffffffffffffLL)),
+                                              _mm_castpd_si128(one)));
+    const __m128d big = _mm_and_pd(_mm_cmpgt_pd(m, _mm_set1_pd(sqrt2)), one);
+    m = _mm_mul_pd(m, _mm_sub_pd(one, _mm_mul_pd(_mm_set1_pd(0.5), big)));
+    k = _mm_add_pd(k, big);
+
+    const __m128d f = _mm_sub_pd(m, one);
+    const __m128d s = _mm_div_pd(f, _mm_add_pd(_mm_set1_pd(2.0), f));
+    const __m128d z = _mm_mul_pd(s, s), w = _mm_mul_pd(z, z);
+    __m128d t1 = _mm_add_pd(_mm_set1_pd(Lg4), _mm_mul_pd(w, _mm_set1_pd(Lg6)));
+    t1 = _mm_mul_pd(w, _mm_add_pd(_mm_set1_pd(Lg2), _mm_mul_pd(w, t1)));
+    __m128d t2 = _mm_add_pd(_mm_set1_pd(Lg5), _mm_mul_pd(w, _mm_set1_pd(Lg7)));
+    t2 = _mm_add_pd(_mm_set1_pd(Lg3), _mm_mul_pd(w, t2));
+    t2 = _mm_mul_pd(z, _mm_add_pd(_mm_set1_pd(Lg1), _mm_mul_pd(w, t2)));
+    const __m128d R = _mm_add_pd(t2, t1);
+    const __m128d hfsq = _mm_mul_pd(_mm_mul_pd(_mm_set1_pd(0.5), f), f);
+    const __m128d inner = _mm_add_pd(_mm_mul_pd(s, _mm_add_pd(hfsq, R)), _mm_mul_pd(k, _mm_set1_pd(ln2_lo)));
+    _mm_storeu_pd(y+i, _mm_sub_pd(_mm_mul_pd(k, _mm_set1_pd(ln2_hi)), _mm_sub_pd(_mm_sub_pd(hfsq, inner), f)));
+  }
+#endif
+  for (;i<n;i++)
+    y[i] = Math::log(x[i]);
+}
+
+inline void sin(const double* x, double* y, unsigned n)
+{
+  using namespace Detail;
+  unsigned i=0;
+#ifdef __SSE2__
+  for (;i+2<=n;i+=2) {
+    if (!(sinInRange(x[i]) && sinInRange(x[i+1]))) {
+      y[i] = Math::sin(x[i]);
+      y[i+1] = Math::sin(x[i+1]);
+      continue;
+    }
+    const __m128d vx = _mm_loadu_pd(x+i);
+    const __m128d vmagic = _mm_set1_pd(magic);
+    const __m128d t = _mm_add_pd(_mm_mul_pd(vx, _mm_set1_pd(inv_pio2)), vmagic);
+    const __m128d nn = _mm_sub_pd(t, vmagic);
+    __m128d r = _mm_sub_pd(vx, _mm_mul_pd(nn, _mm_set1_pd(pio2_1)));
+    r = _mm_sub_pd(r, _mm_mul_pd(nn, _mm_set1_pd(pio2_2)));
+    r = _mm_sub_pd(r, _mm_mul_pd(nn, _mm_set1_pd(pio2_2t)));
+    const __m128d z = _mm_mul_pd(r, r);
+
+    __m128d ps = _mm_add_pd(_mm_set1_pd(S5), _mm_mul_pd(z, _mm_set1_pd(S6)));
+    ps = _mm_add_pd(_mm_set1_pd(S4), _mm_mul_pd(z, ps));
+    ps = _mm_add_pd(_mm_set1_pd(S3), _mm_mul_pd(z, ps));
+    ps = _mm_add_pd(_mm_set1_pd(S2), _mm_mul_pd(z, ps));
+    ps = _mm_add_pd(_mm_set1_pd(S1), _mm_mul_pd(z, ps));
+    const __m128d s = _mm_add_pd(r, _mm_mul_pd(_mm_mul_pd(z, r), ps));
+
+    __m128d pc = _mm_add_pd(_mm_set1_pd(C5), _mm_mul_pd(z, _mm_set1_pd(C6)));
+    pc = _mm_add_pd(_mm_set1_pd(C4), _mm_mul_pd(z, pc));
+    pc = _mm_add_pd(_mm_set1_pd(C3), _mm_mul_pd(z, pc));
+    pc = _mm_add_pd(_mm_set1_pd(C2), _mm_mul_pd(z, pc));
+    pc = _mm_add_pd(_mm_set1_pd(C1), _mm_mul_pd(z, pc));
+    const __m128d one = _mm_set1_pd(1.0);
+    const __m128d hz = _mm_mul_pd(_mm_set1_pd(0.5), z), w = _mm_sub_pd(one, hz);
+    const __m128d c = _mm_add_pd(w, _mm_add_pd(_mm_sub_pd(_mm_sub_pd(one, w), hz), _mm_mul_pd(z, _mm_mul_pd(z, pc))));
+
+    const __m128i q = _mm_sub_epi64(_mm_castpd_si128(t), _mm_castpd_si128(vmagic)); // n, as in the scalar kernel
+    const __m128i zero = _mm_setzero_si128(), bit = _mm_set1_epi64x(1);
+    const __m128d odd64 = _mm_castsi128_pd(_mm_sub_epi64(zero, _mm_and_si128(q, bit))); // all ones if n&1
+    const __m128d neg64 = _mm_castsi128_pd(_mm_sub_epi64(zero, _mm_and_si128(_mm_srli_epi64(q, 1), bit)));
+    const __m128d v = _mm_or_pd(_mm_and_pd(odd64, c), _mm_andnot_pd(odd64, s));
+    _mm_storeu_pd(y+i, _mm_xor_pd(v, _mm_and_pd(neg64, _mm_set1_pd(-0.0))));
+  }
+#endif
+  for (;i<n;i++)
+    y[i] = Math::sin(x[i]);
+}
+
+inline void pow(const double* x, const double* p, double* y, unsigned n) // y[i] = x[i]^p[i]; y may be x or p
+{
+  double t[laneBlock], other[laneBlock];
+  bool scalar[laneBlock];
+  for (unsigned b=0;b<n;b+=laneBlock) {
+    const unsigned m = (n-b<laneBlock) ? n-b : laneBlock;
+    for (unsigned i=0;i<m;i++) { // positive bases go through the batched log and exp, the others the scalar kernel
+      scalar[i] = !( (x[b+i]>0) && std::isfinite(p[b+i]) );
+      other[i] = scalar[i] ? Math::pow(x[b+i], p[b+i]) : 0;
+      t[i] = scalar[i] ? 1.0 : x[b+i];
+    }
+    Math::log(t, t, m);
+    for (unsigned i=0;i<m;i++)
+      t[i] *= p[b+i];
+    Math::exp(t, y+b, m);
+    for (unsigned i=0;i<m;i++)
+      if (scalar[i])
+        y[b+i] = other[i];
+  }
+}
+
+}; // namespace Math
+
+}; // namespace SlashA
+
+#endif // SLASHA_MATH_INCLUDED
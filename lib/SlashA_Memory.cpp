@@ -0,0 +1,78 @@
+/*
+ *
+ *  SlashA_Memory.cpp
+ *
+ *  Copyright (C) 2004-2011 Artur B Adib
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "SlashA_Memory.hpp"
+
+using namespace std;
+
+namespace SlashA
+{
+
+namespace AllocCount
+{
+  thread_local unsigned long long count = 0, bytes = 0;
+  bool linked = false;
+};
+
+
+/*
+ *
+ * Functions
+ *
+ */
+
+bool allocationCounting()
+{
+  return AllocCount::linked;
+}
+
+AllocationStats allocations()
+{
+  AllocationStats a;
+  a.count = AllocCount::count;
+  a.bytes = AllocCount::bytes;
+  return a;
+}
+
+size_t memoryBytes(const ByteCode& bc)
+{
+  return sizeof(bc) + bc.capacity()*sizeof(ByteCode_Type);
+}
+
+size_t memoryBytes(const ByteCode16& bc)
+{
+  return sizeof(bc) + bc.capacity()*sizeof(ByteCode16_Type);
+}
+
+size_t memoryBytes(const FitnessCases& cases)
+{
+  size_t n = sizeof(cases) + cases.capacity()*sizeof(cases[0]);
+  for (unsigned k=0;k<cases.size();k++)
+    n += cases[k].capacity()*sizeof(double);
+  return n;
+}
+
+size_t memoryBytes(const EvalResult& res)
+{
+  return sizeof(res) - sizeof(res.outputs) + memoryBytes(res.outputs); // outputs have the layout of FitnessCases
+}
+
+}; //namespace SlashA
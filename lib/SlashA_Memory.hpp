@@ -0,0 +1,130 @@
+/*
+ *
+ *  SlashA_Memory.hpp - memory footprint of the library's objects and allocation counting
+ *
+ *  Copyright (C) 2004-2011 Artur B Adib
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef SLASHA_MEMORY_INCLUDED // duplicate protection
+#define SLASHA_MEMORY_INCLUDED
+
+#include "SlashA.hpp"
+
+namespace SlashA
+{
+
+  /*
+   * memoryBytes() is the heap and object memory an object holds, from the capacities of its containers
+   * (InstructionSet, MemCore and EvalPool have it as a method). Hash table nodes are estimated.
+   *
+   * Allocations are counted per thread by replacements of the global operator new and delete. They are only
+   * linked in where asked for, so programs that do not count pay nothing: define SLASHA_COUNT_ALLOCATIONS
+   * before including this header in exactly one source file of the program. Without it the counters stay
+   * at zero and allocationCounting() is false.
+   */
+
+  class AllocationStats
+  {
+    public:
+      unsigned long long count; // calls to operator new
+      unsigned long long bytes; // requested
+
+      AllocationStats() : count(0), bytes(0) {}
+      AllocationStats operator-(const AllocationStats& a) const
+        { AllocationStats d; d.count = count-a.count; d.bytes = bytes-a.bytes; return d; }
+      void add(const AllocationStats& a) { count += a.count; bytes += a.bytes; }
+  };
+
+  bool allocationCounting(); // true if the counting operators are linked in
+  AllocationStats allocations(); // by the calling thread so far
+
+  class AllocationScope // allocations of the calling thread since the scope was opened
+  {
+    private:
+      AllocationStats start;
+    public:
+      AllocationScope() : start(allocations()) {}
+      AllocationStats elapsed() const { return allocations()-start; }
+  };
+
+  size_t memoryBytes(const ByteCode& bc);
+  size_t memoryBytes(const ByteCode16& bc);
+  size_t memoryBytes(const FitnessCases& cases);
+  size_t memoryBytes(const EvalResult& res);
+
+  namespace AllocCount // used by the counting operators
+  {
+    extern thread_local unsigned long long count, bytes;
+    extern bool linked;
+  };
+
+}; // namespace SlashA
+
+#ifdef SLASHA_COUNT_ALLOCATIONS
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+static const bool slasha_allocations_counted = (SlashA::AllocCount::linked = true);
+
+static inline void* slasha_counted_alloc(std::size_t n, std::size_t align)
+{
+  SlashA::AllocCount::count++;
+  SlashA::AllocCount::bytes += n;
+  if (n==0)
+    n = 1;
+  if (align<=alignof(std::max_align_t))
+    return std::malloc(n);
+  return std::aligned_alloc(align, (n+align-1)/align*align); // the size must be a multiple of the alignment
+}
+
+static inline void* slasha_counted_new(std::size_t n, std::size_t align)
+{
+  void* p = slasha_counted_alloc(n, align);
+  if (!p)
+    throw std::bad_alloc();
+  return p;
+}
+
+void* operator new(std::size_t n) { return slasha_counted_new(n, 0); }
+void* operator new[](std::size_t n) { return slasha_counted_new(n, 0); }
+void* operator new(std::size_t n, const std::nothrow_t&) noexcept { return slasha_counted_alloc(n, 0); }
+void* operator new[](std::size_t n, const std::nothrow_t&) noexcept { return slasha_counted_alloc(n, 0); }
+void* operator new(std::size_t n, std::align_val_t a) { return slasha_counted_new(n, (std::size_t)a); }
+void* operator new[](std::size_t n, std::align_val_t a) { return slasha_counted_new(n, (std::size_t)a); }
+void* operator new(std::size_t n, std::align_val_t a, const std::nothrow_t&) noexcept
+  { return slasha_counted_alloc(n, (std::size_t)a); }
+void* operator new[](std::size_t n, std::align_val_t a, const std::nothrow_t&) noexcept
+  { return slasha_counted_alloc(n, (std::size_t)a); }
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t) noexcept { std::free(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { std::free(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { std::free(p); }
+void operator delete(void* p, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t, std::align_val_t) noexcept { std::free(p); }
+void operator delete(void* p, std::align_val_t, const std::nothrow_t&) noexcept { std::free(p); }
+void operator delete[](void* p, std::align_val_t, const std::nothrow_t&) noexcept { std::free(p); }
+
+#endif // SLASHA_COUNT_ALLOCATIONS
+
+#endif // SLASHA_MEMORY_INCLUDED
@@ -0,0 +1,380 @@
+/*
+ *
+ *  SlashA_Metrics.cpp
+ *
+ *  Copyright (C) 2004-2011 Artur B Adib
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "SlashA_Metrics.hpp"
+
+using namespace std;
+
+namespace SlashA
+{
+
+atomic<bool> metricsOn(false);
+
+static const char* counterNames[METRIC_N_COUNTERS] = {
+  "slasha_programs_total",
+  "slasha_fitness_cases_total",
+  "slasha_instructions_total",
+  "slasha_invalid_instructions_total",
+  "slasha_timeouts_total",
+  "slasha_loop_depth_aborts_total",
+  "slasha_parsed_bytes_total",
+  "slasha_parsed_programs_total"
+};
+
+static const char* histogramNames[METRIC_N_HISTOGRAMS] = {
+  "slasha_eval_seconds",
+  "slasha_parse_seconds"
+};
+
+
+/*
+ *
+ * Class methods
+ *
+ */
+
+//
+//  Class: MetricsShard
+//
+
+MetricsShard::MetricsShard()
+{
+  for (unsigned m=0;m<METRIC_N_COUNTERS;m++)
+    counter[m] = 0;
+  for (unsigned h=0;h<METRIC_N_HISTOGRAMS;h++) {
+    for (unsigned b=0;b<metricBuckets;b++)
+      bucket[h][b] = 0;
+    sum_ns[h] = 0;
+  }
+}
+
+void MetricsShard::observe(MetricHistogram h, uint64_t ns)
+{
+  unsigned b = ns ? 63-__builtin_clzll(ns) : 0; // floor(log2(ns))
+  if (b>=metricBuckets)
+    b = metricBuckets-1;
+  bump(bucket[h][b], 1);
+  bump(sum_ns[h], ns);
+}
+
+//
+//  Class: MetricsSnapshot
+//
+
+uint64_t MetricsSnapshot::count(MetricHistogram h) const
+{
+  uint64_t n=0;
+  for (unsigned b=0;b<metricBuckets;b++)
+    n += bucket[h][b];
+  return n;
+}
+
+double MetricsSnapshot::rate(MetricCounter m, const MetricsSnapshot& prev) const
+{
+  double dt = chrono::duration<double>(taken-prev.taken).count();
+  if (dt<=0.0)
+    return 0.0;
+  return (counter[m]-prev.counter[m])/dt;
+}
+
+//
+//  Class: MetricsRegistry
+//
+
+MetricsRegistry::MetricsRegistry() {}
+
+MetricsRegistry::~MetricsRegistry()
+{
+  // The shards are not freed: a thread still running (or a static destructor) may hold a pointer to its own
+}
+
+class MetricsRegistry::ThreadShard
+{
+  public:
+    MetricsRegistry* registry; // metrics(), which is never destroyed, so it outlives every thread
+    MetricsShard* shard;
+
+    ThreadShard() : registry(NULL), shard(NULL) {}
+    ~ThreadShard()
+    {
+      if (shard) {
+        lock_guard<mutex> lock(registry->mtx);
+        registry->free_shards.push_back(shard);
+      }
+    }
+};
+
+MetricsShard& MetricsRegistry::threadShard()
+{
+  static thread_local ThreadShard holder;
+
+  if (!holder.shard) {
+    lock_guard<mutex> lock(mtx);
+    holder.registry = this;
+    if (free_shards.empty()) {
+      shards.push_back(new MetricsShard);
+      holder.shard = shards.back();
+    }
+    else { // its counts stay, since snapshot() sums them; the mutex orders our writes after its last owner's
+      holder.shard = free_shards.back();
+      free_shards.pop_back();
+    }
+  }
+  return *holder.shard;
+}
+
+MetricsSnapshot MetricsRegistry::snapshot()
+{
+  MetricsSnapshot s;
+  memset(s.counter, 0, sizeof(s.counter));
+  memset(s.bucket, 0, sizeof(s.bucket));
+  memset(s.sum_ns, 0, sizeof(s.sum_ns));
+
+  lock_guard<mutex> lock(mtx);
+  s.taken = chrono::steady_clock::now();
+  for (unsigned i=0;i<shards.size();i++) {
+    const MetricsShard& sh = *shards[i];
+    for (unsigned m=0;m<METRIC_N_COUNTERS;m++)
+      s.counter[m] += sh.counter[m].load(memory_order_relaxed);
+    for (unsigned h=0;h<METRIC_N_HISTOGRAMS;h++) {
+      for (unsigned b=0;b<metricBuckets;b++)
+        s.bucket[h][b] += sh.bucket[h][b].load(memory_order_relaxed);
+      s.sum_ns[h] += sh.sum_ns[h].load(memory_order_relaxed);
+    }
+  }
+  return s;
+}
+
+//
+//  Class: MetricsExporter
+//
+
+MetricsExporter::MetricsExporter(const string& _target, unsigned _period_ms, MetricsFormat _format)
+{
+  target = _target;
+  period_ms = _period_ms ? _period_ms : 1;
+  format = _format;
+  stopping = false;
+  has_prev = false;
+  th = thread(&MetricsExporter::run, this);
+}
+
+MetricsExporter::~MetricsExporter()
+{
+  {
+    lock_guard<mutex> lock(mtx);
+    stopping = true;
+  }
+  cv.notify_all();
+  th.join();
+  exportNow();
+}
+
+void MetricsExporter::run()
+{
+  unique_lock<mutex> lock(mtx);
+  while (!stopping) {
+    cv.wait_for(lock, chrono::milliseconds(period_ms));
+    if (stopping)
+      break;
+    lock.unlock();
+    exportNow();
+    lock.lock();
+  }
+}
+
+static bool writeAll(int fd, const string& text)
+{
+  const char* p = text.data();
+  size_t left = text.size();
+  while (left>0) {
+    ssize_t n = write(fd, p, left);
+    if (n<=0)
+      return false;
+    p += n;
+    left -= n;
+  }
+  return true;
+}
+
+bool MetricsExporter::exportNow()
+{
+  lock_guard<mutex> lock(export_mtx);
+  MetricsSnapshot s = metrics().snapshot();
+  string text = (format==METRICS_JSON) ? metricsJSON(s, has_prev ? &prev : NULL)
+                                       : metricsPrometheus(s, has_prev ? &prev : NULL);
+  prev = s;
+  has_prev = true;
+
+  bool ok;
+  if (target.compare(0, 5, "unix:")==0) {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, target.c_str()+5, sizeof(addr.sun_path)-1);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd<0)
+      return false;
+    ok = (connect(fd, (struct sockaddr*)&addr, sizeof(addr))==0) && writeAll(fd, text);
+    close(fd);
+  }
+  else { // written aside and renamed, so readers never see a partial file
+    string tmp = target + ".tmp";
+    int fd = open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd<0)
+      return false;
+    ok = writeAll(fd, text);
+    ok = (close(fd)==0) && ok;
+    ok = ok && (rename(tmp.c_str(), target.c_str())==0);
+  }
+  return ok;
+}
+
+
+/*
+ *
+ * Functions
+ *
+ */
+
+MetricsRegistry& metrics()
+{
+  static MetricsRegistry* registry = new MetricsRegistry; // never destroyed, for threads that outlive main()
+  return *registry;
+}
+
+void enableMetrics(bool on)
+{
+  if (on)
+    metrics(); // constructed before any thread records
+  metricsOn = on;
+}
+
+void recordEvaluation(uint64_t t0, unsigned n_cases, uint64_t n_ops, uint64_t n_invops,
+                      unsigned n_timeouts, unsigned n_loop_aborts)
+{
+  MetricsShard& sh = metrics().threadShard();
+  sh.add(METRIC_PROGRAMS, 1);
+  sh.add(METRIC_CASES, n_cases);
+  sh.add(METRIC_OPS, n_ops);
+  sh.add(METRIC_INVOPS, n_invops);
+  if (n_timeouts)
+    sh.add(METRIC_TIMEOUTS, n_timeouts);
+  if (n_loop_aborts)
+    sh.add(METRIC_LOOP_ABORTS, n_loop_aborts);
+  sh.observe(METRIC_EVAL_LATENCY, metricsClock()-t0);
+}
+
+void recordParse(uint64_t t0, uint64_t n_bytes, uint64_t n_programs)
+{
+  MetricsShard& sh = metrics().threadShard();
+  sh.add(METRIC_PARSED_BYTES, n_bytes);
+  sh.add(METRIC_PARSED_PROGRAMS, n_programs);
+  sh.observe(METRIC_PARSE_LATENCY, metricsClock()-t0);
+}
+
+string metricsPrometheus(const MetricsSnapshot& s, const MetricsSnapshot* prev)
+{
+  string out;
+  char buf[512];
+
+  for (unsigned m=0;m<METRIC_N_COUNTERS;m++) {
+    snprintf(buf, sizeof(buf), "# TYPE %s counter\n%s %llu\n", counterNames[m], counterNames[m],
+             (unsigned long long)s.counter[m]);
+    out += buf;
+  }
+
+  for (unsigned h=0;h<METRIC_N_HISTOGRAMS;h++) {
+    const char* name = histogramNames[h];
+    snprintf(buf, sizeof(buf), "# TYPE %s histogram\n", name);
+    out += buf;
+    uint64_t cumulative = 0;
+    for (unsigned b=0;b<metricBuckets-1;b++) {
+      cumulative += s.bucket[h][b];
+      snprintf(buf, sizeof(buf), "%s_bucket{le=\"%.9g\"} %llu\n", name, (double)(2ULL<<b)*1e-9,
+               (unsigned long long)cumulative);
+      out += buf;
+    }
+    snprintf(buf, sizeof(buf), "%s_bucket{le=\"+Inf\"} %llu\n%s_sum %.9g\n%s_count %llu\n",
+             name, (unsigned long long)s.count((MetricHistogram)h), name, s.sum_ns[h]*1e-9,
+             name, (unsigned long long)s.count((MetricHistogram)h));
+    out += buf;
+  }
+
+  double ops = (double)s.counter[METRIC_OPS];
+  snprintf(buf, sizeof(buf), "# TYPE slasha_invalid_instruction_ratio gauge\nslasha_invalid_instruction_ratio %.6g\n",
+           ops>0 ? s.counter[METRIC_INVOPS]/ops : 0.0);
+  out += buf;
+
+  if (prev) {
+    snprintf(buf, sizeof(buf),
+             "# TYPE slasha_programs_per_second gauge\nslasha_programs_per_second %.6g\n"
+             "# TYPE slasha_instructions_per_second gauge\nslasha_instructions_per_second %.6g\n"
+             "# TYPE slasha_parsed_bytes_per_second gauge\nslasha_parsed_bytes_per_second %.6g\n",
+             s.rate(METRIC_PROGRAMS, *prev), s.rate(METRIC_OPS, *prev), s.rate(METRIC_PARSED_BYTES, *prev));
+    out += buf;
+  }
+  return out;
+}
+
+string metricsJSON(const MetricsSnapshot& s, const MetricsSnapshot* prev)
+{
+  string out = "{";
+  char buf[512];
+
+  for (unsigned m=0;m<METRIC_N_COUNTERS;m++) {
+    snprintf(buf, sizeof(buf), "\"%s\":%llu,", counterNames[m], (unsigned long long)s.counter[m]);
+    out += buf;
+  }
+
+  for (unsigned h=0;h<METRIC_N_HISTOGRAMS;h++) {
+    snprintf(buf, sizeof(buf), "\"%s\":{\"count\":%llu,\"sum\":%.9g,\"buckets_ns_log2\":[", histogramNames[h],
+             (unsigned long long)s.count((MetricHistogram)h), s.sum_ns[h]*1e-9);
+    out += buf;
+    for (unsigned b=0;b<metricBuckets;b++) {
+      snprintf(buf, sizeof(buf), b ? ",%llu" : "%llu", (unsigned long long)s.bucket[h][b]);
+      out += buf;
+    }
+    out += "]},";
+  }
+
+  double ops = (double)s.counter[METRIC_OPS];
+  snprintf(buf, sizeof(buf), "\"slasha_invalid_instruction_ratio\":%.6g", ops>0 ? s.counter[METRIC_INVOPS]/ops : 0.0);
+  out += buf;
+
+  if (prev) {
+    snprintf(buf, sizeof(buf), ",\"slasha_programs_per_second\":%.6g,\"slasha_instructions_per_second\":%.6g,"
+             "\"slasha_parsed_bytes_per_second\":%.6g",
+             s.rate(METRIC_PROGRAMS, *prev), s.rate(METRIC_OPS, *prev), s.rate(METRIC_PARSED_BYTES, *prev));
+    out += buf;
+  }
+  out += "}\n";
+  return out;
+}
+
+}; //namespace SlashA
@@ -0,0 +1,167 @@
+/*
+ *
+ *  SlashA_Metrics.hpp - evaluation-throughput metrics and their periodic export
+ *
+ *  Copyright (C) 2004-2011 Artur B Adib
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef SLASHA_METRICS_INCLUDED // duplicate protection
+#define SLASHA_METRICS_INCLUDED
+
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <string>
+#include <vector>
+
+namespace SlashA
+{
+
+  /*
+   * Metrics are off until enableMetrics() is called. Once on, the library's evaluation and parsing entry
+   * points (runByteCode(), runFitnessCases(), AsyncEvaluator, parseArchive()...) add to a shard owned by the
+   * calling thread. Only that thread writes to its shard, so updates are plain relaxed stores with no
+   * locking or read-modify-write; exporters sum the shards of all threads, including finished ones. The
+   * shard of a finished thread, counts and all, is handed to the next thread that records, so there are
+   * never more shards than threads that have recorded at the same time.
+   */
+
+  enum MetricCounter
+  {
+    METRIC_PROGRAMS, // programs evaluated (a program run over all its fitness cases counts once)
+    METRIC_CASES, // fitness cases run
+    METRIC_OPS, // Slash/A instructions executed
+    METRIC_INVOPS, // of which invalid
+    METRIC_TIMEOUTS,
+    METRIC_LOOP_ABORTS, // runs stopped for exceeding the maximum loop depth
+    METRIC_PARSED_BYTES,
+    METRIC_PARSED_PROGRAMS,
+    METRIC_N_COUNTERS
+  };
+
+  enum MetricHistogram
+  {
+    METRIC_EVAL_LATENCY, // per program
+    METRIC_PARSE_LATENCY, // per parse call (a whole archive counts once)
+    METRIC_N_HISTOGRAMS
+  };
+
+  const unsigned metricBuckets = 40; // bucket b holds latencies in [2^b, 2^(b+1)) ns
+
+  class MetricsShard
+  {
+    private:
+      std::atomic<uint64_t> counter[METRIC_N_COUNTERS];
+      std::atomic<uint64_t> bucket[METRIC_N_HISTOGRAMS][metricBuckets];
+      std::atomic<uint64_t> sum_ns[METRIC_N_HISTOGRAMS];
+
+      static inline void bump(std::atomic<uint64_t>& a, uint64_t n) // single writer
+      { a.store(a.load(std::memory_order_relaxed)+n, std::memory_order_relaxed); }
+
+      friend class MetricsRegistry;
+    public:
+      MetricsShard();
+
+      inline void add(MetricCounter m, uint64_t n) { bump(counter[m], n); }
+      void observe(MetricHistogram h, uint64_t ns);
+  } __attribute__ ((aligned (64)));
+
+  class MetricsSnapshot
+  {
+    public:
+      uint64_t counter[METRIC_N_COUNTERS];
+      uint64_t bucket[METRIC_N_HISTOGRAMS][metricBuckets];
+      uint64_t sum_ns[METRIC_N_HISTOGRAMS];
+      std::chrono::steady_clock::time_point taken;
+
+      uint64_t count(MetricHistogram h) const;
+      double rate(MetricCounter m, const MetricsSnapshot& prev) const; // per second since prev
+  };
+
+  class MetricsRegistry
+  {
+    private:
+      class ThreadShard; // returns the shard of a thread to free_shards when the thread exits
+
+      std::mutex mtx; // only taken when a thread takes or returns its shard and on snapshots
+      std::vector<MetricsShard*> shards;
+      std::vector<MetricsShard*> free_shards; // of finished threads, still counted by snapshot()
+    public:
+      MetricsRegistry();
+      ~MetricsRegistry();
+
+      MetricsShard& threadShard(); // the calling thread's shard, taken on first use
+      MetricsSnapshot snapshot();
+  };
+
+  /* Functions */
+
+  MetricsRegistry& metrics(); // the process-wide registry
+
+  extern std::atomic<bool> metricsOn;
+  inline bool metricsEnabled() { return metricsOn.load(std::memory_order_relaxed); }
+  void enableMetrics(bool on = true);
+
+  inline uint64_t metricsClock() // ns, for the latency histograms
+  { return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count(); }
+
+  // Adds one evaluated program (latency measured from t0, a metricsClock() value) to the calling thread's shard
+  void recordEvaluation(uint64_t t0, unsigned n_cases, uint64_t n_ops, uint64_t n_invops,
+                        unsigned n_timeouts, unsigned n_loop_aborts);
+
+  void recordParse(uint64_t t0, uint64_t n_bytes, uint64_t n_programs);
+
+  // prev (may be NULL) is the previous export, used for the per-second rates
+  std::string metricsPrometheus(const MetricsSnapshot& s, const MetricsSnapshot* prev);
+  std::string metricsJSON(const MetricsSnapshot& s, const MetricsSnapshot* prev);
+
+  enum MetricsFormat { METRICS_PROMETHEUS, METRICS_JSON };
+
+  /*
+   * Writes the registry every period_ms to a file (replaced atomically, e.g. for the Prometheus node
+   * exporter's textfile collector) or, for a target "unix:/path", to a Unix stream socket listening
+   * there (one connection per export). Export errors are ignored so the run is never disturbed.
+   * The last export is made by the destructor.
+   */
+  class MetricsExporter
+  {
+    private:
+      std::string target;
+      unsigned period_ms;
+      MetricsFormat format;
+      std::thread th;
+      std::mutex mtx;
+      std::condition_variable cv;
+      bool stopping;
+      std::mutex export_mtx; // exportNow() may also be called by the user
+      MetricsSnapshot prev;
+      bool has_prev;
+
+      void run();
+    public:
+      MetricsExporter(const std::string& _target, unsigned _period_ms, MetricsFormat _format = METRICS_PROMETHEUS);
+      ~MetricsExporter();
+
+      bool exportNow(); // returns false if the target could not be written
+  };
+
+}; // namespace SlashA
+
+#endif // SLASHA_METRICS_INCLUDED
@@ -0,0 +1,91 @@
+/*
+ *
+ *  SlashA_Partial.cpp
+ *
+ *  Copyright (C) 2004-2011 Artur B Adib
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "SlashA_Partial.hpp"
+
+using namespace std;
+
+namespace SlashA
+{
+
+// DIS instructions whose effect depends only on the registers and tapes
+static const char* foldable[] = {
+  "output", "load", "save", "swap", "cmp", "inc", "dec", "itof", "ftoi",
+  "add", "sub", "mul", "div", "abs", "sign", "exp", "log", "sin", "pow",
+  "rsum", "dot", "rscale", "horner", "nop"
+};
+
+
+/*
+ *
+ * Functions
+ *
+ */
+
+bool isFoldable(ByteCode_Type inst, InstructionSet& iset)
+{
+  if (inst<iset.numericInstructions()) // numeric instructions set I
+    return true;
+  if ( (inst>=iset.size()) || (!iset.isDIS(inst)) )
+    return false;
+  for (unsigned i=0;i<sizeof(foldable)/sizeof(foldable[0]);i++)
+    if (iset.is(inst, foldable[i]))
+      return true;
+  return false;
+}
+
+bool isStateOnly(ByteCode_Type inst, InstructionSet& iset)
+{
+  if (isFoldable(inst, iset))
+    return true;
+  return (inst<iset.size()) && (iset.is(inst, "input") || iset.is(inst, "ran"));
+}
+
+unsigned partialEvaluate(InstructionSet& iset,
+                         const ByteCode& bc,
+                         unsigned D_size,
+                         unsigned L_size,
+                         ResidualProgram& rp)
+{
+  unsigned n = 0;
+  while ( (n<bc.size()) && isFoldable(bc[n], iset) )
+    n++;
+
+  ByteCode prefix(bc.begin(), bc.begin()+n);
+  rp.bc.assign(bc.begin()+n, bc.end());
+  rp.prefix_length = n;
+
+  // any non-empty input makes output() append to the buffer; no input instruction is run
+  vector<double> input(1, 0.0), output;
+  MemCore core(D_size, L_size, input, output);
+  core.reset();
+
+  atomic<bool> stop(false);
+  runByteCodeUntil(iset, core, prefix, 0, stop, -1); // the prefix cannot fail: it has no loops
+
+  rp.prefix_ops = iset.getTotalOps();
+  rp.prefix_invops = iset.getTotalInvops();
+  core.save(rp.state);
+
+  return n;
+}
+
+}; //namespace SlashA
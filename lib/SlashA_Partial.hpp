@@ -0,0 +1,83 @@
+/*
+ *
+ *  SlashA_Partial.hpp - partial evaluation of the input-independent prefix of a program
+ *
+ *  Copyright (C) 2004-2011 Artur B Adib
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef SLASHA_PARTIAL_INCLUDED // duplicate protection
+#define SLASHA_PARTIAL_INCLUDED
+
+#include "SlashA.hpp"
+
+namespace SlashA
+{
+
+  /*
+   * Evolved programs often start with setup that does not depend on the input or on ran(), e.g.
+   * "7/itof/0/save/10/itof/0/pow/save". The partial evaluator runs that prefix once and keeps the state it
+   * leaves behind (registers, tapes and outputs), so each fitness case only runs the rest of the program.
+   *
+   * The prefix ends at the first instruction that is not a DIS data instruction: input, ran, any flow
+   * control (label, gotoifp, jumpifn, jumphere, loop, endloop) and every user-defined instruction end it.
+   * Flow control is never folded, so the loop and jump tables of the residual program are the same as
+   * those of the original.
+   */
+
+  class ResidualProgram
+  {
+    public:
+      ByteCode bc; // the program after the folded prefix
+      CoreState state; // state after the prefix, including its outputs
+      unsigned prefix_length; // number of instructions folded
+      unsigned prefix_ops; // instructions executed by the prefix (not counted again when the residual runs)
+      unsigned prefix_invops;
+  };
+
+  /* Functions */
+
+  bool isFoldable(ByteCode_Type inst, InstructionSet& iset); // true for instructions the prefix may hold
+
+  // Foldable, input or ran: the instruction only acts on the registers, tapes, I/O positions and random
+  // generator of the core, so a run may stop before it and resume from a snapshot of the core
+  bool isStateOnly(ByteCode_Type inst, InstructionSet& iset);
+
+  // Builds the residual program of bc for cores of the given tape sizes. Returns the prefix length
+  // (0 if nothing could be folded, in which case rp.bc is bc and rp.state a reset core).
+  unsigned partialEvaluate(InstructionSet& iset,
+                           const ByteCode& bc,
+                           unsigned D_size,
+                           unsigned L_size,
+                           ResidualProgram& rp);
+
+  // Same results as running the original program over the cases with runFitnessCases(), except that
+  // res.n_ops and res.n_invops leave out the prefix (rp.prefix_ops per case).
+  inline bool runFitnessCases(InstructionSet& iset,
+                              MemCore& core,
+                              ResidualProgram& rp,
+                              FitnessCases& cases,
+                              long randseed,
+                              const std::atomic<bool>& stop,
+                              int max_loop_depth,
+                              EvalResult& res)
+  {
+    return runFitnessCases(iset, core, rp.bc, rp.state, cases, randseed, stop, max_loop_depth, res);
+  }
+
+}; // namespace SlashA
+
+#endif // SLASHA_PARTIAL_INCLUDED
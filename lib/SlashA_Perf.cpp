@@ -0,0 +1,204 @@
+/*
+ *
+ *  SlashA_Perf.cpp
+ *
+ *  Copyright (C) 2004-2011 Artur B Adib
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <cstring>
+#include <cstdio>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+#include "SlashA_Perf.hpp"
+
+using namespace std;
+
+namespace SlashA
+{
+
+
+/*
+ *
+ * Class methods
+ *
+ */
+
+//
+//  Class: PerfSample
+//
+
+void PerfSample::clear()
+{
+  for (unsigned e=0;e<PERF_N_EVENTS;e++) {
+    count[e] = 0;
+    valid[e] = true; // the identity for add()
+  }
+  n_ops = 0;
+}
+
+void PerfSample::add(const PerfSample& s)
+{
+  for (unsigned e=0;e<PERF_N_EVENTS;e++) {
+    count[e] += s.count[e];
+    valid[e] = valid[e] && s.valid[e];
+  }
+  n_ops += s.n_ops;
+}
+
+double PerfSample::ipc() const
+{
+  if (!valid[PERF_CYCLES] || !valid[PERF_INSTRUCTIONS] || count[PERF_CYCLES]==0)
+    return 0.0;
+  return (double)count[PERF_INSTRUCTIONS]/count[PERF_CYCLES];
+}
+
+double PerfSample::perOp(PerfEvent ev) const
+{
+  if (!valid[ev] || n_ops==0)
+    return 0.0;
+  return (double)count[ev]/n_ops;
+}
+
+string PerfSample::summary() const
+{
+  static const char* names[PERF_N_EVENTS] = { "cycles", "instructions", "branch-misses", "LLC-misses" };
+  char buf[128];
+  string s;
+
+  snprintf(buf, sizeof(buf), "ops=%lu", n_ops);
+  s += buf;
+  if (valid[PERF_CYCLES] && valid[PERF_INSTRUCTIONS]) {
+    snprintf(buf, sizeof(buf), " IPC=%.2f", ipc());
+    s += buf;
+  }
+  else
+    s += " IPC=n/a";
+
+  for (unsigned e=0;e<PERF_N_EVENTS;e++) {
+    if (valid[e])
+      snprintf(buf, sizeof(buf), " %s=%llu (%.2f/op)", names[e], (unsigned long long)count[e], perOp((PerfEvent)e));
+    else
+      snprintf(buf, sizeof(buf), " %s=n/a", names[e]);
+    s += buf;
+  }
+  return s;
+}
+
+//
+//  Class: PerfCounters
+//
+
+#ifdef __linux__
+
+struct PerfRead // layout for PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING
+{
+  uint64_t value;
+  uint64_t time_enabled;
+  uint64_t time_running;
+};
+
+static int openEvent(uint32_t type, uint64_t config)
+{
+  struct perf_event_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = type;
+  attr.config = config;
+  attr.disabled = 1;
+  attr.exclude_kernel = 1; // allowed at perf_event_paranoid<=2
+  attr.exclude_hv = 1;
+  attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+  return syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0); // this thread, any CPU
+}
+
+PerfCounters::PerfCounters()
+{
+  fd[PERF_CYCLES] = openEvent(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+  fd[PERF_INSTRUCTIONS] = openEvent(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+  fd[PERF_BRANCH_MISSES] = openEvent(PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+  fd[PERF_LLC_MISSES] = openEvent(PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_LL |
+                                                      (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                                                      (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+}
+
+PerfCounters::~PerfCounters()
+{
+  for (unsigned e=0;e<PERF_N_EVENTS;e++)
+    if (fd[e]>=0)
+      close(fd[e]);
+}
+
+void PerfCounters::start()
+{
+  for (unsigned e=0;e<PERF_N_EVENTS;e++)
+    if (fd[e]>=0) {
+      ioctl(fd[e], PERF_EVENT_IOC_RESET, 0);
+      ioctl(fd[e], PERF_EVENT_IOC_ENABLE, 0);
+    }
+}
+
+void PerfCounters::stop(PerfSample& s)
+{
+  for (unsigned e=0;e<PERF_N_EVENTS;e++)
+    if (fd[e]>=0)
+      ioctl(fd[e], PERF_EVENT_IOC_DISABLE, 0);
+
+  for (unsigned e=0;e<PERF_N_EVENTS;e++) {
+    PerfRead r;
+    s.count[e] = 0;
+    s.valid[e] = (fd[e]>=0) && (read(fd[e], &r, sizeof(r))==sizeof(r)) && (r.time_running>0);
+    if (s.valid[e]) // scales up if the kernel had to multiplex the counters
+      s.count[e] = (r.time_running<r.time_enabled) ? (uint64_t)((double)r.value*r.time_enabled/r.time_running) : r.value;
+  }
+}
+
+#else // no perf events: every event reads as invalid
+
+PerfCounters::PerfCounters()
+{
+  for (unsigned e=0;e<PERF_N_EVENTS;e++)
+    fd[e] = -1;
+}
+
+PerfCounters::~PerfCounters() {}
+
+void PerfCounters::start() {}
+
+void PerfCounters::stop(PerfSample& s)
+{
+  for (unsigned e=0;e<PERF_N_EVENTS;e++) {
+    s.count[e] = 0;
+    s.valid[e] = false;
+  }
+}
+
+#endif
+
+bool PerfCounters::available() const
+{
+  for (unsigned e=0;e<PERF_N_EVENTS;e++)
+    if (fd[e]>=0)
+      return true;
+  return false;
+}
+
+}; //namespace SlashA
@@ -0,0 +1,71 @@
+/*
+ *
+ *  SlashA_Perf.hpp - hardware performance counters around evaluation batches (Linux)
+ *
+ *  Copyright (C) 2004-2011 Artur B Adib
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef SLASHA_PERF_INCLUDED // duplicate protection
+#define SLASHA_PERF_INCLUDED
+
+#include <stdint.h>
+#include <string>
+
+namespace SlashA
+{
+
+  enum PerfEvent { PERF_CYCLES, PERF_INSTRUCTIONS, PERF_BRANCH_MISSES, PERF_LLC_MISSES, PERF_N_EVENTS };
+
+  class PerfSample // counts over some interval, plus the Slash/A instructions executed in it
+  {
+    public:
+      uint64_t count[PERF_N_EVENTS];
+      bool valid[PERF_N_EVENTS]; // false if the event could not be counted
+      unsigned long n_ops; // Slash/A instructions executed (filled in by the caller)
+
+      PerfSample() { clear(); }
+      void clear();
+      void add(const PerfSample& s); // an event stays valid only if it is valid in both samples
+
+      double ipc() const; // machine instructions per cycle, 0 if unknown
+      double perOp(PerfEvent ev) const; // count per Slash/A instruction, 0 if unknown
+      std::string summary() const; // one line, unknown events shown as "n/a"
+  };
+
+  /*
+   * Counts the four events for the calling thread only (user space, multiplexing scaled out). Each event is
+   * opened on its own, so a machine or container lacking e.g. LLC counters still reports the others. If
+   * perf_event_open() is unavailable altogether, start()/stop() do nothing and every event reads as invalid.
+   */
+  class PerfCounters
+  {
+    private:
+      int fd[PERF_N_EVENTS];
+      PerfCounters(const PerfCounters&); // not copyable
+      PerfCounters& operator=(const PerfCounters&);
+    public:
+      PerfCounters(); // must be constructed on the thread to be measured
+      ~PerfCounters();
+
+      bool available() const; // true if at least one event can be counted
+      void start();
+      void stop(PerfSample& s); // s.count/s.valid are overwritten, s.n_ops is left alone
+  };
+
+}; // namespace SlashA
+
+#endif // SLASHA_PERF_INCLUDED
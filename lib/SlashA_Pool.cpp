@@ -0,0 +1,553 @@
+/*
+ *
+ *  SlashA_Pool.cpp
+ *
+ *  Copyright (C) 2004-2011 Artur B Adib
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sched.h>
+#include <pthread.h>
+#include "SlashA_Pool.hpp"
+#include "SlashA_Metrics.hpp"
+
+using namespace std;
+
+namespace SlashA
+{
+
+
+/*
+ *
+ * Class methods
+ *
+ */
+
+//
+//  Class: NumaTopology
+//
+
+// Parses a kernel CPU list such as "0-3,8-11"
+static vector<unsigned> parseCpuList(const string& list)
+{
+  vector<unsigned> cpus;
+  const char* p = list.c_str();
+
+  while (*p) {
+    char* end;
+    unsigned long first = strtoul(p, &end, 10);
+    if (end==p)
+      break;
+    unsigned long last = first;
+    p = end;
+    if (*p=='-') {
+      last = strtoul(p+1, &end, 10);
+      p = end;
+    }
+    for (unsigned long c=first;c<=last;c++)
+      cpus.push_back(c);
+    if (*p==',')
+      p++;
+    else
+      break;
+  }
+  return cpus;
+}
+
+NumaTopology NumaTopology::discover()
+{
+  NumaTopology topo;
+
+  vector<unsigned> allowed;
+  cpu_set_t mask;
+  CPU_ZERO(&mask);
+  if (sched_getaffinity(0, sizeof(mask), &mask)==0) {
+    for (unsigned c=0;c<CPU_SETSIZE;c++)
+      if (CPU_ISSET(c, &mask))
+        allowed.push_back(c);
+  }
+  if (allowed.size()==0) {
+    unsigned n = thread::hardware_concurrency();
+    for (unsigned c=0;c<(n ? n : 1);c++)
+      allowed.push_back(c);
+  }
+
+  for (unsigned node=0;node<1024;node++) { // node numbers may have gaps, hence no early exit on a missing node
+    char path[64];
+    snprintf(path, sizeof(path), "/sys/devices/system/node/node%u/cpulist", node);
+    ifstream f(path);
+    if (!f)
+      continue;
+    string list;
+    getline(f, list);
+
+    vector<unsigned> cpus = parseCpuList(list), usable;
+    for (unsigned i=0;i<cpus.size();i++)
+      if ( (cpus[i]<CPU_SETSIZE) && CPU_ISSET(cpus[i], &mask) )
+        usable.push_back(cpus[i]);
+    if (usable.size()>0)
+      topo.node_cpus.push_back(usable);
+  }
+
+  if (topo.node_cpus.size()==0) // no NUMA information: everything is one node
+    topo.node_cpus.push_back(allowed);
+
+  return topo;
+}
+
+unsigned NumaTopology::cpus() const
+{
+  unsigned n=0;
+  for (unsigned i=0;i<node_cpus.size();i++)
+    n += node_cpus[i].size();
+  return n;
+}
+
+//
+//  Class: EvalPool
+//
+
+struct EvalPool::Worker
+{
+  thread th;
+  int cpu; // -1: not pinned
+  unsigned node;
+  bool first_on_node; // allocates the node's replica of the fitness cases
+  PerfSample perf; // last batch
+  EvalResult counts; // evaluateCases(): this worker's share of the counters
+  unsigned loop_aborts;
+  size_t bytes; // instruction set, core and program copy
+  AllocationStats allocs; // last batch
+};
+
+struct EvalPool::Node
+{
+  FitnessCases* cases; // node-local replica
+  atomic<unsigned> next; // next program of the node's slice
+  unsigned end;
+  Node() : cases(NULL), next(0), end(0) {}
+};
+
+EvalPool::EvalPool(ISetFactory _make_iset,
+                   FitnessCases& _cases,
+                   unsigned _D_size,
+                   unsigned _L_size,
+                   unsigned n_threads,
+                   bool pin)
+  : stop(false)
+{
+  make_iset = _make_iset;
+  cases = &_cases;
+  D_size = _D_size;
+  L_size = _L_size;
+  batch_id = 0;
+  n_ready = n_done = 0;
+  shutting_down = false;
+  programs = NULL;
+  results = NULL;
+  program = NULL;
+  result = NULL;
+  randseed = 0;
+  max_loop_depth = -1;
+  perf_enabled = false;
+
+  topology = NumaTopology::discover();
+  if (!pin) { // one node, no affinity
+    NumaTopology flat;
+    flat.node_cpus.push_back(vector<unsigned>(1, 0));
+    if (n_threads==0)
+      n_threads = topology.cpus();
+    topology = flat;
+  }
+  if (n_threads==0)
+    n_threads = topology.cpus();
+
+  for (unsigned n=0;n<topology.nodes();n++)
+    node_state.push_back(new Node);
+
+  // deals CPUs round-robin over the nodes, so a partial pool still uses every socket
+  vector<unsigned> used(topology.nodes(), 0);
+  for (unsigned i=0;i<n_threads;i++) {
+    Worker* w = new Worker;
+    w->node = i % topology.nodes();
+    const vector<unsigned>& cpus = topology.node_cpus[w->node];
+    w->cpu = pin ? (int)cpus[used[w->node] % cpus.size()] : -1;
+    w->first_on_node = (used[w->node]==0);
+    w->bytes = 0;
+    used[w->node]++;
+    workers.push_back(w);
+  }
+
+  for (unsigned i=0;i<workers.size();i++)
+    workers[i]->th = thread(&EvalPool::workerLoop, this, workers[i]);
+
+  unique_lock<mutex> lock(mtx);
+  while (n_ready<workers.size()) // replicas and cores are allocated by now
+    done_cv.wait(lock);
+}
+
+EvalPool::~EvalPool()
+{
+  {
+    lock_guard<mutex> lock(mtx);
+    shutting_down = true;
+  }
+  start_cv.notify_all();
+
+  for (unsigned i=0;i<workers.size();i++) {
+    workers[i]->th.join();
+    delete workers[i];
+  }
+  for (unsigned n=0;n<node_state.size();n++) {
+    delete node_state[n]->cases;
+    delete node_state[n];
+  }
+}
+
+void EvalPool::evaluate(vector<ByteCode>& _programs,
+                        vector<EvalResult>& _results,
+                        long _randseed,
+                        int _max_loop_depth)
+{
+  lock_guard<mutex> call(call_mtx);
+  unique_lock<mutex> lock(mtx);
+
+  programs = &_programs;
+  results = &_results;
+  program = NULL;
+  randseed = _randseed;
+  max_loop_depth = _max_loop_depth;
+  results->resize(programs->size());
+
+  runBatch(programs->size(), lock);
+  stop = false; // a cancel() from before the batch has stopped it
+}
+
+void EvalPool::evaluateCases(ByteCode& _program,
+                             EvalResult& _result,
+                             long _randseed,
+                             int _max_loop_depth)
+{
+  lock_guard<mutex> call(call_mtx);
+  unique_lock<mutex> lock(mtx);
+  const uint64_t t0 = metricsEnabled() ? metricsClock() : 0;
+
+  program = &_program;
+  result = &_result;
+  programs = NULL;
+  randseed = _randseed;
+  max_loop_depth = _max_loop_depth;
+  result->clear();
+  result->outputs.resize(cases->size());
+
+  const unsigned n_chunks = (cases->size()+caseChunk-1)/caseChunk;
+  chunk_done.assign(n_chunks, 0);
+  for (unsigned i=0;i<workers.size();i++) {
+    workers[i]->counts.clear();
+    workers[i]->loop_aborts = 0;
+  }
+
+  runBatch(n_chunks, lock);
+
+  unsigned loop_aborts = 0;
+  for (unsigned i=0;i<workers.size();i++) { // integer sums, in worker order: the same whatever the split
+    const EvalResult& c = workers[i]->counts;
+    result->n_cases += c.n_cases;
+    result->n_ops += c.n_ops;
+    result->n_invops += c.n_invops;
+    result->n_inputs_bf_output += c.n_inputs_bf_output;
+    result->n_failed += c.n_failed;
+    loop_aborts += workers[i]->loop_aborts;
+  }
+
+  if (stop.load(memory_order_relaxed)) { // outputs end at the first case that did not run
+    result->cancelled = true;
+    unsigned k=0;
+    while ( (k<n_chunks) && (chunk_done[k]==min(caseChunk, (unsigned)cases->size()-k*caseChunk)) )
+      k++;
+    result->outputs.resize((k<n_chunks) ? k*caseChunk + chunk_done[k] : cases->size());
+  }
+  stop = false;
+
+  if (metricsEnabled())
+    recordEvaluation(t0, result->n_cases, result->n_ops, result->n_invops, 0, loop_aborts);
+}
+
+void EvalPool::runBatch(unsigned n_items, unique_lock<mutex>& lock)
+{
+  error.clear();
+
+  // one contiguous slice per node, proportional to its number of workers
+  unsigned begin = 0;
+  for (unsigned n=0;n<node_state.size();n++) {
+    unsigned node_workers = 0;
+    for (unsigned i=0;i<workers.size();i++)
+      if (workers[i]->node==n)
+        node_workers++;
+    unsigned end = (n+1==node_state.size()) ? n_items
+                                             : begin + (unsigned)((unsigned long)n_items*node_workers/workers.size());
+    node_state[n]->next = begin;
+    node_state[n]->end = end;
+    begin = end;
+  }
+
+  n_done = 0;
+  batch_id++;
+  start_cv.notify_all();
+
+  while (n_done<workers.size())
+    done_cv.wait(lock);
+}
+
+void EvalPool::runChunk(Worker& w, InstructionSet& iset, MemCore& core, ByteCode& bc, FitnessCases& cases,
+                        unsigned chunk)
+{
+  const unsigned first = chunk*caseChunk;
+  const unsigned last = min(first+caseChunk, (unsigned)cases.size());
+  EvalResult& counts = w.counts;
+
+  for (unsigned k=first;k<last;k++) { // same steps as runFitnessCases(), case by case
+    if (stop.load(memory_order_relaxed))
+      break;
+
+    core.reset();
+    core.input = &cases[k];
+    core.output = &result->outputs[k];
+    try
+    {
+      if (runByteCodeUntil(iset, core, bc, randseed, stop, max_loop_depth)) {
+        counts.n_failed++;
+        if (!stop.load(memory_order_relaxed))
+          w.loop_aborts++;
+      }
+    }
+    catch(...)
+    {
+      counts.n_failed++;
+      keepError(current_exception());
+    }
+
+    counts.n_cases++;
+    counts.n_ops += iset.getTotalOps();
+    counts.n_invops += iset.getTotalInvops();
+    counts.n_inputs_bf_output += iset.getTotalInputsBFOutput();
+    chunk_done[chunk]++;
+  }
+}
+
+// Keeps the message of the first exception of the batch
+void EvalPool::keepError(exception_ptr e)
+{
+  string msg;
+  try
+  {
+    rethrow_exception(e);
+  }
+  catch(string& s)
+  {
+    msg = s;
+  }
+  catch(exception& x)
+  {
+    msg = x.what();
+  }
+  catch(...)
+  {
+    msg = "Unknown exception";
+  }
+  lock_guard<mutex> lock(mtx);
+  if (error.empty())
+    error = msg;
+}
+
+string EvalPool::lastError()
+{
+  lock_guard<mutex> lock(mtx);
+  return error;
+}
+
+void EvalPool::setPerf(bool on)
+{
+  lock_guard<mutex> lock(mtx); // published to the workers with the next batch
+  perf_enabled = on;
+}
+
+const PerfSample& EvalPool::workerPerf(unsigned i)
+{
+  return workers[i]->perf;
+}
+
+PerfSample EvalPool::batchPerf()
+{
+  PerfSample s;
+  for (unsigned i=0;i<workers.size();i++)
+    s.add(workers[i]->perf);
+  return s;
+}
+
+size_t EvalPool::memoryBytes()
+{
+  size_t n = sizeof(*this) + chunk_done.capacity()*sizeof(unsigned);
+  for (unsigned i=0;i<workers.size();i++)
+    n += sizeof(Worker) + workers[i]->bytes;
+  for (unsigned k=0;k<node_state.size();k++)
+    n += sizeof(Node) + (node_state[k]->cases ? SlashA::memoryBytes(*node_state[k]->cases) : 0);
+  return n;
+}
+
+const AllocationStats& EvalPool::workerAllocations(unsigned i)
+{
+  return workers[i]->allocs;
+}
+
+AllocationStats EvalPool::batchAllocations()
+{
+  AllocationStats a;
+  for (unsigned i=0;i<workers.size();i++)
+    a.add(workers[i]->allocs);
+  return a;
+}
+
+bool EvalPool::takeProgram(Node& node, unsigned& idx)
+{
+  if (node.next.load(memory_order_relaxed)>=node.end)
+    return false;
+  idx = node.next.fetch_add(1);
+  return idx<node.end;
+}
+
+void EvalPool::workerLoop(Worker* w)
+{
+  if (w->cpu>=0) {
+    cpu_set_t mask;
+    CPU_ZERO(&mask);
+    CPU_SET(w->cpu, &mask);
+    pthread_setaffinity_np(pthread_self(), sizeof(mask), &mask); // best effort: runs unpinned on failure
+  }
+
+  // everything below is first touched by this thread, i.e. allocated on its node
+  Node& home = *node_state[w->node];
+  if (w->first_on_node)
+    home.cases = new FitnessCases(*cases);
+  InstructionSet* iset = NULL;
+  exception_ptr iset_error;
+  try
+  {
+    iset = make_iset();
+  }
+  catch(...)
+  {
+    iset_error = current_exception(); // every item this worker takes fails with it
+  }
+  vector<double> no_input, no_output;
+  MemCore core(D_size, L_size, no_input, no_output);
+  ByteCode bc; // local copy of the program being run
+  PerfCounters* counters = NULL; // opened on first use, on this thread
+  w->bytes = (iset ? iset->memoryBytes() : 0) + core.memoryBytes() + SlashA::memoryBytes(bc);
+
+  unsigned long seen = 0;
+  {
+    unique_lock<mutex> lock(mtx);
+    n_ready++;
+    done_cv.notify_all();
+  }
+
+  while (true) {
+    {
+      unique_lock<mutex> lock(mtx);
+      while ( (batch_id==seen) && (!shutting_down) )
+        start_cv.wait(lock);
+      if (shutting_down)
+        break;
+      seen = batch_id;
+    }
+
+    if (perf_enabled) {
+      if (!counters)
+        counters = new PerfCounters;
+      counters->start();
+    }
+    const AllocationScope allocs;
+    unsigned long n_ops = 0;
+    if (program) {
+      bc = *program;
+      core.io.mode = IO_BUFFER;
+    }
+
+    // own node's slice first, then helps the other nodes (with the local replica of the cases)
+    for (unsigned k=0;k<node_state.size();k++) {
+      Node& node = *node_state[(w->node+k) % node_state.size()];
+      unsigned idx;
+      while (takeProgram(node, idx)) {
+        if (!iset) {
+          keepError(iset_error);
+          if (program) { // every case of the chunk fails
+            const unsigned n = min(caseChunk, (unsigned)home.cases->size()-idx*caseChunk);
+            w->counts.n_cases += n;
+            w->counts.n_failed += n;
+            chunk_done[idx] = n;
+          }
+          else {
+            (*results)[idx].clear();
+            (*results)[idx].n_failed++;
+          }
+          continue;
+        }
+        if (program) { // idx is a chunk of fitness cases
+          runChunk(*w, *iset, core, bc, *home.cases, idx);
+          continue;
+        }
+        bc = (*programs)[idx];
+        try
+        {
+          runFitnessCases(*iset, core, bc, *home.cases, randseed, stop, max_loop_depth, (*results)[idx]);
+        }
+        catch(...) // the counters cover the cases before the one that threw
+        {
+          (*results)[idx].n_failed++;
+          keepError(current_exception());
+        }
+        n_ops += (*results)[idx].n_ops;
+      }
+    }
+    if (program)
+      n_ops = w->counts.n_ops;
+
+    if (perf_enabled)
+      counters->stop(w->perf);
+    else
+      for (unsigned e=0;e<PERF_N_EVENTS;e++)
+        w->perf.valid[e] = false;
+    w->perf.n_ops = n_ops;
+    w->allocs = allocs.elapsed();
+    w->bytes = (iset ? iset->memoryBytes() : 0) + core.memoryBytes() + SlashA::memoryBytes(bc);
+
+    {
+      lock_guard<mutex> lock(mtx);
+      n_done++;
+    }
+    done_cv.notify_all();
+  }
+
+  delete counters;
+  delete iset;
+}
+
+}; //namespace SlashA
@@ -0,0 +1,151 @@
+/*
+ *
+ *  SlashA_Pool.hpp - NUMA- and core-affinity-aware pool of evaluation threads
+ *
+ *  Copyright (C) 2004-2011 Artur B Adib
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef SLASHA_POOL_INCLUDED // duplicate protection
+#define SLASHA_POOL_INCLUDED
+
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include "SlashA.hpp"
+#include "SlashA_Perf.hpp"
+#include "SlashA_Memory.hpp"
+
+namespace SlashA
+{
+
+  class NumaTopology
+  {
+    public:
+      std::vector< std::vector<unsigned> > node_cpus; // usable CPUs of each NUMA node
+
+      // Reads /sys/devices/system/node, restricted to the CPUs this process may run on. Machines without
+      // that information (single socket, containers, non-Linux) come out as one node holding every usable CPU.
+      static NumaTopology discover();
+
+      unsigned nodes() const { return node_cpus.size(); }
+      unsigned cpus() const;
+  };
+
+  const unsigned caseChunk = 1024; // fitness cases per work item of EvalPool::evaluateCases()
+
+  /*
+   * Each worker thread is pinned to one CPU and allocates its instruction set, its MemCore and the program
+   * it is running from that CPU. The first worker of every node also makes the node's own copy of the fitness
+   * cases. Linux places pages on the node of the thread that first touches them, so all of that memory ends
+   * up local to the workers that use it. Batches are split into one slice per node, proportional to the
+   * node's workers; a worker only takes programs from another node's slice once its own is exhausted.
+   */
+  class EvalPool
+  {
+    private:
+      struct Worker;
+      struct Node;
+
+      ISetFactory make_iset;
+      FitnessCases* cases; // master copy; each node works on its own replica
+      unsigned D_size, L_size;
+      NumaTopology topology;
+      std::vector<Worker*> workers;
+      std::vector<Node*> node_state;
+
+      std::mutex call_mtx; // one batch at a time, whichever thread calls
+      std::mutex mtx;
+      std::condition_variable start_cv, done_cv;
+      unsigned long batch_id; // incremented for every batch
+      unsigned n_ready, n_done;
+      bool shutting_down;
+      std::atomic<bool> stop;
+
+      // current batch: many programs, or the fitness cases of one program in chunks of caseChunk
+      std::vector<ByteCode>* programs;
+      std::vector<EvalResult>* results;
+      ByteCode* program;
+      EvalResult* result;
+      long randseed;
+      int max_loop_depth;
+      bool perf_enabled;
+      std::string error; // first exception of the current batch
+
+      void workerLoop(Worker* w);
+      bool takeProgram(Node& node, unsigned& idx);
+      void runBatch(unsigned n_items, std::unique_lock<std::mutex>& lock); // splits the items over the nodes, waits
+      void keepError(std::exception_ptr e);
+      void runChunk(Worker& w, InstructionSet& iset, MemCore& core, ByteCode& bc, FitnessCases& cases,
+                    unsigned chunk);
+      std::vector<unsigned> chunk_done; // evaluateCases(): cases run per chunk
+
+    public:
+      EvalPool(ISetFactory _make_iset, // called once per worker thread; the pool deletes the sets
+               FitnessCases& _cases, // must outlive the pool (replicas are made at construction)
+               unsigned _D_size,
+               unsigned _L_size,
+               unsigned n_threads = 0, // 0: one per usable CPU
+               bool pin = true); // false: no affinity, a single node
+      ~EvalPool();
+
+      // evaluate() and evaluateCases() may be called from several threads: the batches are run one after the
+      // other. An exception thrown while running a program (by an instruction, or by the factory when the
+      // worker started) counts as a failed case of that program; the first message of the batch is kept in
+      // lastError().
+
+      // Runs every program over all the fitness cases. Blocks until the whole batch is done.
+      void evaluate(std::vector<ByteCode>& _programs,
+                    std::vector<EvalResult>& _results,
+                    long _randseed,
+                    int _max_loop_depth);
+
+      // Runs one program over all the fitness cases, split in chunks over the workers, each with its own
+      // MemCore. Outputs and counters are identical to those of runFitnessCases(): every case starts from a
+      // reset core seeded with randseed, so the random-number instructions draw the same numbers whichever
+      // worker runs it. Meant for a few programs over very many cases. When cancelled, outputs end at the
+      // first case that did not run, while the counters cover every case that did.
+      void evaluateCases(ByteCode& _program,
+                         EvalResult& _result,
+                         long _randseed,
+                         int _max_loop_depth);
+
+      // Stops the current batch, or the next one if none is running; results are marked cancelled
+      void cancel() { stop = true; }
+      std::string lastError(); // empty if nothing was thrown during the last batch
+
+      // Hardware counters (lib/SlashA_Perf.hpp) around each worker's share of every batch; off by default.
+      // The per-op figures are per Slash/A instruction, using the n_ops of the programs the worker ran.
+      void setPerf(bool on);
+      const PerfSample& workerPerf(unsigned i); // last batch, worker i
+      PerfSample batchPerf(); // last batch, all workers
+
+      // Memory held by the pool, its workers (instruction set, core, program copy) and the node replicas of the
+      // fitness cases, as measured by each worker at the end of the last batch
+      size_t memoryBytes();
+      // Allocations made by each worker during the last batch (see lib/SlashA_Memory.hpp); zero unless counted
+      const AllocationStats& workerAllocations(unsigned i);
+      AllocationStats batchAllocations();
+
+      unsigned threads() { return workers.size(); }
+      unsigned nodes() { return node_state.size(); }
+      const NumaTopology& getTopology() { return topology; }
+  };
+
+}; // namespace SlashA
+
+#endif // SLASHA_POOL_INCLUDED
@@ -0,0 +1,205 @@
+/*
+ *
+ *  SlashA_Population.cpp
+ *
+ *  Copyright (C) 2004-2011 Artur B Adib
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <cstring>
+#include "SlashA_Population.hpp"
+
+using namespace std;
+
+namespace SlashA
+{
+
+
+/*
+ *
+ * Class methods
+ *
+ */
+
+//
+//  Class: PopulationArena
+//
+
+PopulationArena::PopulationArena(double _slack)
+{
+  slack = (_slack>0) ? _slack : 0;
+  used = holes = 0;
+}
+
+void PopulationArena::clear()
+{
+  offset.clear();
+  length.clear();
+  capacity.clear();
+  used = holes = 0;
+}
+
+void PopulationArena::reserve(unsigned programs, size_t words)
+{
+  offset.reserve(programs);
+  length.reserve(programs);
+  capacity.reserve(programs);
+  if (arena.size()<words)
+    arena.resize(words);
+}
+
+size_t PopulationArena::allocate(unsigned words)
+{
+  if (used+words>arena.size())
+    arena.resize( (used+words>2*arena.size()) ? used+words : 2*arena.size() );
+  size_t at = used;
+  used += words;
+  return at;
+}
+
+void PopulationArena::relocate(unsigned i, unsigned new_length)
+{
+  unsigned cap = blockSize(new_length);
+  size_t at = allocate(cap); // may move the arena, so offsets are used from here on
+  memcpy(&arena[at], &arena[offset[i]], length[i]*sizeof(ByteCode_Type));
+  holes += capacity[i];
+  offset[i] = at;
+  capacity[i] = cap;
+}
+
+unsigned PopulationArena::add(const ProgramView& p_)
+{
+  ProgramView p = p_;
+  if (inArena(p.code)) { // allocating could move the source
+    scratch_insert.assign(p.code, p.code+p.length);
+    p.code = scratch_insert.data();
+  }
+  unsigned cap = blockSize(p.length);
+  size_t at = allocate(cap);
+  if (p.length)
+    memcpy(&arena[at], p.code, p.length*sizeof(ByteCode_Type));
+  offset.push_back(at);
+  length.push_back(p.length);
+  capacity.push_back(cap);
+  return length.size()-1;
+}
+
+bool PopulationArena::inArena(const ByteCode_Type* p) const
+{
+  return (arena.size()>0) && (p>=arena.data()) && (p<arena.data()+arena.size());
+}
+
+void PopulationArena::set(unsigned i, const ProgramView& p_)
+{
+  ProgramView p = p_;
+  if ( (p.length>capacity[i]) && inArena(p.code) ) { // allocating could move the source
+    scratch_insert.assign(p.code, p.code+p.length);
+    p.code = scratch_insert.data();
+  }
+  if (p.length>capacity[i]) {
+    holes += capacity[i];
+    capacity[i] = blockSize(p.length);
+    offset[i] = allocate(capacity[i]);
+  }
+  if (p.length)
+    memmove(&arena[offset[i]], p.code, p.length*sizeof(ByteCode_Type)); // p may be a view of this arena
+  length[i] = p.length;
+}
+
+void PopulationArena::resize(unsigned i, unsigned n)
+{
+  if (n>capacity[i])
+    relocate(i, n);
+  for (unsigned k=length[i];k<n;k++)
+    arena[offset[i]+k] = 0;
+  length[i] = n;
+}
+
+void PopulationArena::replace(unsigned i, unsigned pos, unsigned n_remove, const ByteCode_Type* insert, unsigned n_insert)
+{
+  if (pos>length[i])
+    pos = length[i];
+  if (pos+n_remove>length[i])
+    n_remove = length[i]-pos;
+
+  const unsigned n = length[i] - n_remove + n_insert;
+  if (inArena(insert)) { // relocating could move the source, and moving the tail could overwrite it
+    scratch_insert.assign(insert, insert+n_insert);
+    insert = scratch_insert.data();
+  }
+  if (n>capacity[i])
+    relocate(i, n);
+
+  ByteCode_Type* p = &arena[offset[i]];
+  memmove(p+pos+n_insert, p+pos+n_remove, (length[i]-pos-n_remove)*sizeof(ByteCode_Type)); // the tail
+  if (n_insert)
+    memcpy(p+pos, insert, n_insert*sizeof(ByteCode_Type));
+  length[i] = n;
+}
+
+void PopulationArena::crossover(unsigned a, unsigned a_pos, unsigned a_len, unsigned b, unsigned b_pos, unsigned b_len)
+{
+  if (a_pos>length[a]) a_pos = length[a];
+  if (a_pos+a_len>length[a]) a_len = length[a]-a_pos;
+  if (b_pos>length[b]) b_pos = length[b];
+  if (b_pos+b_len>length[b]) b_len = length[b]-b_pos;
+
+  // both segments are copied out first: replacing one may move the arena
+  scratch_a.assign(&arena[offset[a]]+a_pos, &arena[offset[a]]+a_pos+a_len);
+  scratch_b.assign(&arena[offset[b]]+b_pos, &arena[offset[b]]+b_pos+b_len);
+
+  replace(a, a_pos, a_len, scratch_b.data(), b_len);
+  replace(b, b_pos, b_len, scratch_a.data(), a_len);
+}
+
+size_t PopulationArena::wasted() const
+{
+  size_t w = holes;
+  for (unsigned i=0;i<length.size();i++)
+    w += capacity[i]-length[i];
+  return w;
+}
+
+void PopulationArena::compact()
+{
+  size_t total = 0;
+  for (unsigned i=0;i<length.size();i++)
+    total += blockSize(length[i]);
+
+  vector<ByteCode_Type> fresh(total);
+  size_t at = 0;
+  for (unsigned i=0;i<length.size();i++) {
+    if (length[i])
+      memcpy(&fresh[at], &arena[offset[i]], length[i]*sizeof(ByteCode_Type));
+    offset[i] = at;
+    capacity[i] = blockSize(length[i]);
+    at += capacity[i];
+  }
+
+  arena.swap(fresh);
+  used = at;
+  holes = 0;
+}
+
+bool PopulationArena::compactIfWasted(double max_fraction)
+{
+  if (wasted()<=max_fraction*used)
+    return false;
+  compact();
+  return true;
+}
+
+}; //namespace SlashA
@@ -0,0 +1,90 @@
+/*
+ *
+ *  SlashA_Population.hpp - contiguous storage for a whole population of programs
+ *
+ *  Copyright (C) 2004-2011 Artur B Adib
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef SLASHA_POPULATION_INCLUDED // duplicate protection
+#define SLASHA_POPULATION_INCLUDED
+
+#include <cstddef>
+#include "SlashA.hpp"
+
+namespace SlashA
+{
+
+  /*
+   * All programs live back to back in one array, described by offset/length/capacity tables (structure of
+   * arrays). Each program gets some slack after it, so crossover and mutation edit it in place; a program
+   * that outgrows its block moves to the end of the arena and leaves a hole, which compact() reclaims.
+   *
+   * Views and data pointers are invalidated by any call that can grow or move programs (add, set, resize,
+   * replace, crossover, compact), as with iterators of a std::vector.
+   */
+  class PopulationArena
+  {
+    private:
+      std::vector<ByteCode_Type> arena;
+      std::vector<size_t> offset; // start of each program in arena
+      std::vector<unsigned> length;
+      std::vector<unsigned> capacity; // length + slack
+      size_t used; // end of the last block
+      size_t holes; // words left behind by programs that moved
+      double slack; // fraction of a program's length reserved after it
+      ByteCode scratch_a, scratch_b; // crossover segments
+      ByteCode scratch_insert; // sources from inside the arena, when the arena may move
+
+      bool inArena(const ByteCode_Type* p) const;
+      unsigned blockSize(unsigned n) { return n + (unsigned)(n*slack) + 4; }
+      size_t allocate(unsigned words); // returns the offset of a new block at the end of the arena
+      void relocate(unsigned i, unsigned new_length); // moves program i to a new block with room for new_length
+    public:
+      PopulationArena(double _slack = 0.25);
+
+      unsigned size() const { return length.size(); }
+      void clear();
+      void reserve(unsigned programs, size_t words);
+
+      unsigned add(const ProgramView& p); // returns the index of the new program
+      void set(unsigned i, const ProgramView& p); // in place if it fits
+
+      ProgramView view(unsigned i) const { return ProgramView(&arena[offset[i]], length[i]); }
+      ByteCode_Type* data(unsigned i) { return &arena[offset[i]]; }
+      unsigned programLength(unsigned i) const { return length[i]; }
+      unsigned programCapacity(unsigned i) const { return capacity[i]; }
+      void get(unsigned i, ByteCode& bc) const { bc.assign(&arena[offset[i]], &arena[offset[i]]+length[i]); }
+
+      void resize(unsigned i, unsigned n); // new instructions are zero (numeric instruction 0)
+
+      // Replaces n_remove instructions at pos with the n_insert given ones (cut and paste)
+      void replace(unsigned i, unsigned pos, unsigned n_remove, const ByteCode_Type* insert, unsigned n_insert);
+
+      // Two-point crossover: exchanges a[a_pos, a_pos+a_len) with b[b_pos, b_pos+b_len)
+      void crossover(unsigned a, unsigned a_pos, unsigned a_len, unsigned b, unsigned b_pos, unsigned b_len);
+
+      void mutate(unsigned i, unsigned pos, ByteCode_Type inst) { arena[offset[i]+pos] = inst; }
+
+      size_t words() const { return used; } // arena words in use, holes and slack included
+      size_t wasted() const; // holes plus unused slack
+      void compact(); // rewrites all programs in index order with fresh slack
+      bool compactIfWasted(double max_fraction = 0.5); // compacts if more than that fraction of words() is wasted
+  };
+
+}; // namespace SlashA
+
+#endif // SLASHA_POPULATION_INCLUDED
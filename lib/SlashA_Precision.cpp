@@ -0,0 +1,94 @@
+/*
+ *
+ *  SlashA_Precision.cpp
+ *
+ *  Copyright (C) 2004-2011 Artur B Adib
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <algorithm>
+#include <cmath>
+#include "SlashA_Precision.hpp"
+
+using namespace std;
+
+namespace SlashA
+{
+
+
+/*
+ *
+ * Functions
+ *
+ */
+
+bool comparePrecision(InstructionSet& iset,
+                      FloatInstructionSet& fset,
+                      ByteCode& bc,
+                      FitnessCases& cases,
+                      unsigned D_size,
+                      unsigned L_size,
+                      long randseed,
+                      const atomic<bool>& stop,
+                      int max_loop_depth,
+                      double abs_tol,
+                      double rel_tol,
+                      PrecisionReport& rep)
+{
+  if (iset.size()!=fset.size())
+    throw (string)"The float and double instruction sets differ";
+
+  vector<double> no_input, no_output;
+  MemCore dcore(D_size, L_size, no_input, no_output);
+  FloatMemCore fcore(D_size, L_size, no_input, no_output);
+  EvalResult dres, fres;
+
+  runFitnessCases(iset, dcore, bc, cases, randseed, stop, max_loop_depth, dres);
+  runFitnessCases(fset, fcore, bc, cases, randseed, stop, max_loop_depth, fres);
+
+  rep.n_cases = min(dres.n_cases, fres.n_cases);
+  rep.stopped = dres.cancelled || fres.cancelled;
+  rep.n_outputs = rep.n_count_mismatches = rep.n_exceeding = 0;
+  rep.max_abs_error = rep.max_rel_error = 0.0;
+  rep.worst_case = rep.worst_output = 0;
+  rep.n_invops_double = dres.n_invops;
+  rep.n_invops_float = fres.n_invops;
+
+  for (unsigned k=0;k<rep.n_cases;k++) {
+    const vector<double>& d = dres.outputs[k];
+    const vector<double>& f = fres.outputs[k];
+    if (d.size()!=f.size())
+      rep.n_count_mismatches++;
+
+    for (unsigned i=0;(i<d.size()) && (i<f.size());i++) {
+      const double err = fabs(d[i]-f[i]);
+      rep.n_outputs++;
+      if (err>abs_tol + rel_tol*fabs(d[i]))
+        rep.n_exceeding++;
+      if (err>rep.max_abs_error) {
+        rep.max_abs_error = err;
+        rep.worst_case = k;
+        rep.worst_output = i;
+      }
+      if ( (d[i]!=0) && (err/fabs(d[i])>rep.max_rel_error) )
+        rep.max_rel_error = err/fabs(d[i]);
+    }
+  }
+
+  return rep.agree();
+}
+
+}; //namespace SlashA
@@ -0,0 +1,67 @@
+/*
+ *
+ *  SlashA_Precision.hpp - checks that a program gives the same outputs in float and double
+ *
+ *  Copyright (C) 2004-2011 Artur B Adib
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef SLASHA_PRECISION_INCLUDED // duplicate protection
+#define SLASHA_PRECISION_INCLUDED
+
+#include "SlashA.hpp"
+
+namespace SlashA
+{
+
+  class PrecisionReport
+  {
+    public:
+      unsigned n_cases; // fitness cases compared
+      unsigned n_outputs; // outputs compared
+      unsigned n_count_mismatches; // cases where the two machines made a different number of outputs
+      unsigned n_exceeding; // outputs outside the tolerance
+      double max_abs_error; // largest |double - float| over the outputs compared
+      double max_rel_error; // largest |double - float| / |double| (for non-zero double outputs)
+      unsigned worst_case, worst_output; // where max_abs_error occurred
+      uint64_t n_invops_double, n_invops_float; // invalid operations in each precision
+      bool stopped; // the stop flag was raised before every case ran on both machines
+
+      bool agree() const { return (!stopped) && (n_count_mismatches==0) && (n_exceeding==0); }
+  };
+
+  /* Functions */
+
+  // Runs bc over the cases on a double and a float machine and compares the outputs. An output agrees if
+  // |double - float| <= abs_tol + rel_tol*|double|. Both instruction sets must hold the same instructions
+  // in the same order (e.g. both built with insert_DIS_full()). Raising stop (e.g. from a timer thread)
+  // ends both runs; only the cases run by both machines are then compared. Returns rep.agree().
+  bool comparePrecision(InstructionSet& iset,
+                        FloatInstructionSet& fset,
+                        ByteCode& bc,
+                        FitnessCases& cases,
+                        unsigned D_size,
+                        unsigned L_size,
+                        long randseed,
+                        const std::atomic<bool>& stop,
+                        int max_loop_depth,
+                        double abs_tol,
+                        double rel_tol,
+                        PrecisionReport& rep);
+
+}; // namespace SlashA
+
+#endif // SLASHA_PRECISION_INCLUDED
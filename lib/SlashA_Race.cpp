@@ -0,0 +1,198 @@
+/*
+ *
+ *  SlashA_Race.cpp
+ *
+ *  Copyright (C) 2004-2011 Artur B Adib
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <cmath>
+#include <limits>
+#include "SlashA_Race.hpp"
+#include "SlashA_Metrics.hpp"
+
+using namespace std;
+
+namespace SlashA
+{
+
+
+/*
+ *
+ * Functions
+ *
+ */
+
+static void recordRace(uint64_t t0, const RaceResult& res, unsigned loop_aborts)
+{
+  recordEvaluation(t0, res.n_cases, res.n_ops, res.n_invops, 0, loop_aborts);
+}
+
+// Runs fitness case k into the next entry of res.outputs and returns its error. Cases that fail on their
+// own (not stopped) are counted in loop_aborts, as in runFitnessCases().
+static double runCase(InstructionSet& iset, MemCore& core, ByteCode& bc, FitnessCases& cases, unsigned k,
+                      long randseed, const atomic<bool>& stop, int max_loop_depth,
+                      const CaseError& case_error, RaceResult& res, unsigned& loop_aborts)
+{
+  res.outputs.push_back(vector<double>());
+  core.reset();
+  core.input = &cases[k];
+  core.output = &res.outputs.back();
+
+  if (runByteCodeUntil(iset, core, bc, randseed, stop, max_loop_depth)) {
+    res.n_failed++;
+    if (!stop.load(memory_order_relaxed))
+      loop_aborts++;
+  }
+
+  res.order.push_back(k);
+  res.n_cases++;
+  res.n_ops += iset.getTotalOps();
+  res.n_invops += iset.getTotalInvops();
+  res.n_inputs_bf_output += iset.getTotalInputsBFOutput();
+
+  double err = case_error(k, cases[k], res.outputs.back());
+  if (err!=err)
+    err = numeric_limits<double>::infinity();
+  res.error += err;
+  res.mean_error = res.error/res.n_cases;
+  return err;
+}
+
+bool runFitnessRace(InstructionSet& iset,
+                    MemCore& core,
+                    ByteCode& bc,
+                    FitnessCases& cases,
+                    long randseed,
+                    const atomic<bool>& stop,
+                    int max_loop_depth,
+                    const CaseError& case_error,
+                    double max_error,
+                    RaceResult& res)
+{
+  vector<double>* const input = core.input; // restored on exit
+  vector<double>* const output = core.output;
+  const IOMode io_mode = core.io.mode;
+  core.io.mode = IO_BUFFER;
+  const uint64_t t0 = metricsEnabled() ? metricsClock() : 0;
+  unsigned loop_aborts = 0;
+
+  res.clear();
+  res.outputs.reserve(cases.size());
+  res.order.reserve(cases.size());
+
+  for (unsigned k=0;k<cases.size();k++) {
+    if (stop.load(memory_order_relaxed)) {
+      res.cancelled = true;
+      break;
+    }
+    runCase(iset, core, bc, cases, k, randseed, stop, max_loop_depth, case_error, res, loop_aborts);
+    if (res.error>max_error) {
+      res.raced_out = true;
+      break;
+    }
+  }
+  if (stop.load(memory_order_relaxed)) // the last case run may have been cut short
+    res.cancelled = true;
+
+  core.input = input;
+  core.output = output;
+  core.io.mode = io_mode;
+
+  if (metricsEnabled())
+    recordRace(t0, res, loop_aborts);
+
+  return !res.raced_out && !res.cancelled;
+} // runFitnessRace
+
+
+bool runStatisticalRace(InstructionSet& iset,
+                        MemCore& core,
+                        ByteCode& bc,
+                        FitnessCases& cases,
+                        long randseed,
+                        const atomic<bool>& stop,
+                        int max_loop_depth,
+                        const CaseError& case_error,
+                        double max_mean_error,
+                        double error_range,
+                        double delta,
+                        unsigned min_cases,
+                        unsigned long shuffle_seed,
+                        RaceResult& res)
+{
+  vector<double>* const input = core.input; // restored on exit
+  vector<double>* const output = core.output;
+  const IOMode io_mode = core.io.mode;
+  core.io.mode = IO_BUFFER;
+  const uint64_t t0 = metricsEnabled() ? metricsClock() : 0;
+  unsigned loop_aborts = 0;
+  const unsigned N = cases.size();
+
+  res.clear();
+  res.outputs.reserve(N);
+  res.order.reserve(N);
+
+  // Fisher-Yates shuffle driven by xorshift64
+  vector<unsigned> order(N);
+  for (unsigned k=0;k<N;k++)
+    order[k] = k;
+  uint64_t x = shuffle_seed ? shuffle_seed : 0x9E3779B97F4A7C15ULL;
+  for (unsigned k=N;k>1;k--) {
+    x ^= x<<13; x ^= x>>7; x ^= x<<17;
+    swap(order[k-1], order[x % k]);
+  }
+
+  const double log_term = log(N/delta); // delta/N per check: the race checks at most N times
+  double clipped = 0.0; // sum of the errors clipped to [0, error_range]
+
+  for (unsigned n=1;n<=N;n++) {
+    if (stop.load(memory_order_relaxed)) {
+      res.cancelled = true;
+      break;
+    }
+    double err = runCase(iset, core, bc, cases, order[n-1], randseed, stop, max_loop_depth, case_error, res, loop_aborts);
+    clipped += (err<0) ? 0 : ( (err<error_range) ? err : error_range );
+
+    if ( (n<min_cases) || (n==N) )
+      continue;
+
+    // Serfling's bound for sampling without replacement: the sample mean overshoots the population mean
+    // by more than eps with probability at most delta/N, so at most delta over all the checks
+    double eps = error_range*sqrt( (1.0-(double)(n-1)/N) * log_term / (2.0*n) );
+    if (clipped/n - eps > max_mean_error) {
+      res.raced_out = true;
+      break;
+    }
+  }
+
+  if (stop.load(memory_order_relaxed)) // the last case run may have been cut short
+    res.cancelled = true;
+  // Ran to the end without being stopped: the decision is exact
+  if ( (!res.cancelled) && (res.n_cases==N) && (res.mean_error>max_mean_error) )
+    res.raced_out = true;
+
+  core.input = input;
+  core.output = output;
+  core.io.mode = io_mode;
+
+  if (metricsEnabled())
+    recordRace(t0, res, loop_aborts);
+
+  return !res.raced_out && !res.cancelled;
+} // runStatisticalRace
+
+}; //namespace SlashA
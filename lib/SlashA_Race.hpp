@@ -0,0 +1,92 @@
+/*
+ *
+ *  SlashA_Race.hpp - fitness racing: evaluations that stop once a program cannot win
+ *
+ *  Copyright (C) 2004-2011 Artur B Adib
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef SLASHA_RACE_INCLUDED // duplicate protection
+#define SLASHA_RACE_INCLUDED
+
+#include "SlashA.hpp"
+
+namespace SlashA
+{
+
+  /*
+   * Under tournament selection a program's exact fitness stops mattering once it is clearly worse than
+   * its competitor. A race adds up a user-supplied error per fitness case and abandons the program as
+   * soon as it is known (or, in the statistical variant, known with high confidence) to exceed a bound,
+   * typically the error of the best competitor evaluated so far.
+   */
+
+  // Error of one fitness case, computed from the case's input buffer and the program's output buffer.
+  // Must be non-negative; a NaN is taken as an infinite error.
+  typedef std::function<double(unsigned k, const std::vector<double>& input, const std::vector<double>& output)> CaseError;
+
+  class RaceResult : public EvalResult
+  {
+    public:
+      double error; // sum of the errors of the cases run
+      double mean_error; // error/n_cases, the estimate compared against the bound in statistical races
+      bool raced_out; // the race was abandoned because the bound could not be beaten
+      std::vector<unsigned> order; // case index of each entry of outputs (shuffled in statistical races)
+
+      RaceResult() { clear(); }
+      void clear() { EvalResult::clear(); error=mean_error=0.0; raced_out=false; order.clear(); }
+  };
+
+  /* Functions */
+
+  // Runs the cases in order and stops as soon as the partial error exceeds max_error. Since case errors
+  // are non-negative, a program that is stopped could not have finished at or below max_error.
+  // Returns true if the program stayed within the bound over all the cases.
+  bool runFitnessRace(InstructionSet& iset,
+                      MemCore& core,
+                      ByteCode& bc,
+                      FitnessCases& cases,
+                      long randseed,
+                      const std::atomic<bool>& stop,
+                      int max_loop_depth,
+                      const CaseError& case_error,
+                      double max_error,
+                      RaceResult& res);
+
+  // Runs the cases in a random order (from shuffle_seed) and stops once a Hoeffding-Serfling bound shows,
+  // with probability at least 1-delta, that the mean error over all the cases exceeds max_mean_error. The
+  // bound is checked after every case, each check at level delta/N (N cases) so that delta holds for the
+  // whole race. Case errors are clipped to [0, error_range] for the test. No decision is made before
+  // min_cases cases.
+  // Returns true if the program was not raced out.
+  bool runStatisticalRace(InstructionSet& iset,
+                          MemCore& core,
+                          ByteCode& bc,
+                          FitnessCases& cases,
+                          long randseed,
+                          const std::atomic<bool>& stop,
+                          int max_loop_depth,
+                          const CaseError& case_error,
+                          double max_mean_error,
+                          double error_range,
+                          double delta,
+                          unsigned min_cases,
+                          unsigned long shuffle_seed,
+                          RaceResult& res);
+
+}; // namespace SlashA
+
+#endif // SLASHA_RACE_INCLUDED
@@ -0,0 +1,180 @@
+/*
+ *
+ *  SlashA_Sched.cpp
+ *
+ *  Copyright (C) 2004-2011 Artur B Adib
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "SlashA_Sched.hpp"
+
+using namespace std;
+
+namespace SlashA
+{
+
+
+/*
+ *
+ * Class methods
+ *
+ */
+
+//
+//  Class: Scheduler
+//
+
+Scheduler::Scheduler(InstructionSet& _iset,
+                     unsigned _D_size,
+                     unsigned _L_size,
+                     SchedPolicy _policy,
+                     unsigned long _quantum)
+{
+  if (_quantum==0)
+    throw (string)"The scheduling quantum must be positive";
+
+  iset = &_iset;
+  D_size = _D_size;
+  L_size = _L_size;
+  policy = _policy;
+  quantum = _quantum;
+  n_active = 0;
+}
+
+Scheduler::~Scheduler()
+{
+  clear();
+}
+
+unsigned Scheduler::add(const ProgramView& p,
+                        const vector<double>& input,
+                        long randseed,
+                        int max_loop_depth,
+                        unsigned long budget)
+{
+  SchedTask* t = new SchedTask;
+  t->program = p;
+  t->input = input;
+  t->randseed = randseed;
+  t->max_loop_depth = max_loop_depth;
+  t->budget = budget;
+  t->status = TASK_READY;
+  t->executed = 0;
+  t->slices = 0;
+  t->n_ops = t->n_invops = t->n_inputs_bf_output = 0;
+
+  t->core = new MemCore(D_size, L_size, t->input, t->output);
+  t->core->setIO(IOPolicy::buffers());
+  startProgram(*t->core, t->program, randseed);
+
+  const unsigned id = tasks.size();
+  tasks.push_back(t);
+  n_active++;
+  enqueue(id);
+  return id;
+}
+
+void Scheduler::enqueue(unsigned id)
+{
+  if (policy==SCHED_ROUND_ROBIN)
+    fifo.push_back(id);
+  else {
+    const SchedTask& t = *tasks[id];
+    shortest.push(make_pair(t.executed + (t.core->C_size - t.core->c), id));
+  }
+}
+
+bool Scheduler::dequeue(unsigned& id)
+{
+  while (true) {
+    if (policy==SCHED_ROUND_ROBIN) {
+      if (fifo.empty())
+        return false;
+      id = fifo.front();
+      fifo.pop_front();
+    }
+    else {
+      if (shortest.empty())
+        return false;
+      id = shortest.top().second;
+      shortest.pop();
+    }
+    if (tasks[id]->status==TASK_READY) // cancelled tasks are left in line and skipped here
+      return true;
+  }
+}
+
+void Scheduler::finish(SchedTask& t, TaskStatus status)
+{
+  t.status = status;
+  delete t.core;
+  t.core = NULL;
+  n_active--;
+}
+
+bool Scheduler::step()
+{
+  unsigned id;
+  if (!dequeue(id))
+    return false;
+  SchedTask& t = *tasks[id];
+
+  unsigned long slice = quantum;
+  if ( (t.budget>0) && (t.budget-t.executed<slice) )
+    slice = t.budget - t.executed;
+
+  iset->clear(); // the counters of this slice only
+  iset->setMaxLoopDepth(t.max_loop_depth);
+  unsigned long executed;
+  const RunStatus st = resumeProgram(*iset, *t.core, slice, executed);
+
+  t.executed += executed;
+  t.slices++;
+  t.n_ops += iset->getTotalOps();
+  t.n_invops += iset->getTotalInvops();
+  t.n_inputs_bf_output += iset->getTotalInputsBFOutput();
+
+  if (st==RUN_FINISHED)
+    finish(t, TASK_FINISHED);
+  else if (st==RUN_FAILED)
+    finish(t, TASK_FAILED);
+  else if ( (t.budget>0) && (t.executed>=t.budget) )
+    finish(t, TASK_CANCELLED);
+  else
+    enqueue(id);
+
+  return true;
+}
+
+void Scheduler::cancel(unsigned id)
+{
+  if (tasks[id]->status==TASK_READY)
+    finish(*tasks[id], TASK_CANCELLED);
+}
+
+void Scheduler::clear()
+{
+  for (unsigned i=0;i<tasks.size();i++) {
+    delete tasks[i]->core;
+    delete tasks[i];
+  }
+  tasks.clear();
+  fifo.clear();
+  shortest = decltype(shortest)();
+  n_active = 0;
+}
+
+}; //namespace SlashA
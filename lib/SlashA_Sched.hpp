@@ -0,0 +1,102 @@
+/*
+ *
+ *  SlashA_Sched.hpp - time-sliced scheduler running many programs interleaved
+ *
+ *  Copyright (C) 2004-2011 Artur B Adib
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef SLASHA_SCHED_INCLUDED // duplicate protection
+#define SLASHA_SCHED_INCLUDED
+
+#include <deque>
+#include <queue>
+#include "SlashA.hpp"
+
+namespace SlashA
+{
+
+  enum SchedPolicy { SCHED_ROUND_ROBIN, SCHED_SHORTEST_REMAINING };
+  enum TaskStatus { TASK_READY, TASK_FINISHED, TASK_FAILED, TASK_CANCELLED };
+
+  class SchedTask
+  {
+    public:
+      ProgramView program; // must stay where it is until the task is over
+      std::vector<double> input, output;
+      long randseed;
+      int max_loop_depth;
+      unsigned long budget; // instructions; 0: unlimited
+      TaskStatus status;
+      unsigned long executed; // instructions run so far
+      unsigned slices; // quanta it was given
+      unsigned n_ops, n_invops, n_inputs_bf_output; // as in EvalResult, summed over the slices
+      MemCore* core; // deleted as soon as the task is over
+  };
+
+  /*
+   * Runs many programs on one instruction set, a quantum of instructions at a time. Each task has its own
+   * MemCore, which keeps its whole state between slices (see resumeProgram()), so a long loop-heavy program
+   * only delays the others by one quantum. The next task is the oldest in line (SCHED_ROUND_ROBIN) or the one
+   * with the smallest executed + (C_size - c) (SCHED_SHORTEST_REMAINING): the program length for straight-line
+   * code, growing with every slice for programs that loop, so short programs finish first and long ones sink.
+   * A task that reaches its budget is cancelled.
+   */
+  class Scheduler
+  {
+    private:
+      InstructionSet* iset;
+      unsigned D_size, L_size;
+      SchedPolicy policy;
+      unsigned long quantum;
+      std::vector<SchedTask*> tasks;
+      std::deque<unsigned> fifo; // SCHED_ROUND_ROBIN
+      std::priority_queue< std::pair<unsigned long, unsigned>,
+                           std::vector< std::pair<unsigned long, unsigned> >,
+                           std::greater< std::pair<unsigned long, unsigned> > > shortest; // SCHED_SHORTEST_REMAINING
+      unsigned n_active;
+
+      void enqueue(unsigned id);
+      bool dequeue(unsigned& id);
+      void finish(SchedTask& t, TaskStatus status);
+    public:
+      Scheduler(InstructionSet& _iset,
+                unsigned _D_size,
+                unsigned _L_size,
+                SchedPolicy _policy = SCHED_ROUND_ROBIN,
+                unsigned long _quantum = 1000);
+      ~Scheduler();
+
+      // Queues a program to run over one input buffer; returns the task id (0, 1, ...).
+      unsigned add(const ProgramView& p,
+                   const std::vector<double>& input,
+                   long randseed,
+                   int max_loop_depth = -1,
+                   unsigned long budget = 0);
+
+      bool step(); // runs one quantum of the next task; false if no task is left
+      void run() { while (step()); }
+      void cancel(unsigned id);
+
+      const SchedTask& task(unsigned id) const { return *tasks[id]; }
+      unsigned size() const { return tasks.size(); }
+      unsigned active() const { return n_active; }
+      void clear(); // drops every task, finished or not
+  };
+
+}; // namespace SlashA
+
+#endif // SLASHA_SCHED_INCLUDED
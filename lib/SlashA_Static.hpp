@@ -0,0 +1,177 @@
+/*
+ *
+ *  SlashA_Static.hpp - compile-time translation of Slash/A source into ByteCode
+ *
+ *  Copyright (C) 2004-2011 Artur B Adib
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef SLASHA_STATIC_INCLUDED // duplicate protection
+#define SLASHA_STATIC_INCLUDED
+
+#include <string>
+#include <string_view>
+#include "SlashA.hpp"
+
+namespace SlashA
+{
+
+  /*
+   * Programs known when the binary is built can be translated by the compiler, with the same rules as
+   * source2ByteCode() (words end at '/', the program at '.', '#' comments out the rest of the line, spaces,
+   * tabs and line feeds are ignored). Opcodes depend on the layout of the instruction set, which the
+   * compiler cannot see: it is given as a number of numeric instructions plus the names of the other
+   * instructions in insertion order. StaticProgram::matches() checks a real instruction set against it.
+   *
+   *   SLASHA_STATIC_PROGRAM(power4, 32768, SlashA::DIS_full_names, "4/itof/0/save/input/pow/output/.");
+   *   SlashA::runProgram(iset, core, power4.view(), seed, stop, -1);
+   *
+   * An unknown instruction or a word over maxWordLen characters is a compile error, reported as a call
+   * to staticUnknownInstruction() or staticWordTooLarge() from the offending program.
+   */
+
+  class StaticNames
+  {
+    public:
+      const char* const* names;
+      unsigned size;
+  };
+
+  constexpr const char* DIS_full_list[] = { // as inserted by insert_DIS_full()
+    "input", "output",
+    "load", "save", "swap", "cmp",
+    "inc", "dec", "itof", "ftoi",
+    "label", "gotoifp",
+    "jumpifn", "jumphere",
+    "loop", "endloop",
+    "add", "sub", "mul", "div",
+    "abs", "sign", "exp", "log", "sin", "pow", "ran",
+    "nop" };
+
+  constexpr StaticNames DIS_full_names = { DIS_full_list, sizeof(DIS_full_list)/sizeof(DIS_full_list[0]) };
+
+  // Not constexpr: reaching them during constant evaluation stops the compiler at the bad program
+  inline void staticUnknownInstruction(std::string_view word)
+    { throw (std::string)"Instruction not recognized: " + std::string(word); }
+  inline void staticWordTooLarge(std::string_view word, char next)
+    { throw (std::string)"Instruction word is too large: " + std::string(word) + next; }
+
+  template <unsigned N>
+  class StaticProgram
+  {
+    public:
+      ByteCode_Type code[N>0 ? N : 1];
+      unsigned length;
+      unsigned n_numeric; // layout the opcodes refer to
+      StaticNames names;
+
+      ProgramView view() const { return ProgramView(code, length); }
+      ByteCode bytecode() const { return ByteCode(code, code+length); }
+
+      template <class T>
+      bool matches(BasicInstructionSet<T>& iset) const
+      {
+        if ( (iset.numericInstructions()!=n_numeric) || (iset.size()!=n_numeric+names.size) )
+          return false;
+        for (unsigned i=0;i<names.size;i++)
+          if (iset.getName(n_numeric+i)!=names.names[i])
+            return false;
+        return true;
+      }
+  };
+
+  // Number of words in the program, i.e. the length of its ByteCode
+  constexpr unsigned staticLength(std::string_view src)
+  {
+    unsigned n = 0;
+    bool comment = false;
+    for (char c : src) {
+      if (comment) {
+        if (c==10)
+          comment = false;
+      }
+      else if (c=='.')
+        break;
+      else if (c=='/')
+        n++;
+      else if (c=='#')
+        comment = true;
+    }
+    return n;
+  }
+
+  constexpr ByteCode_Type staticLookup(std::string_view word, unsigned n_numeric, StaticNames names)
+  {
+    const unsigned len = word.size();
+    if ( (len>0) && (len<=9) && ((word[0]!='0') || (len==1)) ) { // same rule as InstructionSet::lookup()
+      ByteCode_Type n = 0;
+      unsigned i = 0;
+      for (;(i<len) && (word[i]>='0') && (word[i]<='9');i++)
+        n = n*10 + (word[i]-'0');
+      if ( (i==len) && (n<n_numeric) )
+        return n;
+    }
+
+    for (unsigned i=0;i<names.size;i++)
+      if (std::string_view(names.names[i])==word)
+        return n_numeric+i;
+
+    staticUnknownInstruction(word);
+    return 0;
+  }
+
+  template <unsigned N>
+  constexpr StaticProgram<N> staticParse(std::string_view src, unsigned n_numeric, StaticNames names)
+  {
+    StaticProgram<N> p{};
+    p.n_numeric = n_numeric;
+    p.names = names;
+
+    bool comment = false;
+    char word[maxWordLen] = {};
+    unsigned len = 0;
+    for (size_t i=0;(i<src.size()) && (p.length<N);i++) {
+      const char c = src[i];
+      if (comment) {
+        if (c==10)
+          comment = false;
+      }
+      else if (c=='.')
+        break;
+      else if (c=='/') {
+        p.code[p.length++] = staticLookup(std::string_view(word, len), n_numeric, names);
+        len = 0;
+      }
+      else if (c=='#')
+        comment = true;
+      else if ( (c!=' ') && (c!=10) && (c!=9) ) {
+        if (len==maxWordLen)
+          staticWordTooLarge(std::string_view(word, len), c);
+        else
+          word[len++] = c;
+      }
+    }
+    return p;
+  }
+
+}; // namespace SlashA
+
+#define SLASHA_STATIC_PROGRAM(var, n_numeric, names, src) \
+  static constexpr std::string_view var##_source = src; \
+  static constexpr SlashA::StaticProgram<SlashA::staticLength(var##_source)> var = \
+    SlashA::staticParse<SlashA::staticLength(var##_source)>(var##_source, n_numeric, names)
+
+#endif // SLASHA_STATIC_INCLUDED
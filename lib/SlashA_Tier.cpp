@@ -0,0 +1,706 @@
+/*
+ *
+ *  SlashA_Tier.cpp
+ *
+ *  Copyright (C) 2004-2011 Artur B Adib
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <cstdio>
+#include <chrono>
+#include "SlashA_Tier.hpp"
+#include "SlashA_Metrics.hpp"
+
+using namespace std;
+
+namespace SlashA
+{
+
+// Source instructions that have no op of their own, besides the LinkedOpKind's
+enum { SRC_NOP = 200, SRC_JUMPHERE, SRC_USER };
+
+static const struct { const char* name; unsigned char kind; } dis_kinds[] = {
+  {"itof", LINK_ITOF}, {"inc", LINK_INC}, {"dec", LINK_DEC}, {"abs", LINK_ABS}, {"sign", LINK_SIGN},
+  {"input", LINK_INPUT}, {"output", LINK_OUTPUT}, {"label", LINK_LABEL}, {"gotoifp", LINK_GOTOIFP},
+  {"jumpifn", LINK_JUMPIFN}, {"loop", LINK_LOOP}, {"endloop", LINK_ENDLOOP},
+  {"load", LINK_LOAD}, {"save", LINK_SAVE}, {"add", LINK_ADD}, {"sub", LINK_SUB}, {"mul", LINK_MUL},
+  {"div", LINK_DIV}, {"nop", SRC_NOP}, {"jumphere", SRC_JUMPHERE}
+};
+
+static void opcodeKinds(InstructionSet& iset, vector<unsigned char>& kinds)
+{
+  kinds.assign(iset.size(), LINK_CALL);
+  for (unsigned op=0;op<iset.size();op++) {
+    if (op<iset.numericInstructions()) {
+      kinds[op] = LINK_SETI;
+      continue;
+    }
+    if (!iset.isDIS(op)) {
+      kinds[op] = SRC_USER;
+      continue;
+    }
+    for (unsigned j=0;j<sizeof(dis_kinds)/sizeof(dis_kinds[0]);j++)
+      if (iset.is(op, dis_kinds[j].name))
+        kinds[op] = dis_kinds[j].kind;
+  }
+}
+
+static inline bool isPlainMemOp(unsigned char k) { return (k>=LINK_LOAD) && (k<=LINK_DIV); }
+
+static bool link(const vector<unsigned char>& kinds, const ByteCode& bc, LinkedProgram& lp)
+{
+  const unsigned n = bc.size();
+  vector<unsigned char> k(n);
+  for (unsigned i=0;i<n;i++) {
+    if ( (bc[i]>=kinds.size()) || (kinds[bc[i]]==SRC_USER) )
+      return false;
+    k[i] = kinds[bc[i]];
+  }
+
+  // loop table, exactly as DIS::Loop::build_L_table() (including its depth count and the 0 = "no match" quirk)
+  vector<unsigned> l_addr(n, 0);
+  int max_depth = 0;
+  for (unsigned c=0;c<n;c++) {
+    if (k[c]!=LINK_LOOP)
+      continue;
+    int depth = 1;
+    unsigned open = 1, s = c+1;
+    while ( (open>0) && (s<n) ) {
+      if (k[s]==LINK_LOOP) { open++; depth++; }
+      if (k[s]==LINK_ENDLOOP) open--;
+      s++;
+    }
+    if (open==0) {
+      if (depth>max_depth)
+        max_depth = depth;
+      l_addr[c] = s-1;
+      l_addr[s-1] = c;
+    }
+  }
+
+  // jump table, as DIS::JumpIfN::build_J_table()
+  vector<unsigned> j_addr(n, 0);
+  for (unsigned c=0;c<n;c++) {
+    if (k[c]!=LINK_JUMPIFN)
+      continue;
+    unsigned open = 1, s = c+1;
+    while ( (open>0) && (s<n) ) {
+      if (k[s]==LINK_JUMPIFN) open++;
+      if (k[s]==SRC_JUMPHERE) open--;
+      s++;
+    }
+    if (open==0)
+      j_addr[c] = s-1;
+  }
+
+  // Stripped instructions never move control, so the op after them always runs when they would have and
+  // counts them. The only way to land inside such a run is a jumpifn to a stripped jumphere, which is why
+  // jumpifn carries an adjustment.
+  vector<bool> stripped(n, false);
+  for (unsigned i=0;i<n;i++)
+    stripped[i] = (k[i]==SRC_NOP) || (k[i]==SRC_JUMPHERE) || ( (k[i]==LINK_SETI) && (i+1<n) && (k[i+1]==LINK_SETI) );
+
+  LinkedProgram out;
+  out.n_loops = 0;
+  out.max_depth = max_depth;
+  out.source_length = n;
+  out.n_stripped = 0;
+  out.n_fused = 0;
+
+  vector<unsigned> at(n+1, 0); // op that runs (or counts) each source position
+  vector<unsigned> run_start; // per op, first source position it counts
+  vector<unsigned> loop_no(n, 0);
+  unsigned pending = 0, first = 0;
+
+  for (unsigned i=0;i<n;i++) {
+    if (stripped[i]) {
+      if (pending==0)
+        first = i;
+      pending++;
+      out.n_stripped++;
+      continue;
+    }
+
+    LinkedOp op;
+    op.kind = k[i];
+    op.weight = pending + 1;
+    op.arg = 0;
+    op.target = linkNone;
+    op.adjust = 0;
+    run_start.push_back(pending ? first : i);
+    pending = 0;
+    at[i] = out.code.size();
+
+    if ( (k[i]==LINK_SETI) && (i+1<n) && isPlainMemOp(k[i+1]) ) {
+      op.kind = k[i+1] + (LINK_LOAD_I-LINK_LOAD);
+      op.arg = bc[i];
+      op.weight++;
+      out.n_fused++;
+      at[++i] = out.code.size();
+    }
+    else if (k[i]==LINK_SETI)
+      op.arg = bc[i];
+    else if (k[i]==LINK_CALL) {
+      op.arg = bc[i];
+      op.weight--; // counted by the instruction itself
+    }
+    else if (k[i]==LINK_LOOP)
+      op.arg = loop_no[i] = out.n_loops++;
+
+    out.code.push_back(op);
+  }
+
+  LinkedOp end;
+  end.kind = LINK_END;
+  end.weight = pending;
+  end.arg = 0;
+  end.target = linkNone;
+  end.adjust = 0;
+  run_start.push_back(pending ? first : n);
+  at[n] = out.code.size();
+  out.code.push_back(end);
+
+  for (int i=(int)n-1;i>=0;i--)
+    if (stripped[i])
+      at[i] = at[i+1];
+
+  for (unsigned i=0;i<n;i++) {
+    if (stripped[i])
+      continue;
+    LinkedOp& op = out.code[at[i]];
+    if ( (op.kind==LINK_LOOP) && l_addr[i] )
+      op.target = at[l_addr[i]]; // resumes after the endloop
+    else if ( (op.kind==LINK_ENDLOOP) && l_addr[i] ) {
+      op.target = at[l_addr[i]]; // resumes after the loop
+      op.arg = loop_no[l_addr[i]];
+    }
+    else if ( (op.kind==LINK_JUMPIFN) && j_addr[i] ) {
+      const unsigned t = j_addr[i]; // the jumphere; the interpreter resumes at t+1
+      const unsigned a = at[t+1];
+      op.target = a-1;
+      op.adjust = t+1-run_start[a]; // stripped positions run_start[a]..t are jumped over
+    }
+  }
+
+  lp = out;
+  return true;
+}
+
+// One run of a linked program; the same setup as runByteCodeUntil()
+static bool runLinked(InstructionSet& iset,
+                      MemCore& core,
+                      const LinkedProgram& lp,
+                      long randseed,
+                      const atomic<bool>& stop,
+                      int max_loop_depth,
+                      EvalResult& res)
+{
+  core.c = 0;
+  *core.ran_ptr = (randseed>0) ? -randseed : randseed;
+  core.beginRun();
+  core.L_table_count.assign(lp.n_loops, 0);
+  iset.clear();
+  iset.setMaxLoopDepth(max_loop_depth);
+
+  const LinkedOp* code = lp.code.data();
+  const unsigned n = lp.code.size();
+  const bool too_deep = (max_loop_depth>=0) && (lp.max_depth>max_loop_depth);
+  bool loops_built = false; // the interpreter's loop-table exists once a loop instruction has run
+  unsigned n_ops = 0, n_invops = 0, n_inputs_bf_output = 0; // n_ops may wrap while a jumpifn adjustment is pending
+  bool failed = false;
+
+  try
+  {
+    for (unsigned pc=0;pc<n;pc++) {
+      if (stop.load(memory_order_relaxed))
+        break;
+
+      const LinkedOp& op = code[pc];
+      n_ops += op.weight;
+      if (op.kind>=LINK_LOAD_I)
+        core.I = op.arg;
+
+      switch (op.kind) {
+        case LINK_SETI:
+          core.I = op.arg;
+          break;
+        case LINK_ITOF:
+          if (!core.setF((double)core.I))
+            n_invops++;
+          break;
+        case LINK_INC:
+          if (!core.setF(core.getF()+1.0))
+            n_invops++;
+          break;
+        case LINK_DEC:
+          if (!core.setF(core.getF()-1.0))
+            n_invops++;
+          break;
+        case LINK_ABS:
+          core.setF(std::fabs(core.getF()));
+          break;
+        case LINK_SIGN:
+          core.setF(-core.getF());
+          break;
+        case LINK_INPUT: {
+          double x;
+          if (core.nextInput(x))
+            core.setF(x);
+          if (!core.output_executed)
+            n_inputs_bf_output++;
+          break;
+        }
+        case LINK_OUTPUT:
+          core.putOutput(core.getF());
+          core.output_executed = true;
+          break;
+        case LINK_LABEL:
+          if (core.I<core.L_size) {
+            core.L[core.I] = pc;
+            core.L_saved[core.I] = true;
+          }
+          else
+            n_invops++;
+          break;
+        case LINK_GOTOIFP:
+          if ( (core.I<core.L_size) && core.L_saved[core.I] ) {
+            if (core.getF()>=0)
+              pc = core.L[core.I];
+          }
+          else
+            n_invops++;
+          break;
+        case LINK_JUMPIFN:
+          if (core.getF()<0) {
+            if (op.target!=linkNone) {
+              pc = op.target;
+              n_ops -= op.adjust;
+            }
+            else
+              n_invops++;
+          }
+          break;
+        case LINK_LOOP:
+          if (!loops_built) {
+            loops_built = true;
+            if (too_deep)
+              throw 0;
+          }
+          if (op.target!=linkNone) {
+            if (core.I==0)
+              pc = op.target;
+            else
+              core.L_table_count[op.arg] = core.I;
+          }
+          else
+            n_invops++;
+          break;
+        case LINK_ENDLOOP:
+          if ( loops_built && (op.target!=linkNone) ) {
+            if (core.L_table_count[op.arg]>1) {
+              pc = op.target;
+              core.L_table_count[op.arg]--;
+            }
+          }
+          else
+            n_invops++;
+          break;
+        case LINK_CALL:
+          iset.exec(op.arg, core);
+          break;
+        case LINK_END:
+          break;
+        case LINK_SAVE:
+        case LINK_SAVE_I:
+          if (core.I<core.D_size) {
+            core.D[core.I] = core.getF();
+            core.D_saved[core.I] = true;
+          }
+          else
+            n_invops++;
+          break;
+        default: { // load, add, sub, mul, div: need a saved D[I]
+          if ( (core.I>=core.D_size) || (!core.D_saved[core.I]) ) {
+            n_invops++;
+            break;
+          }
+          const double d = core.D[core.I], f = core.getF();
+          double y;
+          switch (op.kind) {
+            case LINK_LOAD: case LINK_LOAD_I: y = d; break;
+            case LINK_ADD: case LINK_ADD_I: y = f+d; break;
+            case LINK_SUB: case LINK_SUB_I: y = f-d; break;
+            case LINK_MUL: case LINK_MUL_I: y = f*d; break;
+            default: y = f/d; break;
+          }
+          if (!core.setF(y))
+            n_invops++;
+        }
+      }
+    }
+  }
+  catch(int whatever)
+  {
+    failed = true; // loop depth exceeded
+  }
+
+  res.n_ops += n_ops + iset.getTotalOps();
+  res.n_invops += n_invops + iset.getTotalInvops();
+  res.n_inputs_bf_output += n_inputs_bf_output + iset.getTotalInputsBFOutput();
+
+  return failed || stop.load(memory_order_relaxed);
+}
+
+
+/*
+ *
+ * Functions
+ *
+ */
+
+uint64_t hashProgram(const ProgramView& p)
+{
+  uint64_t h = 0xcbf29ce484222325ULL;
+  for (unsigned i=0;i<p.size();i++)
+    h = (h ^ (uint64_t)p[i]) * 0x100000001b3ULL;
+  return h;
+}
+
+bool linkProgram(InstructionSet& iset, const ByteCode& bc, LinkedProgram& lp)
+{
+  vector<unsigned char> kinds;
+  opcodeKinds(iset, kinds);
+  return link(kinds, bc, lp);
+}
+
+bool runFitnessCases(InstructionSet& iset,
+                     MemCore& core,
+                     const LinkedProgram& lp,
+                     FitnessCases& cases,
+                     long randseed,
+                     const atomic<bool>& stop,
+                     int max_loop_depth,
+                     EvalResult& res)
+{
+  vector<double>* const input = core.input; // restored on exit, as runFitnessCases() does
+  vector<double>* const output = core.output;
+  const IOMode io_mode = core.io.mode;
+  core.io.mode = IO_BUFFER;
+
+  const uint64_t t0 = metricsEnabled() ? metricsClock() : 0;
+  unsigned loop_aborts = 0;
+
+  res.clear();
+  res.outputs.resize(cases.size());
+
+  for (unsigned k=0;k<cases.size();k++) {
+    if (stop.load(memory_order_relaxed))
+      break;
+
+    core.reset();
+    core.input = &cases[k];
+    core.output = &res.outputs[k];
+
+    if (runLinked(iset, core, lp, randseed, stop, max_loop_depth, res)) {
+      res.n_failed++;
+      if (!stop.load(memory_order_relaxed))
+        loop_aborts++;
+    }
+    res.n_cases++;
+  }
+
+  if (stop.load(memory_order_relaxed))
+    res.cancelled = true;
+  res.outputs.resize(res.n_cases);
+
+  core.input = input;
+  core.output = output;
+  core.io.mode = io_mode;
+
+  if (metricsEnabled())
+    recordEvaluation(t0, res.n_cases, res.n_ops, res.n_invops, 0, loop_aborts);
+
+  return res.n_failed>0;
+}
+
+
+/*
+ *
+ * Class methods
+ *
+ */
+
+//
+//  Class: TieredEvaluator
+//
+
+enum { ENTRY_COUNTING, ENTRY_QUEUED, ENTRY_PROMOTED, ENTRY_REJECTED };
+
+struct TieredEvaluator::Entry
+{
+  unsigned long count; // evaluations
+  int state;
+  ByteCode code; // kept from the promotion on, to tell hash collisions apart
+  shared_ptr<const LinkedProgram> linked;
+  unsigned long long ns0, ops0; // time and instructions on the interpreter
+  bool referenced; // evaluated since the clock hand last passed
+  Entry() : count(0), state(ENTRY_COUNTING), ns0(0), ops0(0), referenced(true) {}
+};
+
+TieredEvaluator::TieredEvaluator(InstructionSet& proto,
+                                 unsigned _threshold,
+                                 bool _background,
+                                 unsigned _max_entries)
+{
+  opcodeKinds(proto, kinds);
+  threshold = _threshold ? _threshold : 1;
+  background = _background;
+  max_entries = _max_entries ? _max_entries : 1;
+  hand = 0;
+  n_linking = 0;
+  shutting_down = false;
+  st = TierStats();
+
+  if (background)
+    linker = thread(&TieredEvaluator::linkerLoop, this);
+}
+
+TieredEvaluator::~TieredEvaluator()
+{
+  {
+    lock_guard<mutex> lock(mtx);
+    shutting_down = true;
+  }
+  queue_cv.notify_all();
+  if (linker.joinable())
+    linker.join();
+}
+
+void TieredEvaluator::linkerLoop()
+{
+  unique_lock<mutex> lock(mtx);
+  while (true) {
+    while ( queue.empty() && (!shutting_down) )
+      queue_cv.wait(lock);
+    if (shutting_down)
+      break;
+    const uint64_t h = queue.front();
+    queue.pop_front();
+    promote(h, lock);
+  }
+}
+
+void TieredEvaluator::promote(uint64_t hash, unique_lock<mutex>& lock)
+{
+  unordered_map<uint64_t, Entry>::iterator it = table.find(hash);
+  if (it!=table.end()) {
+    const ByteCode code = it->second.code;
+    const unsigned long evaluations = it->second.count;
+
+    lock.unlock();
+    const chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+    shared_ptr<LinkedProgram> lp = make_shared<LinkedProgram>();
+    const bool ok = link(kinds, code, *lp);
+    const unsigned long long ns = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now()-t0).count();
+    lock.lock();
+
+    it = table.find(hash); // clear() may have run meanwhile
+    if (it!=table.end()) {
+      PromotionRecord r;
+      r.hash = hash;
+      r.evaluations = evaluations;
+      r.promoted = ok;
+      r.source_length = code.size();
+      r.linked_length = ok ? lp->code.size() : 0;
+      r.n_stripped = ok ? lp->n_stripped : 0;
+      r.n_fused = ok ? lp->n_fused : 0;
+      log.push_back(r);
+
+      st.ns_linking += ns;
+      if (ok) {
+        it->second.state = ENTRY_PROMOTED;
+        it->second.linked = lp;
+        st.n_promoted++;
+      }
+      else {
+        it->second.state = ENTRY_REJECTED;
+        it->second.code.clear();
+        st.n_rejected++;
+      }
+    }
+  }
+
+  n_linking--;
+  idle_cv.notify_all();
+}
+
+TieredEvaluator::Entry& TieredEvaluator::insert(uint64_t hash)
+{
+  if (ring.size()<max_entries)
+    ring.push_back(hash);
+  else {
+    // Second chance: each entry evaluated since the last sweep is spared once. Entries waiting for the
+    // linker are skipped; if nothing else can go, the table grows instead.
+    unsigned steps;
+    for (steps=0;steps<2*ring.size();steps++) {
+      Entry& e = table.find(ring[hand])->second;
+      if ( e.referenced || (e.state==ENTRY_QUEUED) )
+        e.referenced = false;
+      else
+        break;
+      hand = (hand+1)%ring.size();
+    }
+    if (steps<2*ring.size()) {
+      table.erase(ring[hand]);
+      ring[hand] = hash;
+      hand = (hand+1)%ring.size();
+    }
+    else
+      ring.push_back(hash);
+  }
+  return table.emplace(hash, Entry()).first->second;
+}
+
+bool TieredEvaluator::evaluate(InstructionSet& iset,
+                               MemCore& core,
+                               ByteCode& bc,
+                               FitnessCases& cases,
+                               long randseed,
+                               const atomic<bool>& stop,
+                               int max_loop_depth,
+                               EvalResult& res)
+{
+  const uint64_t h = hashProgram(bc);
+  shared_ptr<const LinkedProgram> lp;
+
+  {
+    unique_lock<mutex> lock(mtx);
+    unordered_map<uint64_t, Entry>::iterator it = table.find(h);
+    Entry& e = (it!=table.end()) ? it->second : insert(h);
+    e.count++;
+    e.referenced = true;
+    if ( (e.state==ENTRY_COUNTING) && (e.count>=threshold) ) {
+      e.state = ENTRY_QUEUED;
+      e.code = bc;
+      n_linking++;
+      if (background) {
+        queue.push_back(h);
+        queue_cv.notify_one();
+      }
+      else
+        promote(h, lock);
+    }
+    if ( (e.state==ENTRY_PROMOTED) && (e.code==bc) )
+      lp = e.linked;
+  }
+
+  const chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+  const bool failed = lp ? runFitnessCases(iset, core, *lp, cases, randseed, stop, max_loop_depth, res)
+                         : runFitnessCases(iset, core, bc, cases, randseed, stop, max_loop_depth, res);
+  const unsigned long long ns = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now()-t0).count();
+
+  {
+    lock_guard<mutex> lock(mtx);
+    const int tier = lp ? 1 : 0;
+    st.evals[tier]++;
+    st.ops[tier] += res.n_ops;
+    st.ns[tier] += ns;
+
+    unordered_map<uint64_t, Entry>::iterator it = table.find(h);
+    if (it!=table.end()) {
+      Entry& e = it->second;
+      if (!lp) {
+        e.ns0 += ns;
+        e.ops0 += res.n_ops;
+      }
+      else if (e.ops0>0)
+        st.ns_saved += (double)e.ns0/e.ops0*res.n_ops - (double)ns;
+    }
+  }
+
+  return failed;
+}
+
+void TieredEvaluator::waitPromotions()
+{
+  unique_lock<mutex> lock(mtx);
+  while (n_linking>0)
+    idle_cv.wait(lock);
+}
+
+TierStats TieredEvaluator::stats()
+{
+  lock_guard<mutex> lock(mtx);
+  TierStats s = st;
+  s.n_programs = table.size();
+  s.n_pending = n_linking;
+  return s;
+}
+
+vector<PromotionRecord> TieredEvaluator::promotions()
+{
+  lock_guard<mutex> lock(mtx);
+  return log;
+}
+
+string TieredEvaluator::report()
+{
+  const TierStats s = stats();
+  const vector<PromotionRecord> decisions = promotions();
+  const char* tier_name[2] = {"interpreter", "linked"};
+  char line[256];
+  string r;
+
+  snprintf(line, sizeof(line), "programs: %lu counted, %lu promoted, %lu rejected, %lu pending (threshold %u)\n",
+           s.n_programs, s.n_promoted, s.n_rejected, s.n_pending, threshold);
+  r += line;
+  for (int t=0;t<2;t++) {
+    snprintf(line, sizeof(line), "%-11s: %lu evaluations, %llu ops, %.2f ns/op\n", tier_name[t], s.evals[t], s.ops[t],
+             s.ops[t] ? (double)s.ns[t]/s.ops[t] : 0.0);
+    r += line;
+  }
+  snprintf(line, sizeof(line), "hit rate: %.1f%% of the evaluations ran linked\n", 100*s.hitRate());
+  r += line;
+  snprintf(line, sizeof(line), "time saved: %.3f ms (estimated), linking took %.3f ms\n", s.ns_saved/1e6,
+           s.ns_linking/1e6);
+  r += line;
+
+  for (unsigned i=0;i<decisions.size();i++) {
+    const PromotionRecord& p = decisions[i];
+    if (p.promoted)
+      snprintf(line, sizeof(line), "  %016llx promoted after %lu evaluations: %u -> %u ops (%u stripped, %u fused)\n",
+               (unsigned long long)p.hash, p.evaluations, p.source_length, p.linked_length, p.n_stripped, p.n_fused);
+    else
+      snprintf(line, sizeof(line), "  %016llx rejected after %lu evaluations: instructions outside the DIS\n",
+               (unsigned long long)p.hash, p.evaluations);
+    r += line;
+  }
+  return r;
+}
+
+void TieredEvaluator::clear()
+{
+  waitPromotions();
+  lock_guard<mutex> lock(mtx);
+  table.clear();
+  ring.clear();
+  hand = 0;
+  queue.clear();
+  log.clear();
+  st = TierStats();
+}
+
+}; //namespace SlashA
@@ -0,0 +1,185 @@
+/*
+ *
+ *  SlashA_Tier.hpp - tiered execution: hot programs are promoted to a pre-linked form
+ *
+ *  Copyright (C) 2004-2011 Artur B Adib
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef SLASHA_TIER_INCLUDED // duplicate protection
+#define SLASHA_TIER_INCLUDED
+
+#include <stdint.h>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <condition_variable>
+#include "SlashA.hpp"
+
+namespace SlashA
+{
+
+  /*
+   * A linked program is a DIS program translated once for the optimized tier:
+   * - the loop and jump tables are resolved at link time, so loop, endloop and jumpifn hold their targets;
+   * - nop, jumphere and numeric instructions overwritten by the next one (introns) are stripped;
+   * - a numeric instruction followed by load, save, add, sub, mul or div is fused into one operation;
+   * - the hot instructions are run by a switch instead of a virtual call, the rest (math, ran, range
+   *   instructions...) still go through the instruction set.
+   * Every op carries the number of source instructions it stands for, so outputs, n_ops, n_invops and
+   * n_inputs_bf_output are exactly those of the interpreter. Only the per-instruction counters of the
+   * instruction set (getOps(k), getTotalInputs()...) miss the instructions run inline.
+   */
+
+  enum LinkedOpKind
+  {
+    LINK_SETI, LINK_ITOF, LINK_INC, LINK_DEC, LINK_ABS, LINK_SIGN,
+    LINK_INPUT, LINK_OUTPUT, LINK_LABEL, LINK_GOTOIFP, LINK_JUMPIFN, LINK_LOOP, LINK_ENDLOOP,
+    LINK_CALL, // any other DIS instruction, through the instruction set
+    LINK_END, // accounts for the instructions stripped at the end of the program
+    LINK_LOAD, LINK_SAVE, LINK_ADD, LINK_SUB, LINK_MUL, LINK_DIV,
+    LINK_LOAD_I, LINK_SAVE_I, LINK_ADD_I, LINK_SUB_I, LINK_MUL_I, LINK_DIV_I // fused with the numeric instruction before
+  };
+
+  const unsigned linkNone = ~0u; // target of a loop, endloop or jumpifn without a match
+
+  class LinkedOp
+  {
+    public:
+      unsigned char kind; // LinkedOpKind
+      unsigned weight; // source instructions counted when the op runs (itself and the stripped ones before it)
+      unsigned arg; // I for numeric and fused ops, the opcode for LINK_CALL, the loop number for loops
+      unsigned target; // loop/endloop/jumpifn: op after which execution resumes
+      unsigned adjust; // jumpifn: stripped instructions counted by the op it lands on but jumped over
+  };
+
+  class LinkedProgram
+  {
+    public:
+      std::vector<LinkedOp> code;
+      unsigned n_loops;
+      int max_depth; // as computed by the loop instruction, checked against max_loop_depth at the first loop run
+      unsigned source_length;
+      unsigned n_stripped;
+      unsigned n_fused;
+  };
+
+  /* Functions */
+
+  uint64_t hashProgram(const ProgramView& p); // FNV-1a over the opcodes
+
+  // Returns false (lp untouched) if bc holds instructions that are not part of the DIS.
+  bool linkProgram(InstructionSet& iset, const ByteCode& bc, LinkedProgram& lp);
+
+  // Same results as runFitnessCases() on the source program (see above for the counters).
+  bool runFitnessCases(InstructionSet& iset,
+                       MemCore& core,
+                       const LinkedProgram& lp,
+                       FitnessCases& cases,
+                       long randseed,
+                       const std::atomic<bool>& stop,
+                       int max_loop_depth,
+                       EvalResult& res);
+
+  /*
+   * Elites and their clones are evaluated over and over, most offspring only once. TieredEvaluator counts
+   * evaluations per program hash and runs every program on the interpreter until it has been evaluated
+   * "threshold" times; the program is then linked on a background thread and, once ready, later
+   * evaluations of it run the linked form. Programs with non-DIS instructions stay on the interpreter.
+   * evaluate() may be called from several threads at once, each with its own instruction set and core.
+   */
+
+  class TierStats
+  {
+    public:
+      unsigned long n_programs; // distinct programs being counted
+      unsigned long n_promoted;
+      unsigned long n_rejected; // reached the threshold but cannot be linked
+      unsigned long n_pending; // waiting for the linker
+      unsigned long evals[2]; // evaluations per tier (0: interpreter, 1: linked)
+      unsigned long long ops[2]; // instructions executed per tier
+      unsigned long long ns[2]; // time spent per tier
+      unsigned long long ns_linking;
+      double ns_saved; // estimated: linked evaluations timed against their program's interpreter ns/op
+
+      double hitRate() const { return (evals[0]+evals[1]) ? (double)evals[1]/(evals[0]+evals[1]) : 0; }
+  };
+
+  class PromotionRecord
+  {
+    public:
+      uint64_t hash;
+      unsigned long evaluations; // when it was queued
+      bool promoted; // false: rejected
+      unsigned source_length, linked_length, n_stripped, n_fused;
+  };
+
+  class TieredEvaluator
+  {
+    private:
+      struct Entry;
+
+      std::vector<unsigned char> kinds; // per opcode, from the prototype instruction set
+      unsigned threshold;
+      unsigned max_entries; // beyond this, programs are forgotten in clock order
+      bool background;
+
+      std::unordered_map<uint64_t, Entry> table;
+      std::vector<uint64_t> ring; // the hashes in the table, one slot each, swept by the clock hand
+      unsigned hand;
+      std::deque<uint64_t> queue;
+      std::vector<PromotionRecord> log;
+      TierStats st;
+      std::mutex mtx;
+      std::condition_variable queue_cv, idle_cv;
+      unsigned long n_linking; // queued or being linked
+      bool shutting_down;
+      std::thread linker;
+
+      void linkerLoop();
+      Entry& insert(uint64_t hash); // evicts the first unreferenced program past the hand once the table is full
+      void promote(uint64_t hash, std::unique_lock<std::mutex>& lock); // links the queued program, unlocking meanwhile
+
+    public:
+      TieredEvaluator(InstructionSet& proto, // only its opcode layout is used, every later set must share it
+                      unsigned _threshold = 16,
+                      bool _background = true, // false: links in the calling thread, e.g. for reproducible tests
+                      unsigned _max_entries = 1<<20);
+      ~TieredEvaluator();
+
+      // Same results as runFitnessCases(iset, core, bc, ...), on whichever tier the program is.
+      bool evaluate(InstructionSet& iset,
+                    MemCore& core,
+                    ByteCode& bc,
+                    FitnessCases& cases,
+                    long randseed,
+                    const std::atomic<bool>& stop,
+                    int max_loop_depth,
+                    EvalResult& res);
+
+      void waitPromotions(); // blocks until the linker queue is empty
+      TierStats stats();
+      std::vector<PromotionRecord> promotions(); // in the order they were decided
+      std::string report(); // stats and decisions, human readable
+      void clear(); // forgets every program and resets the stats; not while evaluations are running
+  };
+
+}; // namespace SlashA
+
+#endif // SLASHA_TIER_INCLUDED
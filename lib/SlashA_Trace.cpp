@@ -0,0 +1,445 @@
+/*
+ *
+ *  SlashA_Trace.cpp
+ *
+ *  Copyright (C) 2004-2011 Artur B Adib
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+#include "SlashA_Trace.hpp"
+#include "SlashA_Interp.hpp"
+
+using namespace std;
+
+namespace SlashA
+{
+
+/*
+ * Trace file layout (native byte order):
+ *
+ *   "SLATRC02", n_numeric, n_names, { name length, name chars } x n_names,
+ *   randseed (int64), max_loop_depth (int32), D_size, L_size,
+ *   n_input, input doubles, bc length, bc opcodes,
+ *   n_total (uint64), n_records, TraceRecord x n_records (oldest first)
+ *
+ * All unlabelled integers are uint32.
+ */
+
+static const char traceMagic[8] = { 'S','L','A','T','R','C','0','2' };
+
+
+/*
+ *
+ * Class methods
+ *
+ */
+
+//
+//  Class: TraceHeader
+//
+
+string TraceHeader::opcodeName(ByteCode_Type op) const
+{
+  if (op<n_numeric) {
+    ostringstream nstr;
+    nstr << op;
+    return nstr.str();
+  }
+  if (op-n_numeric<names.size())
+    return names[op-n_numeric];
+  return "?";
+}
+
+//
+//  Class: TraceBuffer
+//
+
+TraceBuffer::TraceBuffer(unsigned capacity)
+{
+  unsigned n=1;
+  while (n<capacity)
+    n <<= 1;
+  ring.resize(n);
+  mask = n-1;
+  names_from = NULL;
+}
+
+void TraceBuffer::begin(InstructionSet& iset, MemCore& core, ByteCode& bc, long randseed, int max_loop_depth)
+{
+  if ( (names_from!=&iset) || (header.n_numeric+header.names.size()!=iset.size()) ) { // names are cached per set
+    header.n_numeric = iset.numericInstructions();
+    header.names.clear();
+    for (unsigned i=header.n_numeric;i<iset.size();i++)
+      header.names.push_back(iset.getName(i));
+    names_from = &iset;
+  }
+
+  header.randseed = randseed;
+  header.max_loop_depth = max_loop_depth;
+  header.D_size = core.D_size;
+  header.L_size = core.L_size;
+  header.input.clear(); // filled as the program reads
+
+  header.bc = bc;
+  header.n_total = 0;
+}
+
+static void put(FILE* f, const void* p, size_t n)
+{
+  if (fwrite(p, 1, n, f)!=n)
+    throw (string)"Cannot write trace file";
+}
+
+static void put32(FILE* f, uint32_t v) { put(f, &v, sizeof(v)); }
+
+void TraceBuffer::write(const string& filename)
+{
+  FILE* f = fopen(filename.c_str(), "wb");
+  if (!f)
+    throw (string)"Cannot open trace file " + filename;
+
+  try
+  {
+    put(f, traceMagic, sizeof(traceMagic));
+    put32(f, header.n_numeric);
+    put32(f, header.names.size());
+    for (unsigned i=0;i<header.names.size();i++) {
+      put32(f, header.names[i].size());
+      put(f, header.names[i].data(), header.names[i].size());
+    }
+    int64_t seed = header.randseed;
+    int32_t ldepth = header.max_loop_depth;
+    put(f, &seed, sizeof(seed));
+    put(f, &ldepth, sizeof(ldepth));
+    put32(f, header.D_size);
+    put32(f, header.L_size);
+    put32(f, header.input.size());
+    put(f, header.input.data(), header.input.size()*sizeof(double));
+    put32(f, header.bc.size());
+    for (unsigned i=0;i<header.bc.size();i++)
+      put32(f, header.bc[i]);
+    uint64_t total = header.n_total;
+    put(f, &total, sizeof(total));
+
+    const unsigned n = size();
+    put32(f, n);
+    const unsigned long long first = dropped() & mask;
+    const unsigned long long upto_end = (ring.size()-first<n) ? ring.size()-first : n; // the kept records may wrap around
+    put(f, &ring[first], upto_end*sizeof(TraceRecord));
+    put(f, &ring[0], (n-upto_end)*sizeof(TraceRecord));
+  }
+  catch(string& err)
+  {
+    fclose(f);
+    throw err;
+  }
+
+  if (fclose(f)!=0)
+    throw (string)"Cannot write trace file " + filename;
+}
+
+//
+//  Class: TraceSampler
+//
+
+void TraceSampler::setRate(double rate)
+{
+  if (rate>=1)
+    threshold = ~(uint64_t)0;
+  else if (rate<=0)
+    threshold = 0;
+  else
+    threshold = (uint64_t)(rate*18446744073709551616.0); // rate * 2^64
+}
+
+
+/*
+ *
+ * Functions
+ *
+ */
+
+TraceBuffer& threadTraceBuffer()
+{
+  static thread_local TraceBuffer tb;
+  return tb;
+}
+
+// Builds a TraceRecord around each instruction. D[I] is sampled before and after, so save/swap show up as changes.
+struct RecordingHook
+{
+  TraceRecord r;
+  unsigned I_before;
+  double D_before;
+  bool saved_before;
+  unsigned invops_before;
+  ByteCode_Type rscale; // opcode of rscale, the one instruction writing cells other than D[I]; ~0u if absent
+
+  RecordingHook(InstructionSet& iset)
+  {
+    memset(&r, 0, sizeof(r));
+    I_before=0; D_before=0; saved_before=false; invops_before=0;
+    rscale = ~0u;
+    for (unsigned i=iset.numericInstructions();i<iset.size();i++)
+      if (iset.is(i, "rscale"))
+        rscale = i;
+  }
+
+  inline void before(InstructionSet& iset, MemCore& core, ByteCode_Type inst)
+  {
+    r.opcode = inst;
+    r.c = core.c;
+    I_before = core.I;
+    if (I_before<core.D_size) {
+      D_before = core.D[I_before];
+      saved_before = core.D_saved[I_before];
+    }
+    invops_before = iset.getInvops(inst);
+  }
+
+  inline void after(InstructionSet& iset, MemCore& core, ByteCode_Type inst)
+  {
+    r.I = core.I;
+    r.F = core.getF();
+    r.flags = 0;
+    r.D_index = I_before;
+    r.D = 0;
+    if ( (I_before<core.D_size) && ((core.D[I_before]!=D_before) || (core.D_saved[I_before]!=saved_before)) ) {
+      r.flags |= TRACE_D_CHANGED;
+      r.D = core.D[I_before];
+    }
+    if (iset.getInvops(inst)!=invops_before)
+      r.flags |= TRACE_INVALID;
+    else if (inst==rscale)
+      r.flags |= TRACE_RANGE_CHANGED;
+  }
+};
+
+struct TraceHook : public RecordingHook
+{
+  TraceBuffer& trace;
+  TraceHook(InstructionSet& iset, TraceBuffer& tb) : RecordingHook(iset), trace(tb) {}
+
+  inline void after(InstructionSet& iset, MemCore& core, ByteCode_Type inst)
+  {
+    RecordingHook::after(iset, core, inst);
+    trace.push(r);
+  }
+};
+
+// Same as runByteCodeUntil(), recording every executed instruction in "trace"
+bool runByteCodeTraced(InstructionSet& iset,
+                       MemCore& core,
+                       ByteCode& bc,
+                       long randseed,
+                       const atomic<bool>& stop,
+                       int max_loop_depth,
+                       TraceBuffer& trace)
+{
+  trace.begin(iset, core, bc, randseed, max_loop_depth);
+
+  core.setProgram(bc);
+  core.c = 0;
+  *core.ran_ptr = (randseed>0) ? -randseed : randseed;
+  core.beginRun();
+  iset.clear();
+  iset.setMaxLoopDepth(max_loop_depth);
+
+  vector<double>* const input_log = core.input_log; // restored on exit
+  core.input_log = &trace.header.input;
+  TraceHook hook(iset, trace);
+  bool failed;
+  try
+  {
+    failed = execLoop(iset, core, FlagRaised(stop), hook);
+  }
+  catch(...)
+  {
+    core.input_log = input_log;
+    throw;
+  }
+  core.input_log = input_log;
+
+  return failed || stop.load(memory_order_relaxed);
+}
+
+static void get(FILE* f, void* p, size_t n)
+{
+  if (fread(p, 1, n, f)!=n)
+    throw (string)"Truncated trace file";
+}
+
+static uint32_t get32(FILE* f) { uint32_t v; get(f, &v, sizeof(v)); return v; }
+
+// Reads a count of items of item_size bytes each, which must fit in what is left of the file
+static uint32_t getCount(FILE* f, long file_size, size_t item_size)
+{
+  const uint32_t n = get32(f);
+  const long pos = ftell(f);
+  if ( (pos<0) || ((uint64_t)n*item_size>(uint64_t)(file_size-pos)) )
+    throw (string)"Corrupt trace file: a count exceeds the file size";
+  return n;
+}
+
+void readTrace(const string& filename,
+               TraceHeader& header,
+               vector<TraceRecord>& records)
+{
+  FILE* f = fopen(filename.c_str(), "rb");
+  if (!f)
+    throw (string)"Cannot open trace file " + filename;
+
+  try
+  {
+    long file_size = -1;
+    if (fseek(f, 0, SEEK_END)==0) {
+      file_size = ftell(f);
+      rewind(f);
+    }
+    if (file_size<0)
+      throw (string)"Cannot read trace file " + filename;
+
+    char magic[sizeof(traceMagic)];
+    get(f, magic, sizeof(magic));
+    if (memcmp(magic, traceMagic, sizeof(magic))!=0)
+      throw (string)"Not a Slash/A trace file: " + filename;
+
+    header.n_numeric = get32(f);
+    header.names.resize(getCount(f, file_size, sizeof(uint32_t))); // each name holds at least its length
+    for (unsigned i=0;i<header.names.size();i++) {
+      header.names[i].resize(getCount(f, file_size, 1));
+      get(f, &header.names[i][0], header.names[i].size());
+    }
+    int64_t seed;
+    int32_t ldepth;
+    get(f, &seed, sizeof(seed));
+    get(f, &ldepth, sizeof(ldepth));
+    header.randseed = (long)seed;
+    header.max_loop_depth = ldepth;
+    header.D_size = get32(f);
+    header.L_size = get32(f);
+    header.input.resize(getCount(f, file_size, sizeof(double)));
+    get(f, header.input.data(), header.input.size()*sizeof(double));
+    header.bc.resize(getCount(f, file_size, sizeof(uint32_t)));
+    for (unsigned i=0;i<header.bc.size();i++)
+      header.bc[i] = get32(f);
+    uint64_t total;
+    get(f, &total, sizeof(total));
+    header.n_total = total;
+
+    records.resize(getCount(f, file_size, sizeof(TraceRecord)));
+    if (records.size()>header.n_total)
+      throw (string)"Corrupt trace file: more records than instructions executed";
+    get(f, records.data(), records.size()*sizeof(TraceRecord));
+  }
+  catch(string& err)
+  {
+    fclose(f);
+    throw err;
+  }
+  fclose(f);
+}
+
+// Compares every executed instruction with the retained records; raises "mismatch" on the first difference.
+struct ReplayHook : public RecordingHook
+{
+  const ByteCode& orig_bc; // opcodes as numbered in the traced instruction set
+  const vector<TraceRecord>& records;
+  unsigned long long first; // index of the first retained record
+  unsigned long long n; // instructions executed so far
+  long long bad;
+  atomic<bool> mismatch;
+
+  ReplayHook(InstructionSet& iset, const ByteCode& bc, const vector<TraceRecord>& recs, unsigned long long total)
+    : RecordingHook(iset), orig_bc(bc), records(recs), n(0), bad(-1), mismatch(false) { first = total-recs.size(); }
+
+  inline void after(InstructionSet& iset, MemCore& core, ByteCode_Type inst)
+  {
+    RecordingHook::after(iset, core, inst);
+    r.opcode = orig_bc[r.c];
+    if (n>=first) {
+      const TraceRecord& e = (n-first<records.size()) ? records[n-first] : r;
+      if ( (n-first>=records.size()) || (e.opcode!=r.opcode) || (e.c!=r.c) || (e.I!=r.I) || (e.flags!=r.flags)
+           || (e.D_index!=r.D_index) || (e.F!=r.F) || (e.D!=r.D) ) {
+        bad = n-first;
+        mismatch = true;
+      }
+    }
+    n++;
+  }
+};
+
+long long replayTrace(InstructionSet& iset,
+                      const TraceHeader& header,
+                      const vector<TraceRecord>& records,
+                      string& report)
+{
+  if (records.size()>header.n_total) // the retained records are the last ones executed
+    throw (string)"The trace holds more records than instructions executed";
+
+  ByteCode bc(header.bc.size());
+
+  for (unsigned i=0;i<bc.size();i++) { // renumbers the program for iset
+    if (header.bc[i]<header.n_numeric) {
+      if (header.bc[i]>=iset.numericInstructions())
+        throw (string)"Instruction set has too few numeric instructions to replay this trace";
+      bc[i] = header.bc[i];
+    }
+    else
+      bc[i] = instruction2ByteCode(header.opcodeName(header.bc[i]), iset);
+  }
+
+  vector<double> input = header.input, output;
+  MemCore core(header.D_size, header.L_size, input, output);
+  core.setIO(IOPolicy::buffers()); // the recorded inputs, then none, as in the traced run
+
+  core.setProgram(bc);
+  core.c = 0;
+  *core.ran_ptr = (header.randseed>0) ? -header.randseed : header.randseed;
+  core.beginRun();
+  iset.clear();
+  iset.setMaxLoopDepth(header.max_loop_depth);
+
+  ReplayHook hook(iset, header.bc, records, header.n_total);
+  execLoop(iset, core, FlagRaised(hook.mismatch), hook);
+
+  ostringstream rep;
+  if ( (hook.bad<0) && (hook.n!=header.n_total) ) // ran shorter than the trace
+    hook.bad = (hook.n>hook.first) ? (long long)(hook.n-hook.first) : 0;
+
+  if (hook.bad<0)
+    rep << "Replay matches all " << records.size() << " records (" << hook.n << " instructions executed)";
+  else if ((unsigned long long)hook.bad<records.size()) {
+    const TraceRecord& e = records[hook.bad];
+    rep << "Replay diverges at record " << hook.bad << " (c=" << e.c << ", " << header.opcodeName(e.opcode) << "):"
+        << " traced F=" << e.F << " I=" << e.I << " flags=" << e.flags;
+    if (hook.n-hook.first==(unsigned long long)hook.bad+1)
+      rep << ", replayed c=" << hook.r.c << " " << header.opcodeName(hook.r.opcode)
+          << " F=" << hook.r.F << " I=" << hook.r.I << " flags=" << hook.r.flags;
+    else
+      rep << ", replay stopped after " << hook.n << " instructions";
+  }
+  else
+    rep << "Replay runs longer than the trace (" << header.n_total << " instructions traced)";
+
+  report = rep.str();
+  return hook.bad;
+}
+
+}; //namespace SlashA
@@ -0,0 +1,130 @@
+/*
+ *
+ *  SlashA_Trace.hpp - binary execution traces and deterministic replay
+ *
+ *  Copyright (C) 2004-2011 Artur B Adib
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef SLASHA_TRACE_INCLUDED // duplicate protection
+#define SLASHA_TRACE_INCLUDED
+
+#include <stdint.h>
+#include "SlashA.hpp"
+
+namespace SlashA
+{
+
+  const uint32_t TRACE_D_CHANGED = 1; // the instruction wrote D[D_index] (the new value is in TraceRecord::D)
+  const uint32_t TRACE_INVALID = 2; // the instruction counted an invalid operation
+  // rscale scaled the window D[I+1], ..., D[I+n] (I as before the instruction). The new values of the window
+  // are not recorded; rsum, dot and horner only read theirs.
+  const uint32_t TRACE_RANGE_CHANGED = 4;
+
+  struct TraceRecord // one per executed instruction, 40 bytes
+  {
+    uint32_t opcode;
+    uint32_t c; // program position of the instruction
+    uint32_t I; // I-register after execution
+    uint32_t flags; // TRACE_* bits
+    uint32_t D_index; // I-register before execution: the cell D refers to
+    uint32_t unused; // zero
+    double F; // F-register after execution
+    double D; // D[D_index] after execution, only meaningful with TRACE_D_CHANGED
+  };
+
+  class TraceHeader // everything needed to decode and replay a trace
+  {
+    public:
+      unsigned n_numeric; // numeric instructions of the instruction set that was traced
+      std::vector<std::string> names; // names of the remaining instructions, in opcode order
+      long randseed;
+      int max_loop_depth;
+      unsigned D_size;
+      unsigned L_size;
+      std::vector<double> input; // values the program read, in order, whatever the I/O mode of the core
+      ByteCode bc;
+      unsigned long long n_total; // instructions executed; only the last records fit in the ring
+
+      TraceHeader() { n_numeric=0; randseed=0; max_loop_depth=-1; D_size=L_size=0; n_total=0; }
+      std::string opcodeName(ByteCode_Type op) const;
+  };
+
+  class TraceBuffer // fixed-size ring, one per thread (see threadTraceBuffer())
+  {
+    private:
+      std::vector<TraceRecord> ring;
+      unsigned long long mask;
+      InstructionSet* names_from; // instruction set whose names are cached in header
+    public:
+      TraceHeader header;
+
+      TraceBuffer(unsigned capacity = 65536); // rounded up to a power of two
+
+      void begin(InstructionSet& iset, MemCore& core, ByteCode& bc, long randseed, int max_loop_depth);
+      inline void push(const TraceRecord& r) { ring[header.n_total & mask] = r; header.n_total++; }
+
+      unsigned capacity() { return (unsigned)ring.size(); }
+      unsigned size() { return (header.n_total<ring.size()) ? (unsigned)header.n_total : (unsigned)ring.size(); }
+      unsigned long long dropped() { return header.n_total - size(); } // records overwritten by newer ones
+      const TraceRecord& record(unsigned i) { return ring[(dropped()+i) & mask]; } // i-th oldest record kept
+
+      void write(const std::string& filename); // throws a string on I/O errors
+  };
+
+  TraceBuffer& threadTraceBuffer(); // the calling thread's ring buffer
+
+  class TraceSampler // decides which evaluations get traced
+  {
+    private:
+      uint64_t threshold;
+      uint64_t state;
+    public:
+      TraceSampler(double rate, uint64_t seed = 0x9E3779B97F4A7C15ULL) { setRate(rate); state = seed ? seed : 1; }
+      void setRate(double rate);
+      inline bool sample() // xorshift64, no locking: use one sampler per thread
+      {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        return state < threshold;
+      }
+  };
+
+  /* Functions */
+
+  bool runByteCodeTraced(InstructionSet& iset,
+                         MemCore& core,
+                         ByteCode& bc,
+                         long randseed,
+                         const std::atomic<bool>& stop,
+                         int max_loop_depth,
+                         TraceBuffer& trace);
+
+  void readTrace(const std::string& filename,
+                 TraceHeader& header,
+                 std::vector<TraceRecord>& records); // throws a string on I/O or format errors
+
+  // Re-runs the traced program with the recorded seed and input on iset (instructions are matched by name)
+  // and compares every retained record. Returns the index of the first mismatching record, or -1.
+  long long replayTrace(InstructionSet& iset,
+                        const TraceHeader& header,
+                        const std::vector<TraceRecord>& records,
+                        std::string& report);
+
+}; // namespace SlashA
+
+#endif // SLASHA_TRACE_INCLUDED
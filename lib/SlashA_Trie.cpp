@@ -0,0 +1,336 @@
+/*
+ *
+ *  SlashA_Trie.cpp
+ *
+ *  Copyright (C) 2004-2011 Artur B Adib
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <cstring>
+#include "SlashA_Trie.hpp"
+#include "SlashA_Partial.hpp"
+#include "SlashA_Interp.hpp"
+#include "SlashA_Metrics.hpp"
+
+using namespace std;
+
+namespace SlashA
+{
+
+static const unsigned no_program = ~0u;
+
+
+/*
+ *
+ * PrefixTrie
+ *
+ */
+
+PrefixTrie::PrefixTrie(InstructionSet& iset) : n_numeric(iset.numericInstructions())
+{
+  for (unsigned i=n_numeric;i<iset.size();i++)
+    state_only.push_back(isStateOnly(i, iset));
+  clear();
+}
+
+void PrefixTrie::clear()
+{
+  Node root;
+  root.op = 0;
+  root.first_child = root.next_sibling = 0;
+  root.first_program = no_program;
+  nodes.assign(1, root);
+  programs.clear();
+  prefix.clear();
+  next_program.clear();
+  children.clear();
+  n_prefix = 0;
+}
+
+unsigned PrefixTrie::insert(const ProgramView& p)
+{
+  unsigned node = 0;
+  unsigned i = 0;
+  for (;i<p.length;i++) {
+    if ( (p[i]>=n_numeric) && ((p[i]-n_numeric>=state_only.size()) || (!state_only[p[i]-n_numeric])) )
+      break;
+    const uint64_t key = ((uint64_t)node<<32) | p[i];
+    unordered_map<uint64_t, unsigned>::iterator it = children.find(key);
+    if (it!=children.end()) {
+      node = it->second;
+      continue;
+    }
+    Node n;
+    n.op = p[i];
+    n.first_child = 0;
+    n.next_sibling = nodes[node].first_child;
+    n.first_program = no_program;
+    nodes.push_back(n);
+    nodes[node].first_child = nodes.size()-1;
+    children[key] = nodes.size()-1;
+    node = nodes.size()-1;
+  }
+
+  n_prefix += i;
+  programs.push_back(p);
+  prefix.push_back(i);
+  next_program.push_back(nodes[node].first_program);
+  nodes[node].first_program = programs.size()-1;
+  return programs.size()-1;
+}
+
+
+/*
+ *
+ * TrieEvaluator
+ *
+ */
+
+class TrieEvaluator::Snapshot
+{
+  public:
+    double F;
+    unsigned I, in_pos, out_pos, n_outputs;
+    bool output_executed;
+    vector<double> D;
+    vector<unsigned> L;
+    vector<unsigned char> D_saved, L_saved;
+    NumericalRecipes::Ran2State ran;
+};
+
+TrieEvaluator::TrieEvaluator(unsigned _D_size,
+                             unsigned _L_size,
+                             unsigned _lanes)
+{
+  if (_lanes==0)
+    throw (string)"A trie evaluator needs at least one lane";
+
+  D_size = _D_size;
+  L_size = _L_size;
+  lanes = _lanes;
+  outputs.resize(lanes);
+  for (unsigned i=0;i<lanes;i++) {
+    cores.push_back(new MemCore(D_size, L_size, no_input, outputs[i]));
+    cores.back()->setIO(IOPolicy::buffers());
+  }
+}
+
+TrieEvaluator::~TrieEvaluator()
+{
+  for (unsigned i=0;i<cores.size();i++)
+    delete cores[i];
+}
+
+void TrieEvaluator::save(unsigned level)
+{
+  if (level==saved.size()) {
+    saved.resize(level+1);
+    saved[level].resize(lanes);
+    for (unsigned i=0;i<lanes;i++) {
+      saved[level][i].D.resize(D_size);
+      saved[level][i].L.resize(L_size);
+      saved[level][i].D_saved.resize(D_size);
+      saved[level][i].L_saved.resize(L_size);
+    }
+    saved_counts.resize(3*(level+1));
+  }
+  saved_counts[3*level] = n_ops;
+  saved_counts[3*level+1] = n_invops;
+  saved_counts[3*level+2] = n_inputs_bf_output;
+  for (unsigned i=0;i<n;i++) {
+    const MemCore& core = *cores[i];
+    Snapshot& s = saved[level][i];
+    s.F = cores[i]->getF();
+    s.I = core.I;
+    s.in_pos = core.in_pos;
+    s.out_pos = core.out_pos;
+    s.n_outputs = outputs[i].size();
+    s.output_executed = core.output_executed;
+    memcpy(s.D.data(), core.D, D_size*sizeof(double));
+    memcpy(s.L.data(), core.L, L_size*sizeof(unsigned));
+    memcpy(s.D_saved.data(), core.D_saved, D_size*sizeof(bool));
+    memcpy(s.L_saved.data(), core.L_saved, L_size*sizeof(bool));
+    s.ran = core.ran;
+  }
+}
+
+void TrieEvaluator::restore(unsigned level)
+{
+  n_ops = saved_counts[3*level];
+  n_invops = saved_counts[3*level+1];
+  n_inputs_bf_output = saved_counts[3*level+2];
+  for (unsigned i=0;i<n;i++) {
+    MemCore& core = *cores[i];
+    const Snapshot& s = saved[level][i];
+    core.setF(s.F);
+    core.I = s.I;
+    core.in_pos = s.in_pos;
+    core.out_pos = s.out_pos;
+    outputs[i].resize(s.n_outputs);
+    core.output_executed = s.output_executed;
+    memcpy(core.D, s.D.data(), D_size*sizeof(double));
+    memcpy(core.L, s.L.data(), L_size*sizeof(unsigned));
+    memcpy(core.D_saved, s.D_saved.data(), D_size*sizeof(bool));
+    memcpy(core.L_saved, s.L_saved.data(), L_size*sizeof(bool));
+    core.ran = s.ran;
+  }
+}
+
+// State-only instructions change their own counters and no other
+void TrieEvaluator::exec(ByteCode_Type op)
+{
+  const unsigned ops = iset->getOps(op), invops = iset->getInvops(op), ibf = iset->getInputsBeforeOutput(op);
+  iset->execLanes(op, &cores[0], n);
+  n_ops += iset->getOps(op)-ops;
+  n_invops += iset->getInvops(op)-invops;
+  n_inputs_bf_output += iset->getInputsBeforeOutput(op)-ibf;
+}
+
+// Runs the rest of program p, if any, on every lane and records the cases of the block. Returns true if
+// the cores were changed.
+bool TrieEvaluator::finish(unsigned p)
+{
+  const ProgramView& prog = trie->programs[p];
+  const unsigned pre = trie->prefix[p];
+  EvalResult& res = (*results)[p];
+
+  res.n_cases += n;
+  res.n_ops += n_ops;
+  res.n_invops += n_invops;
+  res.n_inputs_bf_output += n_inputs_bf_output;
+
+  for (unsigned i=0;i<n;i++) {
+    bool failed = false;
+    if (pre<prog.length) {
+      MemCore& core = *cores[i];
+      iset->clear();
+      core.setProgram(prog);
+      core.c = pre;
+      core.L_table_addr.clear(); // built over the whole program when needed, as in a run from the start
+      core.L_table_count.clear();
+      core.J_table.clear();
+      failed = execLoop(*iset, core, FlagRaised(*stop));
+      res.n_ops += iset->getTotalOps();
+      res.n_invops += iset->getTotalInvops();
+      res.n_inputs_bf_output += iset->getTotalInputsBFOutput();
+    }
+    if (failed || stop->load(memory_order_relaxed)) {
+      res.n_failed++;
+      any_failed = true;
+      if (!stop->load(memory_order_relaxed))
+        loop_aborts[p]++;
+    }
+    res.outputs[first+i].assign(outputs[i].begin(), outputs[i].end());
+  }
+  return pre<prog.length;
+}
+
+// The cores hold the state after the prefix of node. Chains are followed without saving anything; the
+// cores are saved where more than one program or branch continues from them. Once stop is raised the walk
+// is abandoned: programs not reached do not get the cases of this block.
+void TrieEvaluator::visit(unsigned node, unsigned level)
+{
+  const PrefixTrie::Node* nodes = trie->nodes.data();
+  const unsigned* next_program = trie->next_program.data();
+
+  while ( (nodes[node].first_program==no_program) && nodes[node].first_child &&
+          (!nodes[nodes[node].first_child].next_sibling) ) {
+    if (stop->load(memory_order_relaxed))
+      return;
+    node = nodes[node].first_child;
+    exec(nodes[node].op);
+  }
+
+  const PrefixTrie::Node& nd = nodes[node];
+  const bool branches = nd.first_child || ( (nd.first_program!=no_program) && (next_program[nd.first_program]!=no_program) );
+  if (branches)
+    save(level);
+
+  bool changed = false;
+  for (unsigned p=nd.first_program;p!=no_program;p=next_program[p]) {
+    if (changed)
+      restore(level);
+    changed = finish(p);
+  }
+  for (unsigned c=nd.first_child;c;c=nodes[c].next_sibling) {
+    if (stop->load(memory_order_relaxed))
+      return;
+    if (changed)
+      restore(level);
+    exec(nodes[c].op);
+    visit(c, level+1);
+    changed = true;
+  }
+}
+
+bool TrieEvaluator::run(InstructionSet& _iset,
+                        const PrefixTrie& _trie,
+                        FitnessCases& cases,
+                        long randseed,
+                        const atomic<bool>& _stop,
+                        int max_loop_depth,
+                        vector<EvalResult>& _results)
+{
+  const uint64_t t0 = metricsEnabled() ? metricsClock() : 0;
+
+  iset = &_iset;
+  trie = &_trie;
+  results = &_results;
+  stop = &_stop;
+  loop_aborts.assign(trie->size(), 0);
+  any_failed = false;
+
+  results->resize(trie->size());
+  for (unsigned p=0;p<results->size();p++) { // as clear(), but the output buffers are kept for reuse
+    EvalResult& r = (*results)[p];
+    r.n_cases = r.n_ops = r.n_invops = r.n_inputs_bf_output = r.n_failed = 0;
+    r.cancelled = r.timedout = false;
+    r.outputs.resize(cases.size());
+  }
+  iset->setMaxLoopDepth(max_loop_depth);
+
+  for (first=0;(first<cases.size()) && (trie->size()>0);first+=lanes) {
+    if (stop->load(memory_order_relaxed))
+      break;
+
+    n = min(lanes, (unsigned)cases.size()-first);
+    for (unsigned i=0;i<n;i++) {
+      MemCore& core = *cores[i];
+      core.reset();
+      core.input = &cases[first+i];
+      outputs[i].clear();
+      *core.ran_ptr = (randseed>0) ? -randseed : randseed;
+    }
+    n_ops = n_invops = n_inputs_bf_output = 0;
+    visit(0, 0);
+
+    for (unsigned i=0;i<n;i++)
+      cores[i]->input = &no_input;
+  }
+
+  for (unsigned p=0;p<results->size();p++) {
+    EvalResult& r = (*results)[p];
+    r.outputs.resize(r.n_cases); // a stop may have kept the walk from some programs in the last block
+    if (stop->load(memory_order_relaxed))
+      r.cancelled = true;
+    if (metricsEnabled())
+      recordEvaluation(t0, r.n_cases, r.n_ops, r.n_invops, 0, loop_aborts[p]);
+  }
+
+  return any_failed;
+}
+
+}; //namespace SlashA
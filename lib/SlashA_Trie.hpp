@@ -0,0 +1,129 @@
+/*
+ *
+ *  SlashA_Trie.hpp - evaluation of a population through a trie of shared program prefixes
+ *
+ *  Copyright (C) 2004-2011 Artur B Adib
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef SLASHA_TRIE_INCLUDED // duplicate protection
+#define SLASHA_TRIE_INCLUDED
+
+#include <stdint.h>
+#include <unordered_map>
+#include "SlashA.hpp"
+
+namespace SlashA
+{
+
+  /*
+   * Programs of a population descended from common ancestors often start with the same instructions. A
+   * PrefixTrie holds the prefix of each program made of instructions that only act on the machine state
+   * (isStateOnly(): everything but flow control and user-defined instructions). TrieEvaluator walks the trie
+   * depth-first with one core per fitness case, as LockstepEvaluator does: each node's instruction is run
+   * once for all the cases, the cores are saved where the trie branches and restored for each branch. The
+   * rest of each program, if any, is run by the interpreter from the state its prefix left, at its real
+   * position and with loop and jump tables built over the whole program. Flow control, backward jumps
+   * included, thus behaves exactly as in a run from the start.
+   */
+
+  class PrefixTrie
+  {
+    public:
+      class Node
+      {
+        public:
+          ByteCode_Type op;
+          unsigned first_child, next_sibling; // 0: none (the root is nobody's child)
+          unsigned first_program; // programs whose prefix ends here; ~0u: none
+      };
+
+    private:
+      unsigned n_numeric;
+      std::vector<unsigned char> state_only; // isStateOnly() of each non-numeric opcode
+      std::vector<Node> nodes; // nodes[0] is the root, the empty prefix
+      std::vector<ProgramView> programs;
+      std::vector<unsigned> prefix; // prefix length of each program
+      std::vector<unsigned> next_program; // next program whose prefix ends at the same node
+      std::unordered_map<uint64_t, unsigned> children; // (parent<<32 | opcode) -> node
+      size_t n_prefix; // instructions in all prefixes
+
+      friend class TrieEvaluator;
+
+    public:
+      PrefixTrie(InstructionSet& iset); // the set tells the instructions apart
+
+      void clear();
+      unsigned insert(const ProgramView& p); // the program must stay where it is; returns its number
+      void insert(const std::vector<ByteCode>& population) { for (unsigned i=0;i<population.size();i++) insert(population[i]); }
+
+      unsigned size() const { return programs.size(); }
+      unsigned nodeCount() const { return nodes.size()-1; } // instructions run per case for all the prefixes
+      size_t prefixInstructions() const { return n_prefix; } // the same without sharing
+  };
+
+  class TrieEvaluator
+  {
+    private:
+      class Snapshot;
+
+      unsigned D_size, L_size;
+      unsigned lanes;
+      std::vector<MemCore*> cores;
+      std::vector< std::vector<double> > outputs; // of each lane, only ever appended to by the walk
+      std::vector<double> no_input;
+      std::vector< std::vector<Snapshot> > saved; // [level][lane], one level per branch point on the path
+      std::vector<unsigned> saved_counts; // the three counters below, per level
+
+      // the walk
+      InstructionSet* iset;
+      const PrefixTrie* trie;
+      std::vector<EvalResult>* results;
+      const std::atomic<bool>* stop;
+      std::vector<unsigned> loop_aborts; // per program
+      unsigned first, n; // cases of the current block
+      unsigned n_ops, n_invops, n_inputs_bf_output; // of the prefix so far, summed over the lanes
+      bool any_failed;
+
+      void save(unsigned level);
+      void restore(unsigned level);
+      void exec(ByteCode_Type op);
+      bool finish(unsigned p);
+      void visit(unsigned node, unsigned level);
+
+    public:
+      TrieEvaluator(unsigned _D_size,
+                    unsigned _L_size,
+                    unsigned _lanes = 64); // cases walked together (larger batches are run in blocks)
+      ~TrieEvaluator();
+
+      // Same results as runFitnessCases() on each program of the trie (results[i] for program i), except
+      // that metrics record every program with the latency of the whole call. The output buffers of
+      // results are reused from one call to the next. core.C is NULL while a program runs, as for a
+      // ProgramView. stop is checked between the instructions of the walk too; the programs it has not
+      // reached then end one block of cases earlier. Returns true if any case of any program failed.
+      bool run(InstructionSet& iset,
+               const PrefixTrie& trie,
+               FitnessCases& cases,
+               long randseed,
+               const std::atomic<bool>& stop,
+               int max_loop_depth,
+               std::vector<EvalResult>& results);
+  };
+
+}; // namespace SlashA
+
+#endif // SLASHA_TRIE_INCLUDED
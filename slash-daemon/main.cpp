@@ -0,0 +1,176 @@
+/*
+ *
+ *  slash-daemon - keeps fitness cases and instruction sets resident and evaluates programs sent over a
+ *  Unix domain socket (see lib/SlashA_Daemon.hpp). Also a minimal client, for scripts.
+ *
+ *  Copyright (C) 2004-2011 Artur B Adib
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <cstdlib>
+#include <cstring>
+#include <signal.h>
+#include "SlashA.hpp"
+#include "SlashA_Daemon.hpp"
+
+using namespace std;
+
+static void usage()
+{
+  cout << "slash-daemon -- Resident evaluation server for Slash/A programs" << endl;
+  cout << SlashA::getHeader() << endl << endl;
+  cout << "Usage:\n";
+  cout << "  slash-daemon [-t threads] [-b max_batch] [-w max_wait_us] <socket> <cases.txt> [<cases.txt> ...]\n";
+  cout << "  slash-daemon -e <socket> <dataset> <file.sla>\n";
+  cout << "  slash-daemon -s <socket>\n\n";
+  cout << "The first form serves every cases file as a dataset, numbered from 0, until interrupted. Each line\n";
+  cout << "of a cases file holds the input values of one fitness case. -e evaluates a program on a dataset\n";
+  cout << "of a running server and prints its outputs; -s prints the server's queue and latency figures.\n\n";
+  exit(1);
+}
+
+static SlashA::InstructionSet* makeISet()
+{
+  SlashA::InstructionSet* iset = new SlashA::InstructionSet(32768);
+  iset->insert_DIS_full();
+  return iset;
+}
+
+static void printStats(const SlashA::DaemonStats& s)
+{
+  cout << s.n_requests << " requests, " << s.n_programs << " programs in " << s.n_batches << " batches ("
+       << s.mean_batch << " programs per batch)" << endl;
+  cout << "queue: " << s.queue_requests << " requests, " << s.queue_programs << " programs; "
+       << s.n_connections << " connections, " << s.n_datasets << " datasets" << endl;
+  cout << "latency (us): mean " << s.latency_mean_us << ", p50 " << s.latency_p50_us << ", p99 "
+       << s.latency_p99_us << ", max " << s.latency_max_us << endl;
+}
+
+static int evaluate(const char* socket, unsigned dataset, const char* file)
+{
+  ifstream f(file);
+  if (!f) {
+    cout << "Cannot open file " << file << ".\n\n";
+    return 1;
+  }
+  stringstream buf;
+  buf << f.rdbuf();
+
+  SlashA::InstructionSet* iset = makeISet(); // same layout as the server's
+  vector<SlashA::ByteCode> programs(1);
+  SlashA::source2ByteCode(buf.str(), programs[0], *iset);
+  delete iset;
+
+  SlashA::EvalClient client(socket);
+  vector<SlashA::EvalResult> results;
+  client.evaluate(dataset, programs, -2237, -1, results);
+
+  const SlashA::EvalResult& r = results[0];
+  for (unsigned k=0;k<r.outputs.size();k++) {
+    for (unsigned i=0;i<r.outputs[k].size();i++)
+      cout << (i ? " " : "") << r.outputs[k][i];
+    cout << endl;
+  }
+  cout << r.n_cases << " cases, " << r.n_ops << " operations, " << r.n_invops << " invalid, "
+       << r.n_failed << " failed" << endl;
+  return 0;
+}
+
+static bool readCases(const char* file, SlashA::FitnessCases& cases)
+{
+  ifstream fc(file);
+  if (!fc)
+    return false;
+  string line;
+  while (getline(fc, line)) {
+    istringstream ls(line);
+    vector<double> input;
+    double x;
+    while (ls >> x)
+      input.push_back(x);
+    if (input.size()>0)
+      cases.push_back(input);
+  }
+  return true;
+}
+
+int main(int argc, char** argv)
+{
+  unsigned n_threads = 0, max_batch = 256, max_wait_us = 500;
+  int a = 1;
+
+  try
+  {
+    if ( (argc==5) && (strcmp(argv[1], "-e")==0) )
+      return evaluate(argv[2], atoi(argv[3]), argv[4]);
+    if ( (argc==3) && (strcmp(argv[1], "-s")==0) ) {
+      SlashA::EvalClient client(argv[2]);
+      printStats(client.stats());
+      return 0;
+    }
+
+    while ( (a+1<argc) && (argv[a][0]=='-') ) {
+      if (strcmp(argv[a], "-t")==0)
+        n_threads = atoi(argv[a+1]);
+      else if (strcmp(argv[a], "-b")==0)
+        max_batch = atoi(argv[a+1]);
+      else if (strcmp(argv[a], "-w")==0)
+        max_wait_us = atoi(argv[a+1]);
+      else
+        usage();
+      a += 2;
+    }
+    if (argc-a<2)
+      usage();
+
+    vector<SlashA::FitnessCases> datasets(argc-a-1);
+    for (unsigned k=0;k<datasets.size();k++)
+      if (!readCases(argv[a+1+k], datasets[k])) {
+        cout << "Cannot open file " << argv[a+1+k] << ".\n\n";
+        exit(1);
+      }
+
+    // Signals are taken by sigwait() below; the server's threads inherit the mask
+    sigset_t sigs;
+    sigemptyset(&sigs);
+    sigaddset(&sigs, SIGINT);
+    sigaddset(&sigs, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &sigs, NULL);
+
+    SlashA::EvalServer server(makeISet, 10, 10, max_batch, max_wait_us);
+    for (unsigned k=0;k<datasets.size();k++) {
+      server.addDataset(datasets[k], n_threads);
+      cout << "dataset " << k << ": " << argv[a+1+k] << ", " << datasets[k].size() << " cases" << endl;
+    }
+    server.start(argv[a]);
+    cout << "listening on " << argv[a] << endl;
+
+    int sig;
+    sigwait(&sigs, &sig);
+    server.stop();
+    printStats(server.stats());
+    return 0;
+  }
+  catch(string& s)
+  {
+    cout << s << endl << endl;
+    exit(1);
+  }
+}
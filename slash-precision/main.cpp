@@ -0,0 +1,173 @@
+/*
+ *
+ *  slash-precision - runs a Slash/A program in float and in double and compares the outputs.
+ *
+ *  Copyright (C) 2004-2011 Artur B Adib
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <cstdlib>
+#include <cstring>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include "SlashA.hpp"
+#include "SlashA_Precision.hpp"
+
+using namespace std;
+
+// Raises stop once the given number of seconds has passed, unless destroyed first
+class Deadline
+{
+  private:
+    atomic<bool>& stop;
+    mutex mtx;
+    condition_variable cv;
+    bool done;
+    thread timer;
+
+  public:
+    Deadline(atomic<bool>& _stop, long seconds) : stop(_stop), done(false)
+    {
+      timer = thread([this, seconds] {
+        unique_lock<mutex> lock(mtx);
+        if (!cv.wait_for(lock, chrono::seconds(seconds), [this] { return done; }))
+          stop = true;
+      });
+    }
+    ~Deadline()
+    {
+      {
+        lock_guard<mutex> lock(mtx);
+        done = true;
+      }
+      cv.notify_one();
+      timer.join();
+    }
+};
+
+static void usage()
+{
+  cout << "slash-precision -- Compares float and double runs of a Slash/A program" << endl;
+  cout << SlashA::getHeader() << endl << endl;
+  cout << "Usage:\n";
+  cout << "  slash-precision [-r rel_tol] [-a abs_tol] [-t seconds] <file.sla> <cases.txt>\n\n";
+  cout << "Each line of cases.txt holds the input values of one fitness case. Exits with 0 if every\n";
+  cout << "output agrees within abs_tol + rel_tol*|double output| (defaults: 1e-6 and 1e-4). Both runs\n";
+  cout << "together are stopped after the given time (default 60 s, 0 for no limit), which exits with 1.\n\n";
+  exit(1);
+}
+
+int main(int argc, char** argv)
+{
+  double rel_tol = 1e-4, abs_tol = 1e-6;
+  long max_rtime = 60;
+  int a = 1;
+
+  while ( (a+1<argc) && (argv[a][0]=='-') ) {
+    if (strcmp(argv[a], "-r")==0)
+      rel_tol = atof(argv[a+1]);
+    else if (strcmp(argv[a], "-a")==0)
+      abs_tol = atof(argv[a+1]);
+    else if (strcmp(argv[a], "-t")==0)
+      max_rtime = atol(argv[a+1]);
+    else
+      usage();
+    a += 2;
+  }
+  if (argc-a!=2)
+    usage();
+
+  ifstream f(argv[a]);
+  if (!f) {
+    cout << "Cannot open file " << argv[a] << ".\n\n";
+    exit(1);
+  }
+  stringstream buf;
+  buf << f.rdbuf(); // the whole file at once
+  const string source = buf.str();
+  f.close();
+
+  SlashA::FitnessCases cases;
+  ifstream fc(argv[a+1]);
+  if (!fc) {
+    cout << "Cannot open file " << argv[a+1] << ".\n\n";
+    exit(1);
+  }
+  string line;
+  while (getline(fc, line)) {
+    istringstream ls(line);
+    vector<double> input;
+    double x;
+    while (ls >> x)
+      input.push_back(x);
+    if (input.size()>0)
+      cases.push_back(input);
+  }
+  fc.close();
+
+  try 
+  {
+    SlashA::ByteCode bc;
+    SlashA::InstructionSet iset(32768);
+    SlashA::FloatInstructionSet fset(32768);
+    iset.insert_DIS_full();
+    iset.insert_DIS_vector();
+    fset.insert_DIS_full();
+    fset.insert_DIS_vector();
+
+    SlashA::source2ByteCode(source, bc, iset);
+
+    SlashA::PrecisionReport rep;
+    atomic<bool> stop(false);
+    bool agree;
+    {
+      Deadline deadline(stop, max_rtime ? max_rtime : 3600*24*7); // as runByteCode(), 0 is a week
+      agree = SlashA::comparePrecision(iset, fset, bc, cases,
+                                       10, // length of the data tape D[]
+                                       10, // length of the label tape L[]
+                                       -2237, // random seed
+                                       stop,
+                                       -1, // no limit on loop depth
+                                       abs_tol, rel_tol, rep);
+    }
+
+    cout << rep.n_cases << " cases, " << rep.n_outputs << " outputs compared" << endl;
+    cout << "max abs error " << rep.max_abs_error << " (case " << rep.worst_case << ", output " << rep.worst_output
+         << "), max rel error " << rep.max_rel_error << endl;
+    cout << "invalid ops: " << rep.n_invops_double << " double, " << rep.n_invops_float << " float" << endl;
+    if (rep.n_count_mismatches>0)
+      cout << rep.n_count_mismatches << " cases with a different number of outputs" << endl;
+    if (rep.stopped) {
+      cout << "Timed out after " << max_rtime << " s, the remaining cases were not compared" << endl;
+      return 1;
+    }
+    cout << (agree ? "float agrees with double" : "float DIFFERS from double") << " (" << rep.n_exceeding
+         << " outputs out of tolerance)" << endl;
+    return agree ? 0 : 2;
+  }
+  catch(string& s)
+  {
+    cout << s << endl << endl;
+    exit(1);
+  }
+}
@@ -0,0 +1,88 @@
+/*
+ *
+ *  slash-trace - decodes and replays binary execution traces written by the Slash/A library.
+ *
+ *  Copyright (C) 2004-2011 Artur B Adib
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <iostream>
+#include <string>
+#include <cstring>
+#include "SlashA.hpp"
+#include "SlashA_Trace.hpp"
+
+using namespace std;
+
+int main(int argc, char** argv)
+{
+  bool replay = (argc==3) && (strcmp(argv[1], "-r")==0);
+
+  if ( (argc!=2) && (!replay) ) {
+    cout << "slash-trace -- Decodes Slash/A execution traces" << endl;
+    cout << SlashA::getHeader() << endl << endl;
+    cout << "Usage:\n";
+    cout << "  slash-trace <file.trace>      prints the program and every recorded instruction\n";
+    cout << "  slash-trace -r <file.trace>   re-runs the program and checks it against the trace\n\n";
+    exit(1);
+  }
+
+  try 
+  {
+    SlashA::TraceHeader header;
+    vector<SlashA::TraceRecord> records;
+    SlashA::readTrace(argv[argc-1], header, records);
+
+    if (replay) {
+      // the Default Instruction Set; instructions are matched to the traced ones by name
+      SlashA::InstructionSet iset(header.n_numeric);
+      iset.insert_DIS_full();
+      iset.insert_DIS_vector();
+
+      string report;
+      long long bad = SlashA::replayTrace(iset, header, records, report);
+      cout << report << endl;
+      return (bad<0) ? 0 : 2;
+    }
+
+    cout << "# program:";
+    for (unsigned i=0;i<header.bc.size();i++)
+      cout << " " << header.opcodeName(header.bc[i]) << "/";
+    cout << "." << endl;
+    cout << "# seed " << header.randseed << ", " << header.input.size() << " inputs, "
+         << header.n_total << " instructions executed, " << records.size() << " recorded" << endl;
+
+    const unsigned long long first = header.n_total - records.size();
+    for (unsigned i=0;i<records.size();i++) {
+      const SlashA::TraceRecord& r = records[i];
+      cout << first+i << "\tc=" << r.c << "\t" << header.opcodeName(r.opcode) << "\tF=" << r.F << "\tI=" << r.I;
+      if (r.flags & SlashA::TRACE_D_CHANGED)
+        cout << "\tD[" << r.D_index << "]=" << r.D;
+      if (r.flags & SlashA::TRACE_RANGE_CHANGED)
+        cout << "\tD[" << r.D_index+1 << "..] scaled";
+      if (r.flags & SlashA::TRACE_INVALID)
+        cout << "\tinvalid";
+      cout << endl;
+    }
+  }
+  catch(string& s)
+  {
+    cout << s << endl << endl;
+    exit(1);
+  }
+  
+  return 0;
+}
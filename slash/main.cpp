@@ -21,6 +21,7 @@
 
 #include <iostream>
 #include <fstream>
+#include <sstream>
 #include <string>
 #include "SlashA.hpp"
 
@@ -37,7 +38,6 @@ int main(int argc, char** argv)
     exit(1);
   }
 
-  string source = "";
   ifstream f(argv[1]);
 
   if (!f) {
@@ -45,8 +45,9 @@ int main(int argc, char** argv)
     exit(1);
   }
   
-  while (!f.eof())
-    source += f.get();
+  stringstream buf;
+  buf << f.rdbuf(); // the whole file at once
+  const string source = buf.str();
 
   f.close();
 